@@ -0,0 +1,91 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Entity.hpp"
+
+namespace babs_ecs
+{
+	// CommandBuffer records structural changes to apply to an ECSManager later, on the thread that owns it.
+	// Give each worker thread its own buffer: recording never touches the manager except for the atomic
+	// entity reservation, so workers can spawn entities in parallel without a lock.
+	//
+	// Typical usage:
+	//   babs_ecs::CommandBuffer buffer(ecs);               // one per worker
+	//   babs_ecs::Entity particle = buffer.CreateEntity(); // on the worker
+	//   buffer.AddComponents(particle, Position{ x, y }, Lifetime{ 2.0f });
+	//   ...
+	//   buffer.Submit();                                   // on the main thread, after the workers joined
+	class CommandBuffer
+	{
+	public:
+		explicit CommandBuffer(ECSManager& ecs) : ecs(ecs) {}
+
+		// CreateEntity reserves a new entity. Its UUID is valid right away, but the entity only exists once submitted.
+		Entity CreateEntity()
+		{
+			return this->ecs.ReserveEntity();
+		}
+
+		template <typename... Ts>
+		void AddComponents(Entity entity, Ts... components)
+		{
+			this->commands.emplace_back([entity, components...](ECSManager& ecs) {
+				ecs.AddComponents(entity, components...);
+			});
+		}
+
+		template <typename T>
+		void AddComponent(Entity entity, T component)
+		{
+			this->AddComponents<T>(entity, std::move(component));
+		}
+
+		template <typename... Ts>
+		void RemoveComponents(Entity entity)
+		{
+			this->commands.emplace_back([entity](ECSManager& ecs) {
+				ecs.RemoveComponents<Ts...>(entity);
+			});
+		}
+
+		template <typename T>
+		void RemoveComponent(Entity entity)
+		{
+			this->RemoveComponents<T>(entity);
+		}
+
+		void RemoveEntity(Entity entity)
+		{
+			this->commands.emplace_back([entity](ECSManager& ecs) {
+				ecs.RemoveEntity(entity);
+			});
+		}
+
+		// Submit creates the reserved entities and applies the recorded commands in order, then clears the buffer.
+		// Like any structural change it must not overlap with other threads still using the manager.
+		void Submit()
+		{
+			this->ecs.FlushReservedEntities();
+
+			for (auto& command : this->commands)
+			{
+				command(this->ecs);
+			}
+
+			this->commands.clear();
+		}
+
+		size_t Size() const
+		{
+			return this->commands.size();
+		}
+
+	private:
+		ECSManager& ecs;
+		std::vector<std::function<void(ECSManager&)>> commands;
+	};
+}
@@ -0,0 +1,157 @@
+#include "doctest.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#include "CommandBuffer.hpp"
+
+struct Particle
+{
+	int x;
+	int y;
+};
+
+struct Lifetime
+{
+	int frames;
+};
+
+TEST_SUITE("Command buffer")
+{
+	TEST_CASE("Recorded commands only apply on submit")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Particle>();
+		ecs.RegisterComponent<Lifetime>();
+
+		babs_ecs::CommandBuffer buffer(ecs);
+		babs_ecs::Entity e = buffer.CreateEntity();
+		buffer.AddComponents(e, Particle{ 1, 2 }, Lifetime{ 60 });
+
+		REQUIRE(buffer.Size() == 1);
+		REQUIRE(ecs.EntitiesWith().size() == 0);
+
+		buffer.Submit();
+
+		REQUIRE(buffer.Size() == 0);
+		REQUIRE(ecs.EntitiesWith<Particle, Lifetime>().size() == 1);
+		REQUIRE(ecs.GetComponent<Particle>(e)->y == 2);
+	}
+
+	TEST_CASE("Commands apply in the order they were recorded")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Particle>();
+		ecs.RegisterComponent<Lifetime>();
+
+		babs_ecs::Entity existing = ecs.CreateEntity();
+		ecs.AddComponent(existing, Lifetime{ 1 });
+
+		babs_ecs::CommandBuffer buffer(ecs);
+		buffer.RemoveComponent<Lifetime>(existing);
+		buffer.AddComponent(existing, Particle{ 0, 0 });
+
+		babs_ecs::Entity temporary = buffer.CreateEntity();
+		buffer.AddComponent(temporary, Particle{ 5, 5 });
+		buffer.RemoveEntity(temporary);
+		buffer.Submit();
+
+		REQUIRE(ecs.HasComponent<Lifetime>(existing) == false);
+		REQUIRE(ecs.HasComponent<Particle>(existing) == true);
+		REQUIRE(ecs.EntitiesWith<Particle>().size() == 1);
+	}
+
+	TEST_CASE("Worker threads spawn into their own buffers")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Particle>();
+		ecs.RegisterComponent<Lifetime>();
+
+		std::vector<babs_ecs::CommandBuffer> buffers(16, babs_ecs::CommandBuffer(ecs));
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < buffers.size(); ++t)
+		{
+			workers.emplace_back([&, t]() {
+				for (int i = 0; i < 500; ++i)
+				{
+					babs_ecs::Entity e = buffers[t].CreateEntity();
+					buffers[t].AddComponents(e, Particle{ (int)t, i }, Lifetime{ i });
+				}
+			});
+		}
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		for (auto& buffer : buffers)
+		{
+			buffer.Submit();
+		}
+
+		REQUIRE(ecs.EntitiesWith<Particle, Lifetime>().size() == 16 * 500);
+	}
+
+	TEST_CASE("Spawning and despawning through buffers reuses the UUIDs of removed entities")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Particle>();
+		ecs.RegisterComponent<Lifetime>();
+
+		std::vector<babs_ecs::CommandBuffer> buffers(8, babs_ecs::CommandBuffer(ecs));
+		std::vector<std::vector<babs_ecs::Entity>> spawned(buffers.size());
+		uint32_t highest = 0;
+
+		for (int frame = 0; frame < 50; ++frame)
+		{
+			// every particle lives for one frame: the ones spawned last frame despawn as the new ones spawn
+			std::vector<std::thread> workers;
+			for (size_t t = 0; t < buffers.size(); ++t)
+			{
+				workers.emplace_back([&, t]() {
+					for (babs_ecs::Entity e : spawned[t])
+					{
+						buffers[t].RemoveEntity(e);
+					}
+
+					spawned[t].clear();
+					for (int i = 0; i < 100; ++i)
+					{
+						spawned[t].push_back(buffers[t].CreateEntity());
+						buffers[t].AddComponents(spawned[t].back(), Particle{ frame, i }, Lifetime{ 1 });
+					}
+				});
+			}
+
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+
+			for (auto& buffer : buffers)
+			{
+				buffer.Submit();
+			}
+
+			std::vector<uint32_t> ids;
+			for (auto& entities : spawned)
+			{
+				for (babs_ecs::Entity e : entities)
+				{
+					ids.push_back(e.UUID);
+					highest = std::max(highest, e.UUID);
+				}
+			}
+
+			std::sort(ids.begin(), ids.end());
+			REQUIRE(std::unique(ids.begin(), ids.end()) == ids.end());
+			REQUIRE(ecs.EntitiesWith<Particle, Lifetime>().size() == 800);
+		}
+
+		// the live particles of two frames at most, however many frames ran
+		REQUIRE(highest <= 1600);
+		REQUIRE(ecs.CreateEntity().UUID <= 1601);
+	}
+}
@@ -0,0 +1,913 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "bitfield/bitfield.hpp"
+#include "DoubleBuffered.hpp"
+#include "MappedFile.hpp"
+#include "Serialization.hpp"
+#include "Status.hpp"
+
+namespace babs_ecs
+{
+	// BaseContainer is the part of a component storage ECSManager can use without knowing the component type.
+	//
+	// Components are stored densely: the n-th component belongs to the entity Owners()[n], and a sparse
+	// table indexed by UUID finds an entity's component in constant time.
+	class BaseContainer
+	{
+	public:
+		BaseContainer() {};
+		virtual ~BaseContainer() {};
+
+		// UUIDs of the entities holding this component, in storage order.
+		const std::vector<uint32_t>& Owners() const
+		{
+			return this->owners;
+		}
+
+		size_t Size() const
+		{
+			return this->owners.size();
+		}
+
+		bool Contains(uint32_t entityId) const
+		{
+			return entityId < this->sparse.size() && this->sparse[entityId] != 0;
+		}
+
+		// The tick at which the component at this storage index was last added or changed.
+		uint32_t ChangeTickAt(size_t index) const
+		{
+			return this->changeTicks[index];
+		}
+
+		// Stamps the entity's component with the current tick. Does nothing if it doesn't have one, or for
+		// DoubleBuffered components, which workers fetch concurrently and which SwapBuffers stamps instead.
+		// Different threads can stamp the components of different entities at once.
+		void MarkChanged(uint32_t entityId)
+		{
+			if (this->stampOnAccess && this->Contains(entityId))
+			{
+				this->Stamp(this->sparse[entityId] - 1);
+			}
+		}
+
+		// MarkChanged for the component at this storage index, which must be below Size().
+		void MarkChangedAt(size_t index)
+		{
+			if (this->stampOnAccess)
+			{
+				this->Stamp(index);
+			}
+		}
+
+		// RecordChanges starts or stops logging the components added or changed, for ForEachChangeSince.
+		// Stopping drops the log.
+		void RecordChanges(bool record)
+		{
+			this->recordChanges = record;
+			if (!record)
+			{
+				this->changes.clear();
+				this->changes.shrink_to_fit();
+				this->changeCount = 0;
+			}
+
+			this->ReserveChanges();
+		}
+
+		// Makes room in the change log for every component to be stamped once more, so threads stamping
+		// different components never have to grow it. Needed whenever the tick advances or a component is added.
+		void ReserveChanges()
+		{
+			size_t needed = this->changeCount.load(std::memory_order_relaxed) + this->owners.size();
+			if (this->recordChanges && this->changes.size() < needed)
+			{
+				this->changes.resize(std::max(needed, 2 * this->changes.size()));
+			}
+		}
+
+		// Forgets the changes logged before this tick.
+		void DiscardChanges(uint32_t beforeTick)
+		{
+			auto begin = this->changes.begin();
+			auto end = begin + this->changeCount.load(std::memory_order_relaxed);
+			auto kept = std::lower_bound(begin, end, beforeTick, [](const std::pair<uint32_t, uint32_t>& entry, uint32_t tick) { return entry.second < tick; });
+
+			this->changeCount = static_cast<size_t>(std::move(kept, end, begin) - begin);
+		}
+
+		// Calls func(UUID) for every component logged as added or changed at or after sinceTick, oldest first.
+		// A component comes up once per tick it changed in, including components removed since.
+		template <typename Func>
+		void ForEachChangeSince(uint32_t sinceTick, Func&& func) const
+		{
+			auto begin = this->changes.begin();
+			auto end = begin + this->changeCount.load(std::memory_order_relaxed);
+			auto first = std::lower_bound(begin, end, sinceTick, [](const std::pair<uint32_t, uint32_t>& entry, uint32_t tick) { return entry.second < tick; });
+
+			for (; first != end; ++first)
+			{
+				func(first->first);
+			}
+		}
+
+		// Writes the entity's component, which it must have, the way snapshots store it.
+		virtual Status WriteComponent(std::ostream& stream, uint32_t entityId) const = 0;
+
+		// Reads a component written by WriteComponent and stores it for the entity.
+		virtual Status ReadComponent(std::istream& stream, uint32_t entityId) = 0;
+
+		// Removes the entity's component. Does nothing if it doesn't have one.
+		virtual void Remove(uint32_t entityId) = 0;
+
+		// Removes every component.
+		virtual void Clear() = 0;
+
+		// Publishes the written state of every DoubleBuffered component, a no-op for other component types.
+		virtual void SwapBuffers() {};
+
+		// Writes the owners and component data, or reports Status::ComponentNotSerializable.
+		virtual Status Save(std::ostream& stream) const = 0;
+
+		// Replaces the container's content with what Save wrote. Owners must be UUIDs below entityCount.
+		virtual Status Load(std::istream& stream, uint32_t entityCount) = 0;
+
+		// True for components stored as raw bytes in snapshots (trivially copyable ones without a Serializer).
+		// Only those can be mapped, the others are saved and loaded with Save/Load in mapped snapshots too.
+		virtual bool IsRaw() const = 0;
+
+		virtual size_t ComponentSize() const = 0;
+
+		// The number of bytes SaveMapped writes.
+		virtual size_t MappedSize() const = 0;
+
+		// Writes the index and whole pages of component data, laid out so that Map can use the pages in place.
+		// The stream position must be a multiple of MappedAlignment.
+		virtual void SaveMapped(std::ostream& stream) const = 0;
+
+		// Replaces the container's content with the section SaveMapped wrote at this offset of the file. The
+		// component data isn't copied: the pages point into the file, which stays open as long as they do.
+		virtual Status Map(const std::shared_ptr<MappedFile>& file, size_t offset, size_t size, uint32_t entityCount) = 0;
+
+		// Returns an empty container for the same component type, e.g. to copy this one into with CopyTo.
+		virtual std::unique_ptr<BaseContainer> CreateEmpty() const = 0;
+
+		// Makes target, which must hold the same component type, a copy of this container's components,
+		// stamped with target's tick. Pages only target holds are copied into, so copying into the same
+		// target again doesn't allocate.
+		virtual void CopyTo(BaseContainer& target) const = 0;
+
+		// Returns a container of the same component type holding the same components, which shares the pages
+		// of this one until either of them writes to a page through At, and then copies that page first.
+		// Pointers into this container obtained before the fork point into shared pages, so they're invalid.
+		virtual std::unique_ptr<BaseContainer> Fork() = 0;
+
+		// Copies every page still shared with a fork, so no later write has to.
+		virtual void Unshare() = 0;
+
+		// Returns count copies of this container that share nothing with it or with each other, except for
+		// one allocation holding the first page of every copy side by side. Those pages are sized to the pool,
+		// rounded up to a power of two, so the small pools of many worlds don't each take a page of PageSize.
+		virtual std::vector<std::unique_ptr<BaseContainer>> ForkBatch(size_t count) const = 0;
+
+		// Returns a hash of every (owner, component) pair that doesn't depend on the storage order. Components
+		// are hashed as they're saved in snapshots; components that can't be saved only count by owner.
+		virtual uint64_t Hash() const = 0;
+
+		// the bitfield flag assigned to this component type by RegisterComponent
+		bitfield::Bitfield flag = 0;
+
+		// the component's type name, which identifies the container in snapshots
+		std::string name;
+
+		// the tick stamped on components as they're added or changed, kept current by ECSManager
+		uint32_t tick = 0;
+
+		// UUID and tick of every component removed from an entity that stayed alive, oldest first
+		std::vector<std::pair<uint32_t, uint32_t>> removals;
+
+	protected:
+		// sparse[UUID] is the index of the entity's component plus one, 0 if it has none
+		std::vector<uint32_t> sparse;
+		std::vector<uint32_t> owners;
+
+		// changeTicks[i] is the tick at which the component at index i was last added or changed
+		std::vector<uint32_t> changeTicks;
+
+		bool stampOnAccess = true;
+
+		// Stamps the component at this index with the current tick, logging it the first time in a tick.
+		void Stamp(size_t index)
+		{
+			if (this->changeTicks[index] == this->tick)
+			{
+				return;
+			}
+
+			this->changeTicks[index] = this->tick;
+			if (this->recordChanges)
+			{
+				this->changes[this->changeCount.fetch_add(1, std::memory_order_relaxed)] = { this->owners[index], this->tick };
+			}
+		}
+
+		// Logs a component added at the current tick. Only called by structural changes, which run alone.
+		void LogAdded(uint32_t entityId)
+		{
+			if (this->recordChanges)
+			{
+				this->ReserveChanges();
+				this->changes[this->changeCount.fetch_add(1, std::memory_order_relaxed)] = { entityId, this->tick };
+				this->ReserveChanges();
+			}
+		}
+
+	private:
+		// changes[0, changeCount) holds the UUID and tick of the components added or changed while recordChanges
+		// is set, oldest first. The rest is the room ReserveChanges keeps.
+		std::vector<std::pair<uint32_t, uint32_t>> changes;
+		std::atomic<size_t> changeCount{ 0 };
+		bool recordChanges = false;
+	};
+
+	// This is the concrete type created by RegisterComponent.
+	// This container will hold all of the component data for a specific component type.
+	//
+	// The data lives in pages of PageSize components, or of the size ForkBatch picked for its copies. Adding
+	// components doesn't move the pages, so it doesn't invalidate pointers to other components; removing one
+	// moves the last component into its slot. A page shared with a fork moves the first time it's written to,
+	// see Fork.
+	template <typename T>
+	class ComponentContainer : public BaseContainer
+	{
+	public:
+		static constexpr size_t PageShift = 10;
+		static constexpr size_t PageSize = size_t(1) << PageShift;
+		static constexpr size_t PageBytes = PageSize * sizeof(T);
+
+		ComponentContainer()
+		{
+			this->stampOnAccess = !IsDoubleBuffered<T>::value;
+		}
+
+		virtual ~ComponentContainer() {};
+
+		// Returns the component at this storage index, which must be below Size(). If its page is shared
+		// with a fork, the page is copied first.
+		T& At(size_t index)
+		{
+			if (this->sharedPageCount != 0)
+			{
+				this->UnsharePage(index >> this->pageShift);
+			}
+
+			return this->pages[index >> this->pageShift][index & this->pageMask];
+		}
+
+		const T& At(size_t index) const
+		{
+			return this->pages[index >> this->pageShift][index & this->pageMask];
+		}
+
+		// Returns the entity's component, or nullptr if it doesn't have one.
+		T* Find(uint32_t entityId)
+		{
+			return this->Contains(entityId) ? &this->At(this->sparse[entityId] - 1) : nullptr;
+		}
+
+		const T* Find(uint32_t entityId) const
+		{
+			return this->Contains(entityId) ? &this->At(this->sparse[entityId] - 1) : nullptr;
+		}
+
+		bool HasSharedPages() const
+		{
+			return this->sharedPageCount != 0;
+		}
+
+		// Copies the page of the entity's component if it's shared with a fork, so it can be written to
+		// through a pointer obtained with the const accessors.
+		void UnshareComponent(uint32_t entityId)
+		{
+			if (this->sharedPageCount != 0 && this->Contains(entityId))
+			{
+				this->UnsharePage((this->sparse[entityId] - 1) >> this->pageShift);
+			}
+		}
+
+		// Returns the entity's component, which it must have.
+		const T& Get(uint32_t entityId) const
+		{
+			return this->At(this->sparse[entityId] - 1);
+		}
+
+		// Stores the entity's component, replacing the one it already has.
+		T& Insert(uint32_t entityId, const T& component)
+		{
+			if (T* existing = this->Find(entityId))
+			{
+				*existing = component;
+				this->Stamp(this->sparse[entityId] - 1);
+				return *existing;
+			}
+
+			if (entityId >= this->sparse.size())
+			{
+				this->sparse.resize(static_cast<size_t>(entityId) + 1, 0);
+			}
+
+			size_t index = this->owners.size();
+			if (index == this->pages.size() << this->pageShift)
+			{
+				this->pages.emplace_back(new T[this->PageCapacity()]());
+			}
+
+			this->owners.push_back(entityId);
+			this->changeTicks.push_back(this->tick);
+			this->sparse[entityId] = static_cast<uint32_t>(index + 1);
+			this->LogAdded(entityId);
+
+			T& stored = this->At(index);
+			stored = component;
+			return stored;
+		}
+
+		void Remove(uint32_t entityId) override
+		{
+			if (!this->Contains(entityId))
+			{
+				return;
+			}
+
+			size_t index = this->sparse[entityId] - 1;
+			size_t last = this->owners.size() - 1;
+
+			if (index != last)
+			{
+				this->At(index) = std::move(this->At(last));
+				this->owners[index] = this->owners[last];
+				this->changeTicks[index] = this->changeTicks[last];
+				this->sparse[this->owners[index]] = static_cast<uint32_t>(index + 1);
+			}
+
+			// the freed slot is reused by the next Insert, but shouldn't hold on to resources until then
+			this->At(last) = T();
+			this->owners.pop_back();
+			this->changeTicks.pop_back();
+			this->sparse[entityId] = 0;
+		}
+
+		void Clear() override
+		{
+			this->sparse.clear();
+			this->owners.clear();
+			this->changeTicks.clear();
+			this->removals.clear();
+			this->pages.clear();
+			this->sharedPages.clear();
+			this->sharedPageCount = 0;
+			this->SetPageShift(PageShift);
+		}
+
+		std::unique_ptr<BaseContainer> CreateEmpty() const override
+		{
+			return std::make_unique<ComponentContainer<T>>();
+		}
+
+		void CopyTo(BaseContainer& target) const override
+		{
+			ComponentContainer<T>& copy = static_cast<ComponentContainer<T>&>(target);
+			size_t count = this->owners.size();
+			size_t previousCount = copy.owners.size();
+
+			copy.sparse = this->sparse;
+			copy.owners = this->owners;
+			copy.changeTicks.assign(count, copy.tick);
+
+			// the pages of the two containers may differ in size, see ForkBatch
+			size_t capacity = copy.PageCapacity();
+			size_t pageCount = (count + capacity - 1) / capacity;
+			if (copy.pages.size() < pageCount)
+			{
+				copy.pages.resize(pageCount);
+			}
+
+			for (size_t page = 0; page < pageCount; ++page)
+			{
+				// pages shared with a mapped file or another container get replaced rather than written to
+				if (copy.pages[page] == nullptr || copy.pages[page].use_count() != 1)
+				{
+					copy.pages[page].reset(new T[capacity]());
+				}
+
+				copy.MarkUnshared(page);
+				this->CopyRun(page * capacity, std::min(capacity, count - page * capacity), copy.pages[page].get());
+			}
+
+			// slots past the end hold default components, as Remove leaves them
+			for (size_t i = count; i < previousCount; ++i)
+			{
+				copy.At(i) = T();
+			}
+		}
+
+		std::unique_ptr<BaseContainer> Fork() override
+		{
+			auto fork = std::make_unique<ComponentContainer<T>>();
+			fork->flag = this->flag;
+			fork->name = this->name;
+			fork->tick = this->tick;
+			fork->sparse = this->sparse;
+			fork->owners = this->owners;
+			fork->changeTicks = this->changeTicks;
+			fork->pages = this->pages;
+			fork->SetPageShift(this->pageShift);
+
+			this->sharedPages.assign(this->pages.size(), true);
+			this->sharedPageCount = this->pages.size();
+			fork->sharedPages = this->sharedPages;
+			fork->sharedPageCount = this->sharedPageCount;
+
+			return fork;
+		}
+
+		void Unshare() override
+		{
+			for (size_t page = 0; this->sharedPageCount != 0 && page < this->pages.size(); ++page)
+			{
+				this->UnsharePage(page);
+			}
+		}
+
+		std::vector<std::unique_ptr<BaseContainer>> ForkBatch(size_t count) const override
+		{
+			// pools that grow past their page add pages of the same size, so they shouldn't be tiny
+			size_t shift = 4;
+			while ((size_t(1) << shift) < this->owners.size())
+			{
+				++shift;
+			}
+
+			size_t capacity = size_t(1) << shift;
+			std::shared_ptr<T[]> arena(this->owners.empty() ? nullptr : new T[capacity * count]());
+
+			std::vector<std::unique_ptr<BaseContainer>> forks;
+			forks.reserve(count);
+			for (size_t i = 0; i < count; ++i)
+			{
+				auto fork = std::make_unique<ComponentContainer<T>>();
+				fork->flag = this->flag;
+				fork->name = this->name;
+				fork->tick = this->tick;
+				fork->sparse = this->sparse;
+				fork->owners = this->owners;
+				fork->changeTicks = this->changeTicks;
+				fork->SetPageShift(shift);
+
+				// the slice gets a control block of its own that keeps the arena alive, so use_count tells
+				// whether the page is shared like it does for the others
+				if (arena != nullptr)
+				{
+					T* slice = arena.get() + i * capacity;
+					this->CopyRun(0, this->owners.size(), slice);
+					fork->pages.emplace_back(slice, [arena](T*) {});
+				}
+
+				forks.push_back(std::move(fork));
+			}
+
+			return forks;
+		}
+
+		uint64_t Hash() const override
+		{
+			// a sum of the pairs' hashes stays the same whatever order they're added in
+			uint64_t hash = 0;
+
+			if constexpr (HasSerializer<T>::value)
+			{
+				std::ostringstream stream;
+				for (size_t i = 0; i < this->owners.size(); ++i)
+				{
+					stream.str(std::string());
+					Serializer<T>::Write(stream, this->At(i));
+
+					std::string bytes = stream.str();
+					hash += HashBytes(bytes.data(), bytes.size(), this->owners[i]);
+				}
+			}
+			else if constexpr (std::is_trivially_copyable<T>::value && !std::is_empty<T>::value)
+			{
+				// straight through the pages, so this runs at memory speed
+				for (size_t first = 0; first < this->owners.size(); first += this->PageCapacity())
+				{
+					const T* page = this->pages[first >> this->pageShift].get();
+					size_t pageCount = std::min(this->PageCapacity(), this->owners.size() - first);
+
+					for (size_t i = 0; i < pageCount; ++i)
+					{
+						hash += HashBytes(&page[i], sizeof(T), this->owners[first + i]);
+					}
+				}
+			}
+			else
+			{
+				for (uint32_t entityId : this->owners)
+				{
+					hash += HashBytes(nullptr, 0, entityId);
+				}
+			}
+
+			return hash;
+		}
+
+		void SwapBuffers() override
+		{
+			if constexpr (IsDoubleBuffered<T>::value)
+			{
+				for (size_t i = 0; i < this->owners.size(); ++i)
+				{
+					T& component = this->At(i);
+
+					// comparing bytes may take equal values for changed ones (padding, -0.0), but never misses a change
+					if (!std::is_trivially_copyable<T>::value || std::memcmp(&component.Read(), &component.Write(), sizeof(component.Read())) != 0)
+					{
+						this->Stamp(i);
+					}
+
+					component.Swap();
+				}
+			}
+		}
+
+		// Trivially copyable components without a Serializer are written a page at a time as raw bytes.
+		Status Save(std::ostream& stream) const override
+		{
+			if constexpr (!IsSerializable<T>::value)
+			{
+				return Status::ComponentNotSerializable;
+			}
+			else
+			{
+				uint32_t count = static_cast<uint32_t>(this->owners.size());
+				WriteValue(stream, count);
+				WriteArray(stream, this->owners.data(), count);
+
+				for (size_t first = 0; first < count; first += this->PageCapacity())
+				{
+					const T* page = this->pages[first >> this->pageShift].get();
+					size_t pageCount = std::min(this->PageCapacity(), count - first);
+
+					if constexpr (HasSerializer<T>::value)
+					{
+						for (size_t i = 0; i < pageCount; ++i)
+						{
+							Serializer<T>::Write(stream, page[i]);
+						}
+					}
+					else
+					{
+						WriteArray(stream, page, pageCount);
+					}
+				}
+
+				return stream ? Status::Ok : Status::StreamError;
+			}
+		}
+
+		Status Load(std::istream& stream, uint32_t entityCount) override
+		{
+			this->Clear();
+
+			if constexpr (!IsSerializable<T>::value)
+			{
+				return Status::ComponentNotSerializable;
+			}
+			else
+			{
+				uint32_t count = 0;
+				ReadValue(stream, count);
+				if (!stream)
+				{
+					return Status::StreamError;
+				}
+
+				if (count > entityCount)
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				this->owners.resize(count);
+				ReadArray(stream, this->owners.data(), count);
+				if (!stream)
+				{
+					this->Clear();
+					return Status::StreamError;
+				}
+
+				this->sparse.resize(entityCount, 0);
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					if (this->owners[i] >= entityCount)
+					{
+						this->Clear();
+						return Status::InvalidSnapshot;
+					}
+
+					this->sparse[this->owners[i]] = i + 1;
+				}
+
+				for (size_t first = 0; first < count; first += PageSize)
+				{
+					this->pages.emplace_back(new T[PageSize]());
+					T* page = this->pages.back().get();
+					size_t pageCount = std::min(PageSize, count - first);
+
+					if constexpr (HasSerializer<T>::value)
+					{
+						for (size_t i = 0; i < pageCount; ++i)
+						{
+							Serializer<T>::Read(stream, page[i]);
+						}
+					}
+					else
+					{
+						ReadArray(stream, page, pageCount);
+					}
+				}
+
+				if (!stream)
+				{
+					this->Clear();
+					return Status::StreamError;
+				}
+
+				this->changeTicks.assign(count, this->tick);
+				return Status::Ok;
+			}
+		}
+
+		Status WriteComponent(std::ostream& stream, uint32_t entityId) const override
+		{
+			if constexpr (HasSerializer<T>::value)
+			{
+				Serializer<T>::Write(stream, this->Get(entityId));
+			}
+			else if constexpr (std::is_trivially_copyable<T>::value)
+			{
+				WriteValue(stream, this->Get(entityId));
+			}
+			else
+			{
+				return Status::ComponentNotSerializable;
+			}
+
+			return stream ? Status::Ok : Status::StreamError;
+		}
+
+		Status ReadComponent(std::istream& stream, uint32_t entityId) override
+		{
+			T component = T();
+
+			if constexpr (HasSerializer<T>::value)
+			{
+				Serializer<T>::Read(stream, component);
+			}
+			else if constexpr (std::is_trivially_copyable<T>::value)
+			{
+				ReadValue(stream, component);
+			}
+			else
+			{
+				return Status::ComponentNotSerializable;
+			}
+
+			if (!stream)
+			{
+				return Status::StreamError;
+			}
+
+			this->Insert(entityId, component);
+			return Status::Ok;
+		}
+
+		bool IsRaw() const override
+		{
+			return std::is_trivially_copyable<T>::value && !HasSerializer<T>::value;
+		}
+
+		size_t ComponentSize() const override
+		{
+			return sizeof(T);
+		}
+
+		// The section is the owner and sparse counts, both arrays, then the pages at the next aligned offset.
+		// Only the pages holding components are written, removals leave emptied pages allocated behind them.
+		size_t MappedSize() const override
+		{
+			size_t size = IndexBytes(this->owners.size(), this->sparse.size());
+			if constexpr (std::is_trivially_copyable<T>::value)
+			{
+				size += UsedPages(this->owners.size()) * PageBytes;
+			}
+			return size;
+		}
+
+		void SaveMapped(std::ostream& stream) const override
+		{
+			uint32_t count = static_cast<uint32_t>(this->owners.size());
+			uint32_t sparseCount = static_cast<uint32_t>(this->sparse.size());
+
+			WriteValue(stream, count);
+			WriteValue(stream, sparseCount);
+			WriteArray(stream, this->owners.data(), count);
+			WriteArray(stream, this->sparse.data(), sparseCount);
+
+			size_t written = 2 * sizeof(uint32_t) + (static_cast<size_t>(count) + sparseCount) * sizeof(uint32_t);
+			for (; written < IndexBytes(count, sparseCount); ++written)
+			{
+				stream.put(0);
+			}
+
+			if constexpr (std::is_trivially_copyable<T>::value)
+			{
+				// whole pages of PageSize, so components added after mapping fill the last page in place; the
+				// pages of a batch fork are smaller, and the slots they don't have are written as in a new page
+				size_t slots = UsedPages(count) * PageSize;
+				size_t stored = std::min(slots, this->pages.size() << this->pageShift);
+				for (size_t first = 0; first < stored; first += this->PageCapacity())
+				{
+					WriteArray(stream, this->pages[first >> this->pageShift].get(), std::min(this->PageCapacity(), stored - first));
+				}
+
+				const T empty = T();
+				for (size_t i = stored; i < slots; ++i)
+				{
+					WriteValue(stream, empty);
+				}
+			}
+		}
+
+		Status Map(const std::shared_ptr<MappedFile>& file, size_t offset, size_t size, uint32_t entityCount) override
+		{
+			this->Clear();
+
+			if constexpr (!std::is_trivially_copyable<T>::value || alignof(T) > MappedAlignment)
+			{
+				return Status::ComponentNotSerializable;
+			}
+			else
+			{
+				const char* section = file->Data() + offset;
+				if (size < 2 * sizeof(uint32_t))
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				uint32_t count = 0;
+				uint32_t sparseCount = 0;
+				std::memcpy(&count, section, sizeof(uint32_t));
+				std::memcpy(&sparseCount, section + sizeof(uint32_t), sizeof(uint32_t));
+
+				size_t pageCount = UsedPages(count);
+				if (count > entityCount || sparseCount > entityCount || size != IndexBytes(count, sparseCount) + pageCount * PageBytes)
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				const char* index = section + 2 * sizeof(uint32_t);
+				this->owners.resize(count);
+				this->sparse.resize(sparseCount);
+				// an empty vector's data() may be null, which memcpy doesn't take even for 0 bytes
+				if (count != 0)
+				{
+					std::memcpy(this->owners.data(), index, count * sizeof(uint32_t));
+				}
+				if (sparseCount != 0)
+				{
+					std::memcpy(this->sparse.data(), index + count * sizeof(uint32_t), sparseCount * sizeof(uint32_t));
+				}
+
+				// the index must be consistent, or later inserts and removals would write outside the pages
+				for (uint32_t entityId = 0; entityId < sparseCount; ++entityId)
+				{
+					uint32_t slot = this->sparse[entityId];
+					if (slot != 0 && (slot > count || this->owners[slot - 1] != entityId))
+					{
+						this->Clear();
+						return Status::InvalidSnapshot;
+					}
+				}
+
+				for (uint32_t i = 0; i < count; ++i)
+				{
+					if (this->owners[i] >= sparseCount || this->sparse[this->owners[i]] != i + 1)
+					{
+						this->Clear();
+						return Status::InvalidSnapshot;
+					}
+				}
+
+				T* data = reinterpret_cast<T*>(file->Data() + offset + IndexBytes(count, sparseCount));
+				for (size_t page = 0; page < pageCount; ++page)
+				{
+					// shares ownership of the file instead of owning the page
+					this->pages.emplace_back(file, data + page * PageSize);
+				}
+
+				this->changeTicks.assign(count, this->tick);
+				return Status::Ok;
+			}
+		}
+
+	private:
+		// How many pages count components fill.
+		static size_t UsedPages(size_t count)
+		{
+			return (count + PageSize - 1) / PageSize;
+		}
+
+		size_t PageCapacity() const
+		{
+			return size_t(1) << this->pageShift;
+		}
+
+		void SetPageShift(size_t shift)
+		{
+			this->pageShift = shift;
+			this->pageMask = (size_t(1) << shift) - 1;
+		}
+
+		// Copies the count components from index first on into out.
+		void CopyRun(size_t first, size_t count, T* out) const
+		{
+			while (count != 0)
+			{
+				size_t offset = first & this->pageMask;
+				size_t run = std::min(count, this->PageCapacity() - offset);
+				const T* source = this->pages[first >> this->pageShift].get() + offset;
+
+				out = std::copy(source, source + run, out);
+				first += run;
+				count -= run;
+			}
+		}
+
+		// Size of the index part of a mapped section, which ends at an aligned offset.
+		static size_t IndexBytes(size_t count, size_t sparseCount)
+		{
+			return AlignMapped((2 + count + sparseCount) * sizeof(uint32_t));
+		}
+
+		// Gives the page a copy of its own if another container still uses it.
+		void UnsharePage(size_t page)
+		{
+			if (page >= this->sharedPages.size() || !this->sharedPages[page])
+			{
+				return;
+			}
+
+			if (this->pages[page].use_count() != 1)
+			{
+				std::shared_ptr<T[]> copy(new T[this->PageCapacity()]);
+				std::copy(this->pages[page].get(), this->pages[page].get() + this->PageCapacity(), copy.get());
+				this->pages[page] = std::move(copy);
+			}
+
+			this->MarkUnshared(page);
+		}
+
+		void MarkUnshared(size_t page)
+		{
+			if (page < this->sharedPages.size() && this->sharedPages[page])
+			{
+				this->sharedPages[page] = false;
+				--this->sharedPageCount;
+			}
+		}
+
+		std::vector<std::shared_ptr<T[]>> pages;
+
+		// every page holds 1 << pageShift components
+		size_t pageShift = PageShift;
+		size_t pageMask = PageSize - 1;
+
+		// sharedPages[i] is set while page i may be shared with a fork, see Fork
+		std::vector<bool> sharedPages;
+		size_t sharedPageCount = 0;
+	};
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// Compile-time configuration for babs-ecs. Every option can be overridden by defining it before
+// including any of the library headers (or on the compiler command line).
+
+// BABS_ECS_PREFETCH(address) hints the CPU to start loading the cache line holding address.
+// It's a no-op on compilers without a prefetch intrinsic.
+#ifndef BABS_ECS_PREFETCH
+#if defined(__GNUC__) || defined(__clang__)
+#define BABS_ECS_PREFETCH(address) __builtin_prefetch(address)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#define BABS_ECS_PREFETCH(address) _mm_prefetch(reinterpret_cast<const char*>(address), _MM_HINT_T0)
+#else
+#define BABS_ECS_PREFETCH(address) ((void)(address))
+#endif
+#endif
+
+// BABS_ECS_PREFETCH_DISTANCE is how many elements ahead batched lookups (e.g. ECSManager::Gather)
+// start loading data before it's used.
+#ifndef BABS_ECS_PREFETCH_DISTANCE
+#define BABS_ECS_PREFETCH_DISTANCE 8
+#endif
+
+// BABS_ECS_NO_EXCEPTIONS builds the library without a single throw, e.g. for targets compiled with
+// -fno-exceptions, where it's detected automatically. Errors are then reported through the Try* functions
+// and the default check level below becomes BABS_ECS_CHECK_ASSERT.
+#ifndef BABS_ECS_NO_EXCEPTIONS
+#if defined(_MSC_VER) && !defined(__clang__)
+#if !defined(_CPPUNWIND)
+#define BABS_ECS_NO_EXCEPTIONS
+#endif
+#elif !defined(__cpp_exceptions)
+#define BABS_ECS_NO_EXCEPTIONS
+#endif
+#endif
+
+// BABS_ECS_CHECK_LEVEL controls how misuse (unregistered components, missing entities) is detected:
+//   BABS_ECS_CHECK_NONE   - nothing is validated and misuse is undefined behavior; for release builds of hot loops
+//   BABS_ECS_CHECK_ASSERT - checks are assert()s, so they also disappear when NDEBUG is defined
+//   BABS_ECS_CHECK_THROW  - the friendly exceptions from Exceptions.hpp are thrown (default unless BABS_ECS_NO_EXCEPTIONS)
+#define BABS_ECS_CHECK_NONE 0
+#define BABS_ECS_CHECK_ASSERT 1
+#define BABS_ECS_CHECK_THROW 2
+
+#ifndef BABS_ECS_CHECK_LEVEL
+#ifdef BABS_ECS_NO_EXCEPTIONS
+#define BABS_ECS_CHECK_LEVEL BABS_ECS_CHECK_ASSERT
+#else
+#define BABS_ECS_CHECK_LEVEL BABS_ECS_CHECK_THROW
+#endif
+#endif
+
+#if BABS_ECS_CHECK_LEVEL >= BABS_ECS_CHECK_THROW && defined(BABS_ECS_NO_EXCEPTIONS)
+#error "BABS_ECS_CHECK_THROW can't be used with BABS_ECS_NO_EXCEPTIONS, pick BABS_ECS_CHECK_ASSERT or BABS_ECS_CHECK_NONE"
+#endif
+
+// BABS_ECS_CHECK(condition, exception) validates condition according to BABS_ECS_CHECK_LEVEL.
+// The exception expression is only evaluated when the check fails.
+#if BABS_ECS_CHECK_LEVEL >= BABS_ECS_CHECK_THROW
+#define BABS_ECS_CHECK(condition, exception) do { if (!(condition)) { throw exception; } } while (0)
+#elif BABS_ECS_CHECK_LEVEL == BABS_ECS_CHECK_ASSERT
+#include <cassert>
+#define BABS_ECS_CHECK(condition, exception) assert(condition)
+#else
+#define BABS_ECS_CHECK(condition, exception) ((void)0)
+#endif
+
+// BABS_ECS_MMAP is 1 when mapped snapshots (see ECSManager::MapSnapshot) use POSIX mmap, so only the
+// pages that are touched get read. Define it to 0 to read the whole file into memory instead, which
+// is also what other platforms do.
+#ifndef BABS_ECS_MMAP
+#if defined(__unix__) || defined(__APPLE__)
+#define BABS_ECS_MMAP 1
+#else
+#define BABS_ECS_MMAP 0
+#endif
+#endif
+
+// BABS_ECS_ROLLBACK_FRAMES is how many frames ECSManager::CaptureFrame keeps before reusing the oldest one.
+#ifndef BABS_ECS_ROLLBACK_FRAMES
+#define BABS_ECS_ROLLBACK_FRAMES 16
+#endif
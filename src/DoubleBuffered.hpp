@@ -0,0 +1,53 @@
+#pragma once
+
+#include <type_traits>
+
+namespace babs_ecs
+{
+	// DoubleBuffered<T> is a component storage policy for systems that run in parallel over the same component.
+	// Every system reads the previous frame's value through Read() and writes the next frame's value through
+	// Write(), so no system ever sees a half updated frame and no locks or ordering are needed. At the frame
+	// barrier, ECSManager::SwapBuffers publishes the written values as the new readable state.
+	//
+	// Typical usage:
+	//   ecs.RegisterComponent<babs_ecs::DoubleBuffered<Boid>>();
+	//   ecs.AddComponent(e, babs_ecs::DoubleBuffered<Boid>(Boid{ ... }));
+	//   auto* boid = ecs.GetComponent<babs_ecs::DoubleBuffered<Boid>>(e);  // on any worker thread
+	//   boid->Write().velocity = Steer(boid->Read(), neighbours);
+	//   ecs.SwapBuffers();                                              // once all workers are done
+	template <typename T>
+	struct DoubleBuffered
+	{
+		DoubleBuffered() : current(), next() {}
+		DoubleBuffered(const T& value) : current(value), next(value) {}
+
+		// Read returns the state published at the last SwapBuffers.
+		const T& Read() const
+		{
+			return this->current;
+		}
+
+		// Write returns the state that becomes readable at the next SwapBuffers. It starts out as a copy
+		// of the readable state, so systems only have to write the fields they change.
+		T& Write()
+		{
+			return this->next;
+		}
+
+		// Swap publishes the written state. It's called for every entity by ECSManager::SwapBuffers.
+		void Swap()
+		{
+			this->current = this->next;
+		}
+
+	private:
+		T current;
+		T next;
+	};
+
+	template <typename T>
+	struct IsDoubleBuffered : std::false_type {};
+
+	template <typename T>
+	struct IsDoubleBuffered<DoubleBuffered<T>> : std::true_type {};
+}
@@ -0,0 +1,98 @@
+#include "doctest.h"
+
+#include <thread>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "DoubleBuffered.hpp"
+
+struct Cell
+{
+	int alive;
+	int generation;
+};
+
+TEST_SUITE("Double buffered components")
+{
+	TEST_CASE("Writes become readable only after SwapBuffers")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<babs_ecs::DoubleBuffered<Cell>>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, babs_ecs::DoubleBuffered<Cell>(Cell{ 1, 0 }));
+
+		auto* cell = ecs.GetComponent<babs_ecs::DoubleBuffered<Cell>>(e);
+		REQUIRE(cell->Write().alive == 1);
+
+		cell->Write().generation = 1;
+		REQUIRE(cell->Read().generation == 0);
+
+		ecs.SwapBuffers();
+		REQUIRE(cell->Read().generation == 1);
+
+		// the write copy starts from the published state
+		cell->Write().alive = 0;
+		ecs.SwapBuffers<babs_ecs::DoubleBuffered<Cell>>();
+		REQUIRE(cell->Read().alive == 0);
+		REQUIRE(cell->Read().generation == 1);
+	}
+
+	TEST_CASE("Parallel systems read the previous frame of their neighbours")
+	{
+		// rule 90: a cell is alive when exactly one of its neighbours was alive
+		const int cellCount = 256;
+		std::vector<int> expected(cellCount, 0);
+		expected[cellCount / 2] = 1;
+
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<babs_ecs::DoubleBuffered<Cell>>();
+
+		std::vector<babs_ecs::Entity> cells;
+		for (int i = 0; i < cellCount; ++i)
+		{
+			cells.push_back(ecs.CreateEntity());
+			ecs.AddComponent(cells.back(), babs_ecs::DoubleBuffered<Cell>(Cell{ expected[i], 0 }));
+		}
+
+		for (int frame = 0; frame < 32; ++frame)
+		{
+			std::vector<int> next(cellCount);
+			for (int i = 0; i < cellCount; ++i)
+			{
+				next[i] = expected[(i + cellCount - 1) % cellCount] ^ expected[(i + 1) % cellCount];
+			}
+			expected = next;
+
+			std::vector<std::thread> workers;
+			for (int t = 0; t < 4; ++t)
+			{
+				workers.emplace_back([&, t]() {
+					for (int i = t; i < cellCount; i += 4)
+					{
+						auto* left = ecs.GetComponent<babs_ecs::DoubleBuffered<Cell>>(cells[(i + cellCount - 1) % cellCount]);
+						auto* right = ecs.GetComponent<babs_ecs::DoubleBuffered<Cell>>(cells[(i + 1) % cellCount]);
+						auto* cell = ecs.GetComponent<babs_ecs::DoubleBuffered<Cell>>(cells[i]);
+
+						cell->Write().alive = left->Read().alive ^ right->Read().alive;
+						cell->Write().generation++;
+					}
+				});
+			}
+
+			for (auto& worker : workers)
+			{
+				worker.join();
+			}
+
+			ecs.SwapBuffers();
+		}
+
+		for (int i = 0; i < cellCount; ++i)
+		{
+			const auto* cell = ecs.GetComponent<babs_ecs::DoubleBuffered<Cell>>(cells[i]);
+			REQUIRE(cell->Read().alive == expected[i]);
+			REQUIRE(cell->Read().generation == 32);
+		}
+	}
+}
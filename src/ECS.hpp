@@ -1,6 +1,17 @@
 #pragma once
 
+#include "Config.hpp"
 #include "ECSManager.hpp"
+#include "CommandBuffer.hpp"
+#include "ComponentContainer.hpp"
+#include "DoubleBuffered.hpp"
 #include "Entity.hpp"
 #include "Events.hpp"
 #include "Exceptions.hpp"
+#include "Interest.hpp"
+#include "Journal.hpp"
+#include "MappedFile.hpp"
+#include "Replication.hpp"
+#include "Serialization.hpp"
+#include "Status.hpp"
+#include "WorldBatch.hpp"
@@ -8,11 +8,28 @@
 #include <typeinfo>
 #include <vector>
 #include <tuple>
+#include <type_traits>
 #include <algorithm>
-#include <queue>
-
+#include <deque>
+#include <functional>
+#include <array>
+#include <atomic>
+#include <utility>
+#include <memory>
+#include <istream>
+#include <ostream>
+#include <sstream>
+#include <cstring>
+#include <limits>
+
+#include "Config.hpp"
+#include "ComponentContainer.hpp"
+#include "DoubleBuffered.hpp"
+#include "MappedFile.hpp"
+#include "Serialization.hpp"
 #include "bitfield/bitfield.hpp"
 #include "Exceptions.hpp"
+#include "Status.hpp"
 #include "Entity.hpp"
 #include "events/EventManager.hpp"
 #include "Events.hpp"
@@ -28,393 +45,2473 @@ namespace babs_ecs
 		}
 	};
 
-	// Exists to satisfying compiler warnings
-	class BaseContainer
+	// Hands out the next process-wide component type id. See ComponentTypeId.
+	inline uint32_t NextComponentTypeId()
 	{
-	public:
-		BaseContainer() {};
-		virtual ~BaseContainer() {};
+		static std::atomic<uint32_t> nextId{ 0 };
+		return nextId++;
+	}
+
+	// FrameHandle identifies a frame saved by ECSManager::CaptureFrame.
+	struct FrameHandle
+	{
+		uint32_t sequence = 0;
 	};
 
-	// This would be the concrete type created by RegisterComponent and inserted into the map.
-	// This container will hold all of the component data for a specific component type.
-	template <typename T>
-	class ComponentContainer : public BaseContainer
+	// HistoryCursor identifies a consumer of the removal history opened by ECSManager::OpenHistory.
+	struct HistoryCursor
 	{
-	public:
-		ComponentContainer() {};
-		virtual ~ComponentContainer() {};
-		std::map<Entity, T, EntityComparer> data;
+		uint32_t id = 0;
 	};
 
+	// ComponentTypeId returns a small sequential id per component type, shared by every manager. It's used
+	// to index per-manager tables so hot paths don't have to build and compare typeid name strings.
+	template <typename T>
+	inline uint32_t ComponentTypeId()
+	{
+		static const uint32_t id = NextComponentTypeId();
+		return id;
+	}
+
 	// ECSManageris the manager of the whole dealio.
+	//
+	// Thread safety: const member functions never modify the manager, so any number of threads can query
+	// and read components through a const ECSManager& concurrently, as long as no thread changes the
+	// world's structure at the same time (creating/removing entities, registering/adding/removing
+	// components, Enable/Disable). The non-const overloads of the component getters (GetComponent(s),
+	// GetUnchecked, Gather, ForEachGathered) are the same lookups plus stamping the component's change tick,
+	// so fetching and writing the components of different entities from different threads is fine too;
+	// DoubleBuffered components extend that to systems reading each other's entities.
+	//
+	// A world that shares component pages with a fork (see Fork) copies a page the first time it's written
+	// to, so until Unshare is called, its non-const getters must not be called from several threads at once.
+	// Different worlds can always be used from different threads, forks included.
 	class ECSManager {
 	public:
+		// QueryHandler is called with the entity whose component mask started or stopped matching a query.
+		using QueryHandler = std::function<void(Entity)>;
 
 		events::EventManager events;
 
+		// DisabledFlag is the bit reserved in every entity bitfield to mark it as disabled.
+		// Disabled entities keep their components but are skipped by queries.
+		static constexpr bitfield::Bitfield DisabledFlag = 0x80000000;
+
+		// RollbackFrames is how many frames CaptureFrame keeps, see BABS_ECS_ROLLBACK_FRAMES.
+		static constexpr uint32_t RollbackFrames = BABS_ECS_ROLLBACK_FRAMES;
+
 		ECSManager()
 		{
 			this->bitIndex = 1;
 			this->entityIndex = 1;  // 0 is used for default/dummy entity
+			this->entities.emplace_back();
+			this->tick = 0;
+			this->entityTicks.push_back(0);
 		}
 
 		// CreateEntity will initialize and return a new entity with no components.
 		Entity CreateEntity()
 		{
+			// reserved entities take their table slots first so the table stays dense
+			this->FlushReservedEntities();
+
 			uint32_t entityId = 1;
 
 			if (!this->unusedEntityIndices.empty())
 			{
 				entityId = this->unusedEntityIndices.front();
-				this->unusedEntityIndices.pop();
+				this->unusedEntityIndices.pop_front();
 			}
 			else
 			{
-				entityId = this->entityIndex;
-				entityIndex++;
+				entityId = this->entityIndex++;
 			}
 
 			Entity e = Entity(entityId);
-			this->entities.insert({ e.UUID, e });
+			if (entityId == this->entities.size())
+			{
+				this->entities.push_back(e);
+			}
+			else
+			{
+				this->entities[entityId] = e;
+			}
+			this->StampEntity(entityId);
 
 			EntityCreated entityCreated(e);
 			this->events.Broadcast(entityCreated);
 			return e;
 		}
 
+		// ReserveEntity hands out the UUID of a new entity and can be called from any number of threads at once,
+		// since it only takes an atomic counter. Like CreateEntity, it recycles the UUIDs of removed entities
+		// first, so spawning and despawning through reservations keeps the entity table the same size. The
+		// entity only exists (and components can only be added to it) after the next FlushReservedEntities or
+		// CreateEntity on the owning thread; see CommandBuffer for deferring the component setup of reserved
+		// entities. No structural change may happen while other threads reserve entities.
+		Entity ReserveEntity()
+		{
+			// hands out the front of the recycle queue without popping it, which only the owning thread does
+			uint32_t slot = this->reservedRecycled.load(std::memory_order_relaxed);
+			while (slot < this->unusedEntityIndices.size())
+			{
+				if (this->reservedRecycled.compare_exchange_weak(slot, slot + 1, std::memory_order_relaxed))
+				{
+					return Entity(this->unusedEntityIndices[slot]);
+				}
+			}
+
+			return Entity(this->entityIndex.fetch_add(1, std::memory_order_relaxed));
+		}
+
+		// FlushReservedEntities adds every entity reserved so far to the entity table and fires their
+		// EntityCreated events. It must not overlap with ReserveEntity calls (e.g. call it after the worker
+		// threads joined) or any other structural change.
+		void FlushReservedEntities()
+		{
+			uint32_t reservedEnd = this->entityIndex.load(std::memory_order_acquire);
+			uint32_t recycledCount = this->reservedRecycled.exchange(0, std::memory_order_acquire);
+
+			if (recycledCount == 0 && reservedEnd <= this->entities.size())
+			{
+				return;
+			}
+
+			// taken off the queue before any handler runs, since handlers may create entities themselves
+			std::vector<uint32_t> recycled(this->unusedEntityIndices.begin(), this->unusedEntityIndices.begin() + recycledCount);
+			this->unusedEntityIndices.erase(this->unusedEntityIndices.begin(), this->unusedEntityIndices.begin() + recycledCount);
+
+			for (uint32_t entityId : recycled)
+			{
+				this->entities[entityId] = Entity(entityId);
+				this->StampEntity(entityId);
+			}
+
+			uint32_t firstReserved = static_cast<uint32_t>(this->entities.size());
+
+			this->entities.reserve(reservedEnd);
+			for (uint32_t entityId = firstReserved; entityId < reservedEnd; ++entityId)
+			{
+				this->entities.emplace_back(entityId);
+				this->StampEntity(entityId);
+			}
+
+			for (uint32_t entityId : recycled)
+			{
+				EntityCreated entityCreated(this->entities[entityId]);
+				this->events.Broadcast(entityCreated);
+			}
+
+			for (uint32_t entityId = firstReserved; entityId < reservedEnd; ++entityId)
+			{
+				EntityCreated entityCreated(this->entities[entityId]);
+				this->events.Broadcast(entityCreated);
+			}
+		}
+
 		template <typename T>
 		void RegisterComponent();
 
+		template <typename T>
+		Status TryRegisterComponent();
+
+		template <typename T>
+		void SwapBuffers();
+
+		// SwapBuffers is the frame barrier for DoubleBuffered components: the values written during the frame
+		// become readable by every registered DoubleBuffered component type. Like any structural change, no
+		// other thread may use the manager while it runs.
+		void SwapBuffers()
+		{
+			for (BaseContainer* container : this->doubleBufferedContainers)
+			{
+				container->SwapBuffers();
+			}
+		}
+
 		template <typename T>
 		void AddComponent(Entity entity, T component);
 
+		template <typename... Ts>
+		void AddComponents(Entity entity, Ts... components);
+
 		template <typename T>
 		void RemoveComponent(Entity entity);
 
+		template <typename... Ts>
+		void RemoveComponents(Entity entity);
+
 		template <typename T>
 		T* GetComponent(Entity entity);
 
-		template<typename... Ts>
-		std::vector<Entity> EntitiesWith();
+		template <typename T>
+		const T* GetComponent(Entity entity) const;
+
+		template <typename... Ts>
+		std::tuple<Ts*...> GetComponents(Entity entity);
+
+		template <typename... Ts>
+		std::tuple<const Ts*...> GetComponents(Entity entity) const;
 
 		template <typename T>
-		bool HasComponent(Entity entity);
+		T& GetUnchecked(Entity entity);
 
-		void RemoveEntity(Entity entity)
-		{
-			uint32_t entityId = entity.UUID;
-			size_t originalSize = this->entities.size();
+		template <typename T>
+		const T& GetUnchecked(Entity entity) const;
 
-			this->entities.erase(entity.UUID);
+		template <typename T>
+		void Gather(const Entity* entities, size_t count, T** out);
 
-			if (originalSize == this->entities.size())
-			{
-				throw EntityNotFoundException(entityId);
-			}
+		template <typename T>
+		void Gather(const Entity* entities, size_t count, const T** out) const;
 
-			this->unusedEntityIndices.push(entityId);
+		template <typename T>
+		void Gather(const std::vector<Entity>& entities, T** out);
 
-			std::map<std::string, std::vector<Entity>>::iterator it;
-			for (it = this->individualComponentVecs.begin(); it != this->individualComponentVecs.end(); ++it)
-			{
-				std::string name = it->first;
+		template <typename T>
+		void Gather(const std::vector<Entity>& entities, const T** out) const;
 
-				auto specificVecIt = this->individualComponentVecs[name].begin();
-				while (specificVecIt != this->individualComponentVecs[name].end())
-				{
-					if (entity.UUID == specificVecIt->UUID)
-					{
-						this->individualComponentVecs[name].erase(specificVecIt);
-						break;
-					}
-					++specificVecIt;
-				}
-			}
-		}
+		template <typename T, typename Func>
+		void ForEachGathered(const Entity* entities, size_t count, Func&& func);
 
-	private:
-		std::queue<uint32_t> unusedEntityIndices;
-		uint32_t entityIndex;
-		bitfield::Bitfield bitIndex;
-		std::map<uint32_t, Entity> entities;
+		template <typename T, typename Func>
+		void ForEachGathered(const Entity* entities, size_t count, Func&& func) const;
+
+		template <typename T, typename Func>
+		void ForEachGathered(const std::vector<Entity>& entities, Func&& func);
+
+		template <typename T, typename Func>
+		void ForEachGathered(const std::vector<Entity>& entities, Func&& func) const;
+
+		template<typename... Ts>
+		std::vector<Entity> EntitiesWith() const;
+
+		template <typename T, typename Func>
+		void ForEach(Func&& func);
 
-		std::map<std::string, BaseContainer*> components;
-		std::map<std::string, bitfield::Bitfield> componentIndex;
+		template <typename T, typename Func>
+		void ForEach(Func&& func) const;
 
-		std::map<std::string, std::vector<Entity>> individualComponentVecs;
+		template <typename... Ts, typename Func>
+		void ForEachChangedSince(uint32_t sinceTick, Func&& func) const;
 
-		std::vector<std::string> registeredComponents;
+		template <typename... Ts>
+		bool MatchesQuery(Entity entity) const;
 
 		template <typename T>
-		std::string GetComponentName();
+		bool HasComponent(Entity entity) const;
 
-		template <typename T, typename... Ts>
-		std::vector<std::string> GetComponentNames();
+		template <typename... Ts>
+		Status TryAddComponents(Entity entity, Ts... components);
 
-		bool ComponentIsRegistered(std::string componentName)
-		{
-			return std::find(this->registeredComponents.begin(), this->registeredComponents.end(), componentName) != this->registeredComponents.end();
-		}
-	};
+		template <typename... Ts>
+		Status TryRemoveComponents(Entity entity);
 
-	// RegisterComponent will let ECS know of a new component type it needs to keep track of.
-	//
-	// Until this is called, components cannot be added/retrieved.
-	template<typename T>
-	inline void ECSManager::RegisterComponent()
-	{
-		// Example: "class TestComponent", "struct Health", "struct Identity"
-		// using typeid(T).name() means we don't need to rely on ToString();
-		std::string componentName = this->GetComponentName<T>();
+		template <typename T>
+		Result<T*> TryGetComponent(Entity entity);
 
-		if (components.find(componentName) == components.end())
-		{
-			componentIndex[componentName] = bitIndex;
-			components[componentName] = new ComponentContainer<T>();
+		template <typename T>
+		Result<const T*> TryGetComponent(Entity entity) const;
 
-			// set the next bit index
-			unsigned int lastIndex = bitIndex;
-			bitIndex *= 2;
-			if (bitIndex < lastIndex)
+		template <typename... Ts>
+		Result<std::vector<Entity>> TryEntitiesWith() const;
+
+		// TryRemoveEntity is RemoveEntity reporting a missing entity as a Status instead of throwing.
+		Status TryRemoveEntity(Entity entity)
+		{
+			if (this->FindEntity(entity.UUID) == nullptr)
 			{
-				throw std::out_of_range("Exceeded available flags for the bitfield! (max 32 b/c uint32)");
+				return Status::EntityNotFound;
 			}
 
-			registeredComponents.emplace_back(componentName);
+			this->RemoveEntity(entity);
+			return Status::Ok;
 		}
-	}
 
-	// AddComponent will add the component to the entity. It can be retrieved later with ecs.GetComponent(...)
-	template<typename T>
-	inline void ECSManager::AddComponent(Entity entity, T component)
-	{
-		std::string componentName = this->GetComponentName<T>();
+		template <typename... Ts>
+		void OnEnter(QueryHandler handler);
+
+		template <typename... Ts>
+		void OnExit(QueryHandler handler);
 
-		if (!this->ComponentIsRegistered(componentName))
+		void RemoveEntity(Entity entity)
 		{
-			throw babs_ecs::ComponentNotRegisteredException(componentName);
-		}
+			uint32_t entityId = entity.UUID;
 
-		// get the container for this component and add the component data to this entity
-		ComponentContainer<T>* container = dynamic_cast<ComponentContainer<T>*>(this->components[componentName]);
-		container->data[entity] = component;
-		int componentFlag = componentIndex[componentName];
+			Entity* stored = this->FindEntity(entityId);
+			BABS_ECS_CHECK(stored != nullptr, EntityNotFoundException(entityId));
 
-		auto mapIterator = this->entities.find(entity.UUID);
+			// the entity leaves every query it matched while its components are still readable
+			this->NotifyQueryObservers(*stored, stored->bitfield, 0);
 
-		if (mapIterator == this->entities.end())
-		{
-			throw std::runtime_error("Failed to find entity to add component to");
-		}
+			bitfield::Bitfield removedBitfield = stored->bitfield;
+			*stored = Entity();
 
-		mapIterator->second.bitfield = bitfield::Set(mapIterator->second.bitfield, componentFlag);
-		Entity e = mapIterator->second;
+			this->unusedEntityIndices.push_back(entityId);
+			this->RecordRemoval(this->destroyedEntities, entityId);
 
-		// make sure this entity is in the component specific list of entities
-		auto iter = this->individualComponentVecs.find(componentName);
-		if (iter != this->individualComponentVecs.end())
-		{
-			iter->second.push_back(e);
+			// only the containers of components the entity had can hold its data
+			for (auto& component : this->components)
+			{
+				if (bitfield::Has(removedBitfield, component.second->flag))
+				{
+					component.second->Remove(entityId);
+				}
+			}
 		}
-		else
+
+		// Disable hides the entity from every query without touching its components, so it can be
+		// pooled and later brought back with Enable. Disabling a disabled entity does nothing.
+		void Disable(Entity entity)
 		{
-			std::vector<Entity> entityList;
-			entityList.push_back(e);
-			this->individualComponentVecs.insert(std::pair<std::string, std::vector<Entity>>(componentName, entityList));
+			Entity* stored = this->FindEntity(entity.UUID);
+			BABS_ECS_CHECK(stored != nullptr, EntityNotFoundException(entity.UUID));
+
+			if (bitfield::Has(stored->bitfield, DisabledFlag))
+			{
+				return;
+			}
+
+			bitfield::Bitfield previousBitfield = stored->bitfield;
+			stored->bitfield = bitfield::Set(previousBitfield, DisabledFlag);
+			this->StampEntity(entity.UUID);
+			this->NotifyQueryObservers(*stored, previousBitfield, stored->bitfield);
 		}
 
-		std::map<std::string, std::vector<Entity>>::iterator it;
-		for (it = this->individualComponentVecs.begin(); it != this->individualComponentVecs.end(); ++it)
+		// Enable makes a disabled entity visible to queries again. Enabling an enabled entity does nothing.
+		void Enable(Entity entity)
 		{
-			auto copiedEntity = std::find(it->second.begin(), it->second.end(), e);
-			if (copiedEntity != it->second.end())
+			Entity* stored = this->FindEntity(entity.UUID);
+			BABS_ECS_CHECK(stored != nullptr, EntityNotFoundException(entity.UUID));
+
+			if (!bitfield::Has(stored->bitfield, DisabledFlag))
 			{
-				copiedEntity->bitfield = e.bitfield;
+				return;
 			}
+
+			bitfield::Bitfield previousBitfield = stored->bitfield;
+			stored->bitfield = bitfield::Clear(previousBitfield, DisabledFlag);
+			this->StampEntity(entity.UUID);
+			this->NotifyQueryObservers(*stored, previousBitfield, stored->bitfield);
 		}
 
-		// fire the component added event
-		babs_ecs::ComponentAdded componentAdded(entity, component);
-		this->events.Broadcast(componentAdded);
-	}
+		// IsEnabled returns false for disabled entities. Throws if the entity doesn't exist.
+		bool IsEnabled(Entity entity) const
+		{
+			const Entity* stored = this->FindEntity(entity.UUID);
+			BABS_ECS_CHECK(stored != nullptr, EntityNotFoundException(entity.UUID));
 
-	// GetComponent will return a pointer to the entities component data. Modifications to the component will persist.
-	template<typename T>
-	inline void ECSManager::RemoveComponent(Entity entity)
-	{
-		std::string componentName = this->GetComponentName<T>();
+			return !bitfield::Has(stored->bitfield, DisabledFlag);
+		}
 
-		if (!this->ComponentIsRegistered(componentName))
+		// SaveSnapshot writes the whole world (entity table, recycled UUIDs, disabled entities and every
+		// registered component) as binary data. Trivially copyable components are copied a page at a time
+		// without any per-component work; other components need a Serializer<T>. Entities reserved but not
+		// flushed yet aren't part of the world and aren't saved.
+		//
+		// Typical usage: std::ofstream file("save.bin", std::ios::binary); ecs.SaveSnapshot(file);
+		Status SaveSnapshot(std::ostream& stream) const
 		{
-			throw babs_ecs::ComponentNotRegisteredException(componentName);
-		}
+			uint32_t entityCount = static_cast<uint32_t>(this->entities.size());
 
-		int componentFlag = componentIndex[componentName];
+			WriteValue(stream, SnapshotMagic);
+			WriteValue(stream, SnapshotVersion);
+			WriteValue(stream, entityCount);
 
-		auto mapIterator = this->entities.find(entity.UUID);
+			std::vector<uint32_t> disabled;
+			for (uint32_t entityId = 0; entityId < entityCount; ++entityId)
+			{
+				const Entity& e = this->entities[entityId];
+				WriteValue(stream, e.UUID);
 
-		if (mapIterator == this->entities.end())
-		{
-			throw std::runtime_error("Failed to find entity to add component to");
-		}
+				if (e.UUID != 0 && bitfield::Has(e.bitfield, DisabledFlag))
+				{
+					disabled.push_back(e.UUID);
+				}
+			}
 
-		// first we clear its bitfield
-		mapIterator->second.bitfield = bitfield::Clear(mapIterator->second.bitfield, componentFlag);
+			WriteValue(stream, static_cast<uint32_t>(disabled.size()));
+			WriteArray(stream, disabled.data(), disabled.size());
+
+			WriteValue(stream, static_cast<uint32_t>(this->unusedEntityIndices.size()));
+			for (uint32_t entityId : this->unusedEntityIndices)
+			{
+				WriteValue(stream, entityId);
+			}
 
-		// now we remove it from the component specific list
-		auto componentVector = this->individualComponentVecs.find(componentName);
+			WriteValue(stream, static_cast<uint32_t>(this->components.size()));
+			for (const auto& component : this->components)
+			{
+				WriteString(stream, component.first);
 
-		if (componentVector == this->individualComponentVecs.end())
-		{
-			// Nothing to remove
-			return;
+				Status status = component.second->Save(stream);
+				if (status != Status::Ok)
+				{
+					return status;
+				}
+			}
+
+			return stream ? Status::Ok : Status::StreamError;
 		}
 
-		for (std::vector<Entity>::iterator it = componentVector->second.begin(); it != componentVector->second.end(); ++it)
+		// LoadSnapshot replaces the world with one written by SaveSnapshot. Every component type in the
+		// snapshot must be registered (registered types missing from it end up empty) and the snapshot must
+		// come from a build with the same component layouts. Events and query observers don't fire.
+		//
+		// A stream that isn't a snapshot leaves the world untouched; any other failure leaves it empty.
+		Status LoadSnapshot(std::istream& stream)
 		{
-			if (it->UUID == mapIterator->first)
+			uint32_t magic = 0;
+			uint32_t version = 0;
+			ReadValue(stream, magic);
+			ReadValue(stream, version);
+
+			if (!stream)
+			{
+				return Status::StreamError;
+			}
+
+			if (magic != SnapshotMagic || version != SnapshotVersion)
+			{
+				return Status::InvalidSnapshot;
+			}
+
+			Status status = this->ReadSnapshot(stream);
+			if (status != Status::Ok)
 			{
-				ComponentContainer<T>* container = dynamic_cast<ComponentContainer<T>*>(this->components[componentName]);
-				T componentData = container->data[entity];
+				this->Clear();
+			}
+
+			return status;
+		}
 
-				componentVector->second.erase(it);
+		// SaveMappedSnapshot writes the world like SaveSnapshot, but in the layout MapSnapshot can use in place:
+		// every component type gets a section at an aligned offset holding its index and whole pages of raw
+		// component data. Components with a Serializer are written as in SaveSnapshot and still deserialized.
+		//
+		// Typical usage: std::ofstream file("level.map", std::ios::binary); ecs.SaveMappedSnapshot(file);
+		Status SaveMappedSnapshot(std::ostream& stream) const
+		{
+			uint32_t entityCount = static_cast<uint32_t>(this->entities.size());
+
+			std::vector<uint32_t> unused(this->unusedEntityIndices.begin(), this->unusedEntityIndices.end());
 
-				std::map<std::string, std::vector<Entity>>::iterator mapIt;
-				for (mapIt = this->individualComponentVecs.begin(); mapIt != this->individualComponentVecs.end(); ++mapIt)
+			// non raw components are serialized up front, since their size is only known afterwards
+			std::vector<std::string> serialized(this->components.size());
+			std::vector<uint64_t> sizes;
+			size_t headerSize = 5 * sizeof(uint32_t) + sizeof(uint64_t) + unused.size() * sizeof(uint32_t);
+			size_t index = 0;
+			for (const auto& component : this->components)
+			{
+				const BaseContainer* container = component.second.get();
+				if (container->IsRaw())
+				{
+					sizes.push_back(container->MappedSize());
+				}
+				else
 				{
-					auto copiedEntity = std::find(mapIt->second.begin(), mapIt->second.end(), mapIterator->second);
-					if (copiedEntity != mapIt->second.end())
+					std::ostringstream section;
+					Status status = container->Save(section);
+					if (status != Status::Ok)
 					{
-						copiedEntity->bitfield = mapIterator->second.bitfield;
+						return status;
 					}
+
+					serialized[index] = section.str();
+					sizes.push_back(serialized[index].size());
 				}
 
-				// fire the component removed event
-				babs_ecs::ComponentRemoved componentRemoved(entity, componentData);
-				this->events.Broadcast(componentRemoved);
-				break;
+				headerSize += sizeof(uint32_t) + component.first.size() + sizeof(uint32_t) + 3 * sizeof(uint64_t);
+				++index;
 			}
-		}
-	}
 
-	template<typename T>
-	inline T* ECSManager::GetComponent(Entity entity)
-	{
-		std::string componentName = this->GetComponentName<T>();
+			uint64_t entitiesOffset = AlignMapped(headerSize);
+			uint64_t offset = AlignMapped(entitiesOffset + entityCount * sizeof(Entity));
 
-		if (!this->ComponentIsRegistered(componentName))
-		{
-			throw babs_ecs::ComponentNotRegisteredException(componentName);
-		}
+			WriteValue(stream, MappedSnapshotMagic);
+			WriteValue(stream, SnapshotVersion);
+			WriteValue(stream, entityCount);
+			WriteValue(stream, static_cast<uint32_t>(unused.size()));
+			WriteValue(stream, static_cast<uint32_t>(this->components.size()));
+			WriteValue(stream, entitiesOffset);
+			WriteArray(stream, unused.data(), unused.size());
 
-		int componentFlag = componentIndex[componentName];
+			index = 0;
+			for (const auto& component : this->components)
+			{
+				const BaseContainer* container = component.second.get();
+				WriteString(stream, component.first);
+				WriteValue(stream, static_cast<uint32_t>(container->IsRaw() ? 1 : 0));
+				WriteValue(stream, static_cast<uint64_t>(container->ComponentSize()));
+				WriteValue(stream, offset);
+				WriteValue(stream, sizes[index]);
+
+				offset = AlignMapped(offset + sizes[index]);
+				++index;
+			}
 
-		auto mapIterator = this->entities.find(entity.UUID);
+			uint64_t written = headerSize;
+			auto pad = [&](uint64_t target) {
+				for (; written < target; ++written)
+				{
+					stream.put(0);
+				}
+			};
 
-		if (mapIterator == this->entities.end())
-		{
-			return nullptr;
-		}
+			pad(entitiesOffset);
+			WriteArray(stream, this->entities.data(), entityCount);
+			written += entityCount * sizeof(Entity);
 
-		if (bitfield::Has(mapIterator->second.bitfield, componentFlag))
-		{
-			ComponentContainer<T>* container = dynamic_cast<ComponentContainer<T>*>(this->components[componentName]);
-			return &container->data[entity];
-		}
+			index = 0;
+			for (const auto& component : this->components)
+			{
+				pad(AlignMapped(written));
 
-		return nullptr;
-	}
+				const BaseContainer* container = component.second.get();
+				if (container->IsRaw())
+				{
+					container->SaveMapped(stream);
+				}
+				else
+				{
+					stream.write(serialized[index].data(), static_cast<std::streamsize>(serialized[index].size()));
+				}
 
-	template<typename T, typename... Ts>
-	inline std::vector<std::string> ECSManager::GetComponentNames()
-	{
-		std::vector<std::string> names;
+				written += sizes[index];
+				++index;
+			}
 
-		if constexpr (sizeof...(Ts) == 0)
-		{
-			// this is effectively the "base case" if you were to think of this like recursion
-			names.push_back(typeid(T).name());
+			return stream ? Status::Ok : Status::StreamError;
 		}
-		else
+
+		// MapSnapshot replaces the world with a snapshot written by SaveMappedSnapshot without deserializing its
+		// components: raw component pages are used straight from the memory mapped file, which is only read
+		// as pages get touched (see BABS_ECS_MMAP). Changes stay in memory and never reach the file. While the
+		// world uses it, the file may be deleted or replaced by a new file but must not be rewritten in place.
+		// The same rules as LoadSnapshot apply otherwise.
+		//
+		// Typical usage: if (ecs.MapSnapshot("level.map") != babs_ecs::Status::Ok) { ... }
+		Status MapSnapshot(const std::string& path)
 		{
-			// we must still have more component names to retrieve, continue templating
-			names = GetComponentNames<Ts...>();
-			names.push_back(GetComponentNames<T>()[0]);
-		}
+			std::shared_ptr<MappedFile> file = MappedFile::Open(path);
+			if (file == nullptr)
+			{
+				return Status::StreamError;
+			}
 
-		return names;
-	}
+			uint32_t header[2] = { 0, 0 };
+			std::memcpy(header, file->Data(), std::min(file->Size(), sizeof(header)));
+			if (header[0] != MappedSnapshotMagic || header[1] != SnapshotVersion)
+			{
+				return Status::InvalidSnapshot;
+			}
 
-	// Returns a list of Entity pointers of entities matching the provided list of component types.
-	//
-	// If no component types are provided, all entities will be returned.
-	// 
-	// Typical usage: auto entities = ecs.EntitiesWith<Identity, Health>();
-	template<typename ...Ts>
-	inline std::vector<Entity> ECSManager::EntitiesWith()
-	{
-		// build bitfield flags for this search
-		std::vector<std::string> componentNames;
-		if constexpr (sizeof...(Ts) > 0)
-		{
-			componentNames = this->GetComponentNames<Ts...>();
+			Status status = this->ReadMappedSnapshot(file);
+			if (status != Status::Ok)
+			{
+				this->Clear();
+			}
+
+			return status;
 		}
 
-		// if no components were provided, we'll return all entities
-		if (componentNames.size() == 0)
+		// CurrentTick is the tick stamped on every change made to the world, see AdvanceTick.
+		uint32_t CurrentTick() const
 		{
-			// Asking for all entities
-			std::vector<Entity> requestedEntities;
-			for (auto e : this->entities)
-			{
-				requestedEntities.push_back(e.second);
-			}
-			return requestedEntities;
+			return this->tick;
 		}
 
-		// looks like they asked for 1+ components. first we'll get the current size of
-		// each component specific list
-		std::vector<std::tuple<std::string, int>> componentListSizes;
-		for (auto componentName : componentNames)
+		// AdvanceTick starts a new tick and returns it. Changes are stamped with the tick in which they happen,
+		// which is what lets WriteDelta pick the changes made since a given tick. It's usually called once per
+		// frame or before each autosave.
+		uint32_t AdvanceTick()
 		{
-			if (!this->ComponentIsRegistered(componentName))
+			++this->tick;
+			for (auto& component : this->components)
 			{
-				throw babs_ecs::ComponentNotRegisteredException(componentName);
+				component.second->tick = this->tick;
+				component.second->ReserveChanges();
 			}
 
-			auto vec = &this->individualComponentVecs[componentName];
-			componentListSizes.push_back(std::make_tuple(componentName, vec->size()));
+			return this->tick;
 		}
 
-		// now we'll build our search bitfield
-		bitfield::Bitfield field = 0;
-		for (auto name : componentNames)
+		template <typename T>
+		void MarkChanged(Entity entity);
+
+		// WriteDelta writes every change stamped at or after sinceTick: removed entities, entities created,
+		// enabled or disabled, removed components, and added or changed components. Components are encoded as in
+		// SaveSnapshot. Removals are only there while a history cursor covering sinceTick is open, see OpenHistory.
+		//
+		// Components count as changed when they're added, marked with MarkChanged, or handed out for writing:
+		// by a non-const getter (GetComponent(s), GetUnchecked, TryGetComponent, Gather), or by ForEach and
+		// ForEachGathered to a callback taking T&. The world can't tell whether such a component was actually
+		// written, so systems that only read must go through a const ECSManager& (std::as_const(ecs)) or pass
+		// const T& callbacks, or every component they look at is written to the next delta again (and
+		// rechecked by Journal and InterestManager). Writes through pointers kept across ticks need a MarkChanged.
+		//
+		// Typical usage (autosave):
+		//   ecs.WriteDelta(nextSave, autosave);
+		//   nextSave = ecs.AdvanceTick();  // later changes go into the next delta
+		//   ecs.MoveHistory(cursor, nextSave);
+		Status WriteDelta(uint32_t sinceTick, std::ostream& stream) const
 		{
-			field = bitfield::Set(field, this->componentIndex[name]);
-		}
+			WriteValue(stream, DeltaMagic);
+			WriteValue(stream, SnapshotVersion);
+			WriteValue(stream, sinceTick);
+			WriteValue(stream, this->tick);
+
+			std::vector<uint32_t> destroyed;
+			for (const auto& entry : this->destroyedEntities)
+			{
+				if (entry.second >= sinceTick)
+				{
+					destroyed.push_back(entry.first);
+				}
+			}
 
-		// grab our smallest component list 
-		std::string smallestComponentList = std::get<0>(*std::min_element(begin(componentListSizes), end(componentListSizes), [](auto lhs, auto rhs) {return std::get<1>(lhs) < std::get<1>(rhs); }));
-		auto entitySearchVector = this->individualComponentVecs[smallestComponentList];
+			WriteValue(stream, static_cast<uint32_t>(destroyed.size()));
+			WriteArray(stream, destroyed.data(), destroyed.size());
+
+			std::vector<uint32_t> changed;
+			for (uint32_t entityId = 1; entityId < this->entities.size(); ++entityId)
+			{
+				if (this->entities[entityId].UUID != 0 && this->entityTicks[entityId] >= sinceTick)
+				{
+					changed.push_back(entityId);
+				}
+			}
 
-		// using the smallest list as our base, we'll check each entity against the
-		// search bitfield
-		std::vector<Entity> requestedEntities;
-		requestedEntities.reserve(entitySearchVector.size());
-		for (auto e : entitySearchVector) {
-			if (bitfield::Has(e.bitfield, field)) {
-				requestedEntities.emplace_back(e);
+			WriteValue(stream, static_cast<uint32_t>(changed.size()));
+			for (uint32_t entityId : changed)
+			{
+				WriteValue(stream, entityId);
+				WriteValue(stream, static_cast<uint8_t>(bitfield::Has(this->entities[entityId].bitfield, DisabledFlag) ? 1 : 0));
 			}
-		}
 
-		return requestedEntities;
+			WriteValue(stream, static_cast<uint32_t>(this->components.size()));
+			for (const auto& component : this->components)
+			{
+				const BaseContainer* container = component.second.get();
+				WriteString(stream, component.first);
+
+				std::vector<uint32_t> removed;
+				for (const auto& entry : container->removals)
+				{
+					if (entry.second >= sinceTick)
+					{
+						removed.push_back(entry.first);
+					}
+				}
+
+				WriteValue(stream, static_cast<uint32_t>(removed.size()));
+				WriteArray(stream, removed.data(), removed.size());
+
+				changed.clear();
+				for (size_t i = 0; i < container->Size(); ++i)
+				{
+					if (container->ChangeTickAt(i) >= sinceTick)
+					{
+						changed.push_back(container->Owners()[i]);
+					}
+				}
+
+				WriteValue(stream, static_cast<uint32_t>(changed.size()));
+				for (uint32_t entityId : changed)
+				{
+					WriteValue(stream, entityId);
+
+					Status status = container->WriteComponent(stream, entityId);
+					if (status != Status::Ok)
+					{
+						return status;
+					}
+				}
+			}
+
+			return stream ? Status::Ok : Status::StreamError;
+		}
+
+		// ApplyDelta applies a delta written by WriteDelta, creating entities at the UUIDs they have in the
+		// writing world. Applying deltas in order to the world they were written against (e.g. loaded from the
+		// snapshot taken at their first sinceTick) reproduces the writing world. EntityCreated events and
+		// query observers fire as the changes are applied, the component events don't, and the changes get
+		// stamped with this manager's tick so they can be passed on with WriteDelta.
+		//
+		// A stream that isn't a delta is rejected untouched; any other failure leaves the world partially
+		// updated, so reload the last snapshot.
+		Status ApplyDelta(std::istream& stream)
+		{
+			uint32_t magic = 0;
+			uint32_t version = 0;
+			uint32_t sinceTick = 0;
+			uint32_t deltaTick = 0;
+			ReadValue(stream, magic);
+			ReadValue(stream, version);
+			ReadValue(stream, sinceTick);
+			ReadValue(stream, deltaTick);
+
+			if (!stream)
+			{
+				return Status::StreamError;
+			}
+
+			if (magic != DeltaMagic || version != SnapshotVersion)
+			{
+				return Status::InvalidSnapshot;
+			}
+
+			this->FlushReservedEntities();
+
+			uint32_t destroyedCount = 0;
+			ReadValue(stream, destroyedCount);
+			for (uint32_t i = 0; stream && i < destroyedCount; ++i)
+			{
+				uint32_t entityId = 0;
+				ReadValue(stream, entityId);
+
+				if (stream && this->FindEntity(entityId) != nullptr)
+				{
+					this->RemoveEntity(Entity(entityId));
+				}
+			}
+
+			uint32_t previousSize = static_cast<uint32_t>(this->entities.size());
+			bool created = false;
+
+			uint32_t changedCount = 0;
+			ReadValue(stream, changedCount);
+			for (uint32_t i = 0; stream && i < changedCount; ++i)
+			{
+				uint32_t entityId = 0;
+				uint8_t disabled = 0;
+				ReadValue(stream, entityId);
+				ReadValue(stream, disabled);
+
+				if (!stream)
+				{
+					break;
+				}
+
+				if (entityId == 0)
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				if (this->FindEntity(entityId) == nullptr)
+				{
+					this->CreateEntityAt(entityId);
+					created = true;
+				}
+
+				if (disabled != 0)
+				{
+					this->Disable(Entity(entityId));
+				}
+				else
+				{
+					this->Enable(Entity(entityId));
+				}
+			}
+
+			if (created)
+			{
+				this->RebuildUnusedEntityIndices(previousSize);
+			}
+
+			uint32_t componentCount = 0;
+			ReadValue(stream, componentCount);
+			for (uint32_t i = 0; stream && i < componentCount; ++i)
+			{
+				std::string componentName;
+				ReadString(stream, componentName);
+				if (!stream)
+				{
+					break;
+				}
+
+				auto component = this->components.find(componentName);
+				if (component == this->components.end())
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				BaseContainer* container = component->second.get();
+
+				uint32_t removedCount = 0;
+				ReadValue(stream, removedCount);
+				for (uint32_t j = 0; stream && j < removedCount; ++j)
+				{
+					uint32_t entityId = 0;
+					ReadValue(stream, entityId);
+
+					Entity* stored = this->FindEntity(entityId);
+					if (stream && stored != nullptr && bitfield::Has(stored->bitfield, container->flag))
+					{
+						bitfield::Bitfield previousBitfield = stored->bitfield;
+						this->NotifyQueryObservers(*stored, previousBitfield, bitfield::Clear(previousBitfield, container->flag));
+
+						stored->bitfield = bitfield::Clear(previousBitfield, container->flag);
+						container->Remove(entityId);
+						this->RecordRemoval(container->removals, entityId);
+					}
+				}
+
+				ReadValue(stream, changedCount);
+				for (uint32_t j = 0; stream && j < changedCount; ++j)
+				{
+					uint32_t entityId = 0;
+					ReadValue(stream, entityId);
+
+					Entity* stored = this->FindEntity(entityId);
+					if (stream && stored == nullptr)
+					{
+						return Status::InvalidSnapshot;
+					}
+
+					Status status = container->ReadComponent(stream, entityId);
+					if (status != Status::Ok)
+					{
+						return status;
+					}
+
+					bitfield::Bitfield previousBitfield = stored->bitfield;
+					stored->bitfield = bitfield::Set(previousBitfield, container->flag);
+					this->NotifyQueryObservers(*stored, previousBitfield, stored->bitfield);
+				}
+			}
+
+			return stream ? Status::Ok : Status::StreamError;
+		}
+
+		// OpenHistory registers a consumer of the removal history, e.g. a delta writer. The entities and
+		// components removed are only remembered while at least one cursor is open, and only as far back as the
+		// oldest tick an open cursor still needs, so worlds nobody writes deltas of keep no history at all.
+		// The cursor needs the removals stamped at or after sinceTick; advance it with MoveHistory as the
+		// consumer catches up, and close it with CloseHistory. WriteDelta and ForEachChangedSince only report
+		// the removals of ticks an open cursor covered.
+		//
+		// While a cursor is open, the entities created, enabled or disabled and the components added or changed
+		// are logged too, from the next tick on, so ForEachChangedSince only visits what changed instead of
+		// scanning the world. The log keeps room for one change per component and tick.
+		//
+		// Typical usage (autosave):
+		//   babs_ecs::HistoryCursor cursor = ecs.OpenHistory(nextSave);
+		//   ecs.WriteDelta(nextSave, autosave);
+		//   nextSave = ecs.AdvanceTick();
+		//   ecs.MoveHistory(cursor, nextSave);    // older removals are dropped unless another cursor needs them
+		HistoryCursor OpenHistory(uint32_t sinceTick)
+		{
+			if (!this->HasHistoryCursors())
+			{
+				this->changeLogStart = this->tick + 1;
+				for (auto& component : this->components)
+				{
+					component.second->RecordChanges(true);
+				}
+			}
+
+			for (size_t i = 0; i < this->historyCursors.size(); ++i)
+			{
+				if (this->historyCursors[i] == ClosedCursor)
+				{
+					this->historyCursors[i] = sinceTick;
+					return HistoryCursor{ static_cast<uint32_t>(i + 1) };
+				}
+			}
+
+			this->historyCursors.push_back(sinceTick);
+			return HistoryCursor{ static_cast<uint32_t>(this->historyCursors.size()) };
+		}
+
+		// MoveHistory records that the cursor only needs the removals stamped at or after sinceTick from now on,
+		// and drops the ones no open cursor needs anymore.
+		void MoveHistory(HistoryCursor cursor, uint32_t sinceTick)
+		{
+			if (cursor.id == 0 || cursor.id > this->historyCursors.size() || this->historyCursors[cursor.id - 1] == ClosedCursor)
+			{
+				return;
+			}
+
+			this->historyCursors[cursor.id - 1] = sinceTick;
+			this->DiscardHistory(sinceTick);
+		}
+
+		// CloseHistory unregisters the cursor. Once the last one is closed, removals aren't remembered anymore.
+		void CloseHistory(HistoryCursor cursor)
+		{
+			if (cursor.id == 0 || cursor.id > this->historyCursors.size())
+			{
+				return;
+			}
+
+			this->historyCursors[cursor.id - 1] = ClosedCursor;
+			this->DiscardHistory(ClosedCursor);
+
+			if (!this->HasHistoryCursors())
+			{
+				for (auto& component : this->components)
+				{
+					component.second->RecordChanges(false);
+				}
+			}
+		}
+
+		// HistorySize returns how many entity and component removals are remembered for the history cursors.
+		size_t HistorySize() const
+		{
+			size_t size = this->destroyedEntities.size();
+			for (const auto& component : this->components)
+			{
+				size += component.second->removals.size();
+			}
+
+			return size;
+		}
+
+		// DiscardHistory forgets the entities and components removed or changed before this tick, except for the
+		// ones an open history cursor still needs. WriteDelta can't report the forgotten removals anymore.
+		void DiscardHistory(uint32_t beforeTick)
+		{
+			for (uint32_t cursorTick : this->historyCursors)
+			{
+				beforeTick = std::min(beforeTick, cursorTick);
+			}
+
+			auto older = [beforeTick](const std::pair<uint32_t, uint32_t>& entry) { return entry.second < beforeTick; };
+
+			this->destroyedEntities.erase(std::remove_if(this->destroyedEntities.begin(), this->destroyedEntities.end(), older), this->destroyedEntities.end());
+			this->changedEntities.erase(std::remove_if(this->changedEntities.begin(), this->changedEntities.end(), older), this->changedEntities.end());
+			this->changeLogStart = std::max(this->changeLogStart, beforeTick);
+
+			for (auto& component : this->components)
+			{
+				auto& removals = component.second->removals;
+				removals.erase(std::remove_if(removals.begin(), removals.end(), older), removals.end());
+				component.second->DiscardChanges(beforeTick);
+			}
+		}
+
+		// CaptureFrame saves the world into a ring of RollbackFrames frame buffers and returns the handle
+		// Restore takes, e.g. to roll back and resimulate frames when late inputs arrive. The buffers are
+		// reused, so once the ring went around, capturing copies the entity table and every component pool a
+		// page at a time without allocating. Entities reserved but not flushed yet aren't part of the frame.
+		//
+		// Typical usage:
+		//   history[frame % 8] = ecs.CaptureFrame();   // every frame, before simulating it
+		//   ecs.Restore(history[lateFrame % 8]);        // then simulate again from there
+		FrameHandle CaptureFrame()
+		{
+			if (this->frames == nullptr)
+			{
+				this->frames.reset(new Frame[RollbackFrames]);
+			}
+
+			Frame& frame = this->frames[this->frameSequence % RollbackFrames];
+			frame.sequence = ++this->frameSequence;
+			frame.entities.assign(this->entities.begin(), this->entities.end());
+			frame.unusedEntityIndices = this->unusedEntityIndices;
+
+			frame.containers.resize(this->containersByType.size());
+			for (size_t typeId = 0; typeId < this->containersByType.size(); ++typeId)
+			{
+				const BaseContainer* container = this->containersByType[typeId];
+				if (container == nullptr)
+				{
+					continue;
+				}
+
+				if (frame.containers[typeId] == nullptr)
+				{
+					frame.containers[typeId] = container->CreateEmpty();
+				}
+
+				container->CopyTo(*frame.containers[typeId]);
+			}
+
+			return FrameHandle{ frame.sequence };
+		}
+
+		// Restore puts the world back in the state it had when the frame was captured, or returns
+		// Status::FrameExpired if the frame was overwritten by later captures. Events and query observers
+		// don't fire, but everything restored is stamped with the current tick, so deltas and interest sets
+		// pick up the rollback. Component types registered after the capture end up empty.
+		//
+		// While entities are reserved but not flushed, Restore returns Status::ReservationsPending and changes
+		// nothing: rolling the entity table back would hand the reserved UUIDs out again.
+		Status Restore(FrameHandle handle)
+		{
+			if (handle.sequence == 0 || this->frames == nullptr)
+			{
+				return Status::FrameExpired;
+			}
+
+			if (this->entityIndex.load(std::memory_order_acquire) > this->entities.size() || this->reservedRecycled.load(std::memory_order_acquire) != 0)
+			{
+				return Status::ReservationsPending;
+			}
+
+			const Frame& frame = this->frames[(handle.sequence - 1) % RollbackFrames];
+			if (frame.sequence != handle.sequence)
+			{
+				return Status::FrameExpired;
+			}
+
+			this->Overwrite(frame.entities, frame.unusedEntityIndices, [&frame](size_t typeId) {
+				return typeId < frame.containers.size() ? frame.containers[typeId].get() : nullptr;
+			});
+
+			return Status::Ok;
+		}
+
+		// CopyFrom makes this world a copy of source, which must have registered the same component types in
+		// the same order (a fork of this world, or of the same prototype), or Status::ComponentNotRegistered is
+		// returned and nothing changes. It works like Restore with source as the frame: events and query
+		// observers don't fire, everything is stamped with the current tick, and the components are copied into
+		// the pages this world already has, so a world copied over and over keeps its storage.
+		//
+		// Typical usage: if (Done(*world)) { world->CopyFrom(prototype); }
+		Status CopyFrom(const ECSManager& source)
+		{
+			if (&source == this)
+			{
+				return Status::Ok;
+			}
+
+			if (this->entityIndex.load(std::memory_order_acquire) > this->entities.size() || this->reservedRecycled.load(std::memory_order_acquire) != 0)
+			{
+				return Status::ReservationsPending;
+			}
+
+			for (size_t typeId = 0; typeId < std::max(this->containersByType.size(), source.containersByType.size()); ++typeId)
+			{
+				const BaseContainer* container = typeId < this->containersByType.size() ? this->containersByType[typeId] : nullptr;
+				const BaseContainer* saved = typeId < source.containersByType.size() ? source.containersByType[typeId] : nullptr;
+				if ((container == nullptr) != (saved == nullptr) || (container != nullptr && container->flag != saved->flag))
+				{
+					return Status::ComponentNotRegistered;
+				}
+			}
+
+			this->Overwrite(source.entities, source.unusedEntityIndices, [&source](size_t typeId) -> const BaseContainer* {
+				return source.containersByType[typeId];
+			});
+
+			return Status::Ok;
+		}
+
+		// Fork returns a copy
+		// Fork returns a copy of the world (entities, components and change ticks) that shares the component
+		// pages with this one: a page is only copied when either world first writes to it, so forking costs
+		// little more than copying the entity table and the component indexes. Handlers, query observers,
+		// captured frames and the removal history aren't copied, since no history cursor is open on the fork
+		// yet. Each world can then be changed through its getters without affecting the other.
+		//
+		// Fork invalidates every pointer and reference to a component of this world obtained before it: the
+		// page they point into is shared with the fork until the first write through a getter copies it, so
+		// writing through them can change the fork. Fetch the components again after forking.
+		//
+		// Typical usage (planning): auto future = ecs.Fork(); Simulate(*future, plan); Score(*future);
+		std::unique_ptr<ECSManager> Fork()
+		{
+			auto fork = std::make_unique<ECSManager>();
+			this->ForkInto(*fork, [](BaseContainer& original) { return original.Fork(); });
+			return fork;
+		}
+
+		// ForkBatch returns count copies of the world, like Fork, for running many small worlds side by side
+		// (see WorldBatch). The copies don't share pages with this world; instead, the components of each type
+		// are copied into one allocation for all of them, where each copy gets a page sized to the pool rounded
+		// up to a power of two (at least 16). A copy that outgrows its page adds pages of the same size.
+		//
+		// Typical usage: auto worlds = prototype.ForkBatch(4096);
+		std::vector<std::unique_ptr<ECSManager>> ForkBatch(size_t count)
+		{
+			std::vector<std::unique_ptr<ECSManager>> forks(count);
+			std::map<const BaseContainer*, std::vector<std::unique_ptr<BaseContainer>>> containers;
+			for (const auto& component : this->components)
+			{
+				containers[component.second.get()] = component.second->ForkBatch(count);
+			}
+
+			for (size_t i = 0; i < count; ++i)
+			{
+				forks[i] = std::make_unique<ECSManager>();
+				this->ForkInto(*forks[i], [&containers, i](BaseContainer& original) { return std::move(containers[&original][i]); });
+			}
+
+			return forks;
+		}
+
+		// Unshare copies every component page still shared with a fork, after which the thread safety of the
+		// non-const getters is back to normal.
+		void Unshare()
+		{
+			for (auto& component : this->components)
+			{
+				component.second->Unshare();
+			}
+		}
+
+		// StateHash returns a hash of the entities, whether they're enabled, and every registered component, for
+		// lockstep peers to compare every frame. It doesn't depend on the order in which the entities or their
+		// components are stored, and it's computed by walking the component pools directly, at memory speed.
+		// Trivially copyable components are hashed as raw bytes, so their padding must be set the same way on
+		// every peer (or avoided); other components are hashed through their Serializer, and components
+		// without one only count by owner.
+		//
+		// Typical usage: if (ecs.StateHash() != hashFromServer) { ResyncWithServer(); }
+		uint64_t StateHash() const
+		{
+			uint64_t hash = 0;
+
+			for (uint32_t entityId = 1; entityId < this->entities.size(); ++entityId)
+			{
+				const Entity& e = this->entities[entityId];
+				if (e.UUID != 0)
+				{
+					uint8_t disabled = bitfield::Has(e.bitfield, DisabledFlag) ? 1 : 0;
+					hash += HashBytes(&disabled, sizeof(disabled), e.UUID);
+				}
+			}
+
+			for (const auto& component : this->components)
+			{
+				uint64_t componentHash = component.second->Hash();
+				hash += HashBytes(&componentHash, sizeof(componentHash), HashBytes(component.first.data(), component.first.size(), 0));
+			}
+
+			return hash;
+		}
+
+	private:
+		// "BECS" or "BECM" for mapped snapshots, "BECD" for deltas, followed by the format version
+		static constexpr uint32_t SnapshotMagic = 0x53434542;
+		static constexpr uint32_t MappedSnapshotMagic = 0x4D434542;
+		static constexpr uint32_t DeltaMagic = 0x44434542;
+		static constexpr uint32_t SnapshotVersion = 1;
+
+		// Creates the entity with this UUID, which must not exist, growing the table as needed.
+		void CreateEntityAt(uint32_t entityId)
+		{
+			if (entityId >= this->entities.size())
+			{
+				this->entities.resize(static_cast<size_t>(entityId) + 1);
+				this->entityIndex = entityId + 1;
+			}
+
+			this->entities[entityId] = Entity(entityId);
+			this->StampEntity(entityId);
+
+			EntityCreated entityCreated(this->entities[entityId]);
+			this->events.Broadcast(entityCreated);
+		}
+
+		// Drops the UUIDs CreateEntityAt took from the recycle queue and queues the free slots the table grew by
+		// since it had previousSize slots. Slots that were already free keep their order.
+		void RebuildUnusedEntityIndices(uint32_t previousSize)
+		{
+			std::deque<uint32_t> unused;
+			for (uint32_t entityId : this->unusedEntityIndices)
+			{
+				if (this->entities[entityId].UUID == 0)
+				{
+					unused.push_back(entityId);
+				}
+			}
+
+			for (uint32_t entityId = previousSize; entityId < this->entities.size(); ++entityId)
+			{
+				if (this->entities[entityId].UUID == 0)
+				{
+					unused.push_back(entityId);
+				}
+			}
+
+			this->unusedEntityIndices.swap(unused);
+		}
+
+		// Resets the world to a fresh manager with the same registered components. The tick is kept, but
+		// the change history is gone.
+		void Clear()
+		{
+			this->entities.assign(1, Entity());
+			this->entityTicks.assign(1, this->tick);
+			this->entityIndex = 1;
+			this->unusedEntityIndices.clear();
+			this->reservedRecycled = 0;
+			this->destroyedEntities.clear();
+			this->changedEntities.clear();
+			this->ForgetChangeLog();
+
+			for (auto& component : this->components)
+			{
+				component.second->Clear();
+				component.second->DiscardChanges(ClosedCursor);
+			}
+		}
+
+		// Reads everything after the snapshot header. See LoadSnapshot.
+		Status ReadSnapshot(std::istream& stream)
+		{
+			this->Clear();
+
+			uint32_t entityCount = 0;
+			ReadValue(stream, entityCount);
+
+			// the table is read in chunks so a corrupt count can't allocate much more than the stream holds
+			std::vector<uint32_t> chunk(4096);
+			this->entities.clear();
+			for (uint32_t first = 0; stream && first < entityCount; first += static_cast<uint32_t>(chunk.size()))
+			{
+				uint32_t count = std::min(static_cast<uint32_t>(chunk.size()), entityCount - first);
+				ReadArray(stream, chunk.data(), count);
+
+				for (uint32_t i = 0; stream && i < count; ++i)
+				{
+					uint32_t entityId = first + i;
+					if (chunk[i] != 0 && (chunk[i] != entityId || entityId == 0))
+					{
+						return Status::InvalidSnapshot;
+					}
+
+					this->entities.emplace_back(chunk[i]);
+				}
+			}
+
+			if (!stream)
+			{
+				return Status::StreamError;
+			}
+
+			if (entityCount == 0)
+			{
+				return Status::InvalidSnapshot;
+			}
+
+			this->entityIndex = entityCount;
+			this->entityTicks.assign(entityCount, this->tick);
+
+			uint32_t disabledCount = 0;
+			ReadValue(stream, disabledCount);
+			for (uint32_t i = 0; stream && i < disabledCount; ++i)
+			{
+				uint32_t entityId = 0;
+				ReadValue(stream, entityId);
+
+				Entity* stored = this->FindEntity(entityId);
+				if (stream && stored == nullptr)
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				if (stored != nullptr)
+				{
+					stored->bitfield = bitfield::Set(stored->bitfield, DisabledFlag);
+				}
+			}
+
+			uint32_t unusedCount = 0;
+			ReadValue(stream, unusedCount);
+			for (uint32_t i = 0; stream && i < unusedCount; ++i)
+			{
+				uint32_t entityId = 0;
+				ReadValue(stream, entityId);
+
+				if (stream && (entityId == 0 || entityId >= entityCount || this->entities[entityId].UUID != 0))
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				this->unusedEntityIndices.push_back(entityId);
+			}
+
+			uint32_t componentCount = 0;
+			ReadValue(stream, componentCount);
+			for (uint32_t i = 0; stream && i < componentCount; ++i)
+			{
+				std::string componentName;
+				ReadString(stream, componentName);
+				if (!stream)
+				{
+					break;
+				}
+
+				auto component = this->components.find(componentName);
+				if (component == this->components.end())
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				BaseContainer* container = component->second.get();
+				Status status = container->Load(stream, entityCount);
+				if (status == Status::Ok)
+				{
+					status = this->AttachOwners(container);
+				}
+
+				if (status != Status::Ok)
+				{
+					return status;
+				}
+			}
+
+			return stream ? Status::Ok : Status::StreamError;
+		}
+
+		// Sets the container's flag in the bitfields of its owners, which must be live entities. Snapshots
+		// don't store component flags since they depend on the registration order.
+		Status AttachOwners(const BaseContainer* container)
+		{
+			for (uint32_t entityId : container->Owners())
+			{
+				Entity* stored = this->FindEntity(entityId);
+				if (stored == nullptr || bitfield::Has(stored->bitfield, container->flag))
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				stored->bitfield = bitfield::Set(stored->bitfield, container->flag);
+			}
+
+			return Status::Ok;
+		}
+
+		// Reads everything after the mapped snapshot's magic and version. See MapSnapshot.
+		Status ReadMappedSnapshot(const std::shared_ptr<MappedFile>& file)
+		{
+			this->Clear();
+
+			MemoryStreamBuffer buffer(file->Data(), file->Size());
+			std::istream header(&buffer);
+
+			uint32_t magic = 0;
+			uint32_t version = 0;
+			uint32_t entityCount = 0;
+			uint32_t unusedCount = 0;
+			uint32_t componentCount = 0;
+			uint64_t entitiesOffset = 0;
+			ReadValue(header, magic);
+			ReadValue(header, version);
+			ReadValue(header, entityCount);
+			ReadValue(header, unusedCount);
+			ReadValue(header, componentCount);
+			ReadValue(header, entitiesOffset);
+
+			if (!header || entityCount == 0 || entitiesOffset > file->Size() || (file->Size() - entitiesOffset) / sizeof(Entity) < entityCount)
+			{
+				return Status::InvalidSnapshot;
+			}
+
+			// the table is copied as a block, then bitfields are reduced to the disabled flag and rebuilt
+			this->entities.resize(entityCount);
+			std::memcpy(this->entities.data(), file->Data() + entitiesOffset, entityCount * sizeof(Entity));
+			this->entityIndex = entityCount;
+			this->entityTicks.assign(entityCount, this->tick);
+
+			for (uint32_t entityId = 0; entityId < entityCount; ++entityId)
+			{
+				Entity& e = this->entities[entityId];
+				if (e.UUID != 0 && (e.UUID != entityId || entityId == 0))
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				e.bitfield = e.UUID != 0 ? e.bitfield & DisabledFlag : 0;
+			}
+
+			for (uint32_t i = 0; header && i < unusedCount; ++i)
+			{
+				uint32_t entityId = 0;
+				ReadValue(header, entityId);
+
+				if (header && (entityId == 0 || entityId >= entityCount || this->entities[entityId].UUID != 0))
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				this->unusedEntityIndices.push_back(entityId);
+			}
+
+			for (uint32_t i = 0; header && i < componentCount; ++i)
+			{
+				std::string componentName;
+				uint64_t componentSize = 0;
+				uint64_t offset = 0;
+				uint64_t size = 0;
+				uint32_t raw = 0;
+				ReadString(header, componentName);
+				ReadValue(header, raw);
+				ReadValue(header, componentSize);
+				ReadValue(header, offset);
+				ReadValue(header, size);
+
+				if (!header)
+				{
+					break;
+				}
+
+				auto component = this->components.find(componentName);
+				if (component == this->components.end() || offset > file->Size() || size > file->Size() - offset)
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				BaseContainer* container = component->second.get();
+				if ((raw != 0) != container->IsRaw() || (raw != 0 && componentSize != container->ComponentSize()))
+				{
+					return Status::InvalidSnapshot;
+				}
+
+				Status status = Status::Ok;
+				if (raw != 0)
+				{
+					status = container->Map(file, static_cast<size_t>(offset), static_cast<size_t>(size), entityCount);
+				}
+				else
+				{
+					MemoryStreamBuffer sectionBuffer(file->Data() + offset, static_cast<size_t>(size));
+					std::istream section(&sectionBuffer);
+					status = container->Load(section, entityCount);
+				}
+
+				if (status == Status::Ok)
+				{
+					status = this->AttachOwners(container);
+				}
+
+				if (status != Status::Ok)
+				{
+					return status;
+				}
+			}
+
+			return header ? Status::Ok : Status::InvalidSnapshot;
+		}
+
+		// UUIDs of removed entities, reused oldest first. The first reservedRecycled of them were handed out by
+		// ReserveEntity and are taken off the queue by the next flush.
+		std::deque<uint32_t> unusedEntityIndices;
+		std::atomic<uint32_t> reservedRecycled{ 0 };
+		// next never used UUID; every UUID below it is in the table, recycled, or reserved and awaiting a flush
+		std::atomic<uint32_t> entityIndex;
+		bitfield::Bitfield bitIndex;
+
+		// Dense entity table indexed by UUID. Free slots hold the dummy entity (UUID 0).
+		std::vector<Entity> entities;
+
+		// See AdvanceTick. entityTicks[UUID] is the tick at which the entity was created, enabled or disabled.
+		uint32_t tick;
+		std::vector<uint32_t> entityTicks;
+
+		// UUID and tick of every removed entity, oldest first
+		std::vector<std::pair<uint32_t, uint32_t>> destroyedEntities;
+
+		// UUID and tick of every entity created, enabled or disabled while a history cursor is open, oldest
+		// first. The change logs are complete from changeLogStart on, see OpenHistory and ForgetChangeLog.
+		std::vector<std::pair<uint32_t, uint32_t>> changedEntities;
+		uint32_t changeLogStart = std::numeric_limits<uint32_t>::max();
+
+		// historyCursors[id - 1] is the oldest tick the cursor still needs, ClosedCursor for closed ones
+		static constexpr uint32_t ClosedCursor = std::numeric_limits<uint32_t>::max();
+		std::vector<uint32_t> historyCursors;
+
+		// The containers of the registered component types, by component name.
+		std::map<std::string, std::unique_ptr<BaseContainer>> components;
+
+		// The same containers indexed by ComponentTypeId, nullptr for types not registered with this manager.
+		std::vector<BaseContainer*> containersByType;
+
+		// containers of the registered DoubleBuffered<T> component types
+		std::vector<BaseContainer*> doubleBufferedContainers;
+
+		// Frame is a buffer of the ring CaptureFrame saves into. containers is indexed like containersByType.
+		struct Frame
+		{
+			uint32_t sequence = 0;
+			std::vector<Entity> entities;
+			std::deque<uint32_t> unusedEntityIndices;
+			std::vector<std::unique_ptr<BaseContainer>> containers;
+		};
+
+		std::unique_ptr<Frame[]> frames;
+		uint32_t frameSequence = 0;
+
+		// QueryObserver pairs the component mask of a query with the handler to call on a transition.
+		struct QueryObserver
+		{
+			bitfield::Bitfield mask;
+			QueryHandler handler;
+		};
+
+		// deques, so a handler registering another observer doesn't move the one that's running
+		std::deque<QueryObserver> enterObservers;
+		std::deque<QueryObserver> exitObservers;
+
+		template <typename T>
+		static std::string GetComponentName();
+
+		template <typename T, typename... Ts>
+		bitfield::Bitfield GetComponentMask() const;
+
+		template <typename T>
+		ComponentContainer<T>* GetContainer() const;
+
+		template <typename T>
+		ComponentContainer<T>* FindContainer() const;
+
+		template <typename T>
+		static const T* ComponentOf(const ComponentContainer<T>* container, const Entity* stored);
+
+		// Copies the page holding the entity's T if it's shared with a fork, before the non-const getters hand
+		// out a pointer to it.
+		template <typename T>
+		void UnshareComponent(Entity entity)
+		{
+			if (ComponentContainer<T>* container = this->FindContainer<T>())
+			{
+				container->UnshareComponent(entity.UUID);
+			}
+		}
+
+		template <typename T>
+		void UnshareComponents(const Entity* entities, size_t count)
+		{
+			ComponentContainer<T>* container = this->FindContainer<T>();
+			for (size_t i = 0; container != nullptr && container->HasSharedPages() && i < count; ++i)
+			{
+				container->UnshareComponent(entities[i].UUID);
+			}
+		}
+
+		// Remembers the removal of the entity, or of a component of it, for the open history cursors.
+		void RecordRemoval(std::vector<std::pair<uint32_t, uint32_t>>& history, uint32_t entityId)
+		{
+			if (this->HasHistoryCursors())
+			{
+				history.emplace_back(entityId, this->tick);
+			}
+		}
+
+		bool HasHistoryCursors() const
+		{
+			return std::any_of(this->historyCursors.begin(), this->historyCursors.end(), [](uint32_t cursorTick) { return cursorTick != ClosedCursor; });
+		}
+
+		// Called after changing the whole world at once, which isn't logged: ForEachChangedSince scans the
+		// world again for the ticks up to this one.
+		void ForgetChangeLog()
+		{
+			if (this->HasHistoryCursors())
+			{
+				this->changeLogStart = std::max(this->changeLogStart, this->tick + 1);
+			}
+		}
+
+		// Copies everything but the component pools into fork, and gives it forkContainer(container) for each
+		// of this world's containers. See Fork and ForkBatch.
+		template <typename ForkContainer>
+		void ForkInto(ECSManager& fork, ForkContainer&& forkContainer)
+		{
+			fork.bitIndex = this->bitIndex;
+			fork.entityIndex = static_cast<uint32_t>(this->entities.size());
+			fork.entities = this->entities;
+			fork.unusedEntityIndices = this->unusedEntityIndices;
+			fork.tick = this->tick;
+			fork.entityTicks = this->entityTicks;
+
+			fork.containersByType.resize(this->containersByType.size(), nullptr);
+			for (auto& component : this->components)
+			{
+				BaseContainer* original = component.second.get();
+				std::unique_ptr<BaseContainer> container = forkContainer(*original);
+
+				for (size_t typeId = 0; typeId < this->containersByType.size(); ++typeId)
+				{
+					if (this->containersByType[typeId] == original)
+					{
+						fork.containersByType[typeId] = container.get();
+					}
+				}
+
+				if (std::find(this->doubleBufferedContainers.begin(), this->doubleBufferedContainers.end(), original) != this->doubleBufferedContainers.end())
+				{
+					fork.doubleBufferedContainers.push_back(container.get());
+				}
+
+				fork.components[component.first] = std::move(container);
+			}
+		}
+
+		// Replaces the entity table and every component pool with the ones given, savedOf(typeId) being the
+		// container to copy for each registered type (nullptr empties the pool). See Restore and CopyFrom.
+		template <typename SavedOf>
+		void Overwrite(const std::vector<Entity>& savedEntities, const std::deque<uint32_t>& savedUnused, SavedOf&& savedOf)
+		{
+			// entities that aren't saved count as removed now
+			for (uint32_t entityId = 1; entityId < this->entities.size(); ++entityId)
+			{
+				uint32_t uuid = this->entities[entityId].UUID;
+				if (uuid != 0 && (entityId >= savedEntities.size() || savedEntities[entityId].UUID != uuid))
+				{
+					this->RecordRemoval(this->destroyedEntities, uuid);
+				}
+			}
+
+			this->entities.assign(savedEntities.begin(), savedEntities.end());
+			this->entityIndex = static_cast<uint32_t>(this->entities.size());
+			this->unusedEntityIndices = savedUnused;
+			this->entityTicks.assign(this->entities.size(), this->tick);
+			this->ForgetChangeLog();
+
+			for (size_t typeId = 0; typeId < this->containersByType.size(); ++typeId)
+			{
+				BaseContainer* container = this->containersByType[typeId];
+				if (container == nullptr)
+				{
+					continue;
+				}
+
+				const BaseContainer* saved = savedOf(typeId);
+
+				// so do the components of surviving entities
+				for (uint32_t entityId : container->Owners())
+				{
+					if ((saved == nullptr || !saved->Contains(entityId)) && this->FindEntity(entityId) != nullptr)
+					{
+						this->RecordRemoval(container->removals, entityId);
+					}
+				}
+
+				if (saved != nullptr)
+				{
+					saved->CopyTo(*container);
+				}
+				else
+				{
+					auto removals = std::move(container->removals);
+					container->Clear();
+					container->removals = std::move(removals);
+				}
+			}
+		}
+
+		// Records that the entity was created or changed state at the current tick.
+		void StampEntity(uint32_t entityId)
+		{
+			if (entityId >= this->entityTicks.size())
+			{
+				this->entityTicks.resize(this->entities.size(), 0);
+			}
+
+			this->entityTicks[entityId] = this->tick;
+			if (this->HasHistoryCursors())
+			{
+				this->changedEntities.emplace_back(entityId, this->tick);
+			}
+		}
+
+		// Starts loading the entity table slot of this UUID into the cache.
+		void PrefetchEntity(uint32_t entityId) const
+		{
+			if (entityId < this->entities.size())
+			{
+				BABS_ECS_PREFETCH(&this->entities[entityId]);
+			}
+		}
+
+		template <typename T>
+		void StoreComponent(Entity entity, const T& component);
+
+		template <typename T>
+		void ReleaseComponent(Entity entity, bitfield::Bitfield previousBitfield);
+
+		// Returns the stored entity for this UUID, or nullptr if it doesn't exist.
+		const Entity* FindEntity(uint32_t entityId) const
+		{
+			if (entityId == 0 || entityId >= this->entities.size() || this->entities[entityId].UUID != entityId)
+			{
+				return nullptr;
+			}
+
+			return &this->entities[entityId];
+		}
+
+		Entity* FindEntity(uint32_t entityId)
+		{
+			return const_cast<Entity*>(std::as_const(*this).FindEntity(entityId));
+		}
+
+		// A query matches enabled entities that have every flag of its mask.
+		static bool Matches(bitfield::Bitfield field, bitfield::Bitfield mask)
+		{
+			return bitfield::Has(field, mask) && !bitfield::Has(field, DisabledFlag);
+		}
+
+		// Fires the enter/exit handlers of every query whose match state differs between the two masks.
+		// Observers registered by the handlers themselves only fire from the next change on.
+		void NotifyQueryObservers(Entity entity, bitfield::Bitfield before, bitfield::Bitfield after)
+		{
+			size_t exitCount = this->exitObservers.size();
+			size_t enterCount = this->enterObservers.size();
+
+			for (size_t i = 0; i < exitCount; ++i)
+			{
+				QueryObserver& observer = this->exitObservers[i];
+				if (Matches(before, observer.mask) && !Matches(after, observer.mask))
+				{
+					observer.handler(entity);
+				}
+			}
+
+			for (size_t i = 0; i < enterCount; ++i)
+			{
+				QueryObserver& observer = this->enterObservers[i];
+				if (!Matches(before, observer.mask) && Matches(after, observer.mask))
+				{
+					observer.handler(entity);
+				}
+			}
+		}
+	};
+
+	// RegisterComponent will let ECS know of a new component type it needs to keep track of.
+	//
+	// Until this is called, components cannot be added/retrieved.
+	template<typename T>
+	inline void ECSManager::RegisterComponent()
+	{
+		[[maybe_unused]] Status status = this->TryRegisterComponent<T>();
+		BABS_ECS_CHECK(status != Status::ComponentLimitReached, std::out_of_range("Exceeded available flags for the bitfield! (max 31 b/c uint32 with a reserved disabled bit)"));
+	}
+
+	// TryRegisterComponent is RegisterComponent reporting a full bitfield as Status::ComponentLimitReached instead of throwing.
+	template<typename T>
+	inline Status ECSManager::TryRegisterComponent()
+	{
+		// Example: "class TestComponent", "struct Health", "struct Identity"
+		// using typeid(T).name() means we don't need to rely on ToString();
+		std::string componentName = this->GetComponentName<T>();
+
+		if (components.find(componentName) == components.end())
+		{
+			// the highest bit is reserved for DisabledFlag
+			if (bitIndex == DisabledFlag)
+			{
+				return Status::ComponentLimitReached;
+			}
+
+			BaseContainer* container = new ComponentContainer<T>();
+			container->flag = bitIndex;
+			container->name = componentName;
+			container->tick = this->tick;
+			container->RecordChanges(this->HasHistoryCursors());
+
+			components[componentName].reset(container);
+
+			uint32_t typeId = ComponentTypeId<T>();
+			if (typeId >= containersByType.size())
+			{
+				containersByType.resize(typeId + 1, nullptr);
+			}
+			containersByType[typeId] = container;
+
+			if constexpr (IsDoubleBuffered<T>::value)
+			{
+				doubleBufferedContainers.push_back(container);
+			}
+
+			// set the next bit index
+			bitIndex *= 2;
+		}
+
+		return Status::Ok;
+	}
+
+	// MarkChanged stamps the entity's component as changed at the current tick, for writes WriteDelta can't
+	// see otherwise (through pointers kept from an earlier tick). Does nothing if the entity doesn't have it.
+	//
+	// Typical usage: cachedPosition->x += 1; ecs.MarkChanged<Position>(entity);
+	template<typename T>
+	inline void ECSManager::MarkChanged(Entity entity)
+	{
+		this->GetContainer<T>()->MarkChanged(entity.UUID);
+	}
+
+	// SwapBuffers<DoubleBuffered<T>> publishes the written values of a single DoubleBuffered component type.
+	template<typename T>
+	inline void ECSManager::SwapBuffers()
+	{
+		static_assert(IsDoubleBuffered<T>::value, "SwapBuffers<T> needs a DoubleBuffered<T> component type");
+		this->GetContainer<T>()->SwapBuffers();
+	}
+
+	// AddComponent will add the component to the entity. It can be retrieved later with ecs.GetComponent(...)
+	template<typename T>
+	inline void ECSManager::AddComponent(Entity entity, T component)
+	{
+		this->AddComponents<T>(entity, std::move(component));
+	}
+
+	// AddComponents adds several components to the entity in one structural update. The entity's bitfield
+	// is computed once and query observers see a single transition, while a ComponentAdded event still
+	// fires for each component.
+	//
+	// Typical usage: ecs.AddComponents(entity, Position{}, Velocity{}, Health{ 100, 100 });
+	template<typename ...Ts>
+	inline void ECSManager::AddComponents(Entity entity, Ts... components)
+	{
+		static_assert(sizeof...(Ts) > 0, "AddComponents needs at least one component");
+
+		// throws if any of the component types isn't registered
+		bitfield::Bitfield mask = this->GetComponentMask<Ts...>();
+
+		Entity* stored = this->FindEntity(entity.UUID);
+
+		BABS_ECS_CHECK(stored != nullptr, std::runtime_error("Failed to find entity to add component to"));
+
+		bitfield::Bitfield previousBitfield = stored->bitfield;
+		stored->bitfield = bitfield::Set(previousBitfield, mask);
+		Entity e = *stored;
+
+		(this->StoreComponent(e, components), ...);
+
+		// fire the component added events
+		(this->events.Broadcast(babs_ecs::ComponentAdded<Ts>(entity, components)), ...);
+
+		this->NotifyQueryObservers(e, previousBitfield, e.bitfield);
+	}
+
+	// RemoveComponent will remove the component from the entity. Removing a component the entity doesn't have does nothing.
+	template<typename T>
+	inline void ECSManager::RemoveComponent(Entity entity)
+	{
+		this->RemoveComponents<T>(entity);
+	}
+
+	// RemoveComponents removes several components from the entity in one structural update. Components
+	// the entity doesn't have are skipped. Query observers see a single transition, while a
+	// ComponentRemoved event still fires for each removed component.
+	//
+	// Typical usage: ecs.RemoveComponents<Velocity, Stunned>(entity);
+	template<typename ...Ts>
+	inline void ECSManager::RemoveComponents(Entity entity)
+	{
+		static_assert(sizeof...(Ts) > 0, "RemoveComponents needs at least one component type");
+
+		// throws if any of the component types isn't registered
+		bitfield::Bitfield mask = this->GetComponentMask<Ts...>();
+
+		Entity* stored = this->FindEntity(entity.UUID);
+
+		BABS_ECS_CHECK(stored != nullptr, std::runtime_error("Failed to find entity to remove component from"));
+
+		bitfield::Bitfield previousBitfield = stored->bitfield;
+		bitfield::Bitfield removedFlags = previousBitfield & mask;
+
+		if (removedFlags == 0)
+		{
+			// Nothing to remove
+			return;
+		}
+
+		// queries the entity is about to leave are notified while the components are still readable
+		this->NotifyQueryObservers(*stored, previousBitfield, bitfield::Clear(previousBitfield, removedFlags));
+
+		// first we clear its bitfield
+		stored->bitfield = bitfield::Clear(previousBitfield, removedFlags);
+
+		(this->ReleaseComponent<Ts>(entity, previousBitfield), ...);
+	}
+
+	// Stores the component data for the entity. Replacing an existing component only updates its data.
+	template<typename T>
+	inline void ECSManager::StoreComponent(Entity entity, const T& component)
+	{
+		// get the container for this component and add the component data to this entity
+		this->GetContainer<T>()->Insert(entity.UUID, component);
+	}
+
+	// Removes the component data and fires the component removed event, if the entity had the
+	// component before its bitfield was cleared.
+	template<typename T>
+	inline void ECSManager::ReleaseComponent(Entity entity, bitfield::Bitfield previousBitfield)
+	{
+		ComponentContainer<T>* container = this->GetContainer<T>();
+
+		if (!bitfield::Has(previousBitfield, container->flag))
+		{
+			return;
+		}
+
+		T componentData = container->Get(entity.UUID);
+		container->Remove(entity.UUID);
+		this->RecordRemoval(container->removals, entity.UUID);
+
+		// fire the component removed event
+		babs_ecs::ComponentRemoved componentRemoved(entity, componentData);
+		this->events.Broadcast(componentRemoved);
+	}
+
+	// GetComponent will return a pointer to the entities component data. Modifications to the component will persist.
+	//
+	// Like every non-const getter, it stamps the component as changed at the current tick (see WriteDelta).
+	template<typename T>
+	inline T* ECSManager::GetComponent(Entity entity)
+	{
+		return std::get<0>(this->GetComponents<T>(entity));
+	}
+
+	// This overload can be called concurrently from any number of threads, see ECSManager's thread safety notes.
+	template<typename T>
+	inline const T* ECSManager::GetComponent(Entity entity) const
+	{
+		return std::get<0>(this->GetComponents<T>(entity));
+	}
+
+	template<typename ...Ts>
+	inline std::tuple<Ts*...> ECSManager::GetComponents(Entity entity)
+	{
+		// the const overloads never modify the manager, so the non-const ones can safely hand out mutable data
+		(this->UnshareComponent<Ts>(entity), ...);
+		return std::apply([&](const Ts*... components) {
+			((components != nullptr ? this->FindContainer<Ts>()->MarkChanged(entity.UUID) : void()), ...);
+			return std::tuple<Ts*...>(const_cast<Ts*>(components)...);
+		}, std::as_const(*this).template GetComponents<Ts...>(entity));
+	}
+
+	// GetComponents returns pointers to several of the entity's components at once, looking the entity
+	// up only once. Components the entity doesn't have, or all of them if the entity doesn't exist, are nullptr.
+	//
+	// Typical usage: auto [position, health] = ecs.GetComponents<Position, Health>(entity);
+	template<typename ...Ts>
+	inline std::tuple<const Ts*...> ECSManager::GetComponents(Entity entity) const
+	{
+		static_assert(sizeof...(Ts) > 0, "GetComponents needs at least one component type");
+
+		// resolving the containers first means unregistered components throw even for missing entities
+		std::tuple<const ComponentContainer<Ts>*...> containers(this->GetContainer<Ts>()...);
+
+		const Entity* stored = this->FindEntity(entity.UUID);
+
+		if (stored == nullptr)
+		{
+			return std::tuple<const Ts*...>();
+		}
+
+		return std::apply([&](auto*... container) {
+			return std::tuple<const Ts*...>(ComponentOf(container, stored)...);
+		}, containers);
+	}
+
+	template<typename T>
+	inline void ECSManager::Gather(const Entity* entities, size_t count, T** out)
+	{
+		this->UnshareComponents<T>(entities, count);
+		std::as_const(*this).Gather(entities, count, const_cast<const T**>(out));
+
+		ComponentContainer<T>* container = this->FindContainer<T>();
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (out[i] != nullptr)
+			{
+				container->MarkChanged(entities[i].UUID);
+			}
+		}
+	}
+
+	// Gather resolves the component of many entities in one pass, writing a pointer per entity into out
+	// (nullptr for entities that don't have the component or don't exist). Entity and component data
+	// are prefetched ahead of use, so this is much faster than calling GetComponent in a loop for
+	// lists of entities that came from outside ECS (e.g. network ids or targeting results).
+	//
+	// Typical usage: std::vector<Health*> healths(targets.size()); ecs.Gather(targets, healths.data());
+	template<typename T>
+	inline void ECSManager::Gather(const Entity* entities, size_t count, const T** out) const
+	{
+		const ComponentContainer<T>* container = this->GetContainer<T>();
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (i + BABS_ECS_PREFETCH_DISTANCE < count)
+			{
+				this->PrefetchEntity(entities[i + BABS_ECS_PREFETCH_DISTANCE].UUID);
+			}
+
+			out[i] = ComponentOf(container, this->FindEntity(entities[i].UUID));
+			if (out[i] != nullptr)
+			{
+				BABS_ECS_PREFETCH(out[i]);
+			}
+		}
+	}
+
+	template<typename T>
+	inline void ECSManager::Gather(const std::vector<Entity>& entities, T** out)
+	{
+		this->Gather(entities.data(), entities.size(), out);
+	}
+
+	template<typename T>
+	inline void ECSManager::Gather(const std::vector<Entity>& entities, const T** out) const
+	{
+		this->Gather(entities.data(), entities.size(), out);
+	}
+
+	// ForEachGathered calls func(entity, component) for every entity of the list that has the component,
+	// in list order. Components are resolved and prefetched a few entities ahead of the call that uses them.
+	// The callback must not add or remove components of this type. Like with ForEach, only callbacks taking
+	// T& stamp the components they're passed as changed.
+	//
+	// Typical usage: ecs.ForEachGathered<Health>(targets, [](babs_ecs::Entity e, Health& health) { ... });
+	template<typename T, typename Func>
+	inline void ECSManager::ForEachGathered(const Entity* entities, size_t count, Func&& func)
+	{
+		if constexpr (std::is_invocable_v<Func&, Entity, const T&>)
+		{
+			std::as_const(*this).template ForEachGathered<T>(entities, count, std::forward<Func>(func));
+		}
+		else
+		{
+			this->UnshareComponents<T>(entities, count);
+
+			ComponentContainer<T>* container = this->FindContainer<T>();
+			std::as_const(*this).template ForEachGathered<T>(entities, count, [&](Entity entity, const T& component) {
+				container->MarkChanged(entity.UUID);
+				func(entity, const_cast<T&>(component));
+			});
+		}
+	}
+
+	template<typename T, typename Func>
+	inline void ECSManager::ForEachGathered(const Entity* entities, size_t count, Func&& func) const
+	{
+		constexpr size_t distance = BABS_ECS_PREFETCH_DISTANCE;
+		const ComponentContainer<T>* container = this->GetContainer<T>();
+
+		// ring of components already resolved and on their way into the cache
+		std::array<const T*, distance> ahead;
+		for (size_t i = 0; i < distance && i < count; ++i)
+		{
+			ahead[i] = ComponentOf(container, this->FindEntity(entities[i].UUID));
+			if (ahead[i] != nullptr)
+			{
+				BABS_ECS_PREFETCH(ahead[i]);
+			}
+		}
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			const T* component = ahead[i % distance];
+
+			if (i + distance < count)
+			{
+				ahead[i % distance] = ComponentOf(container, this->FindEntity(entities[i + distance].UUID));
+				if (ahead[i % distance] != nullptr)
+				{
+					BABS_ECS_PREFETCH(ahead[i % distance]);
+				}
+			}
+
+			if (component != nullptr)
+			{
+				func(entities[i], *component);
+			}
+		}
+	}
+
+	template<typename T, typename Func>
+	inline void ECSManager::ForEachGathered(const std::vector<Entity>& entities, Func&& func)
+	{
+		this->ForEachGathered<T>(entities.data(), entities.size(), std::forward<Func>(func));
+	}
+
+	template<typename T, typename Func>
+	inline void ECSManager::ForEachGathered(const std::vector<Entity>& entities, Func&& func) const
+	{
+		this->ForEachGathered<T>(entities.data(), entities.size(), std::forward<Func>(func));
+	}
+
+	// Returns the stored entity's data in the container, or nullptr if there's no such entity or it lacks the component.
+	template<typename T>
+	inline const T* ECSManager::ComponentOf(const ComponentContainer<T>* container, const Entity* stored)
+	{
+		if (stored == nullptr || !bitfield::Has(stored->bitfield, container->flag))
+		{
+			return nullptr;
+		}
+
+		return &container->Get(stored->UUID);
+	}
+
+	// GetUnchecked returns the entity's component without the existence checks of GetComponent. The entity
+	// must exist and have the component: this is only validated as configured by BABS_ECS_CHECK_LEVEL, so
+	// with BABS_ECS_CHECK_NONE it costs no more than the data access itself (and, for this non-const
+	// overload, stamping the change tick).
+	//
+	// Typical usage: ecs.GetUnchecked<Position>(entity).x += velocity.x;
+	template<typename T>
+	inline T& ECSManager::GetUnchecked(Entity entity)
+	{
+		this->UnshareComponent<T>(entity);
+		const T& component = std::as_const(*this).template GetUnchecked<T>(entity);
+		this->FindContainer<T>()->MarkChanged(entity.UUID);
+
+		return const_cast<T&>(component);
+	}
+
+	template<typename T>
+	inline const T& ECSManager::GetUnchecked(Entity entity) const
+	{
+		const ComponentContainer<T>* container = this->GetContainer<T>();
+
+		BABS_ECS_CHECK(ComponentOf(container, this->FindEntity(entity.UUID)) != nullptr,
+			babs_ecs::ComponentNotFoundException(GetComponentName<T>(), entity.UUID));
+
+		return container->Get(entity.UUID);
+	}
+
+	// Returns the container of a registered component type. Throws if the component isn't registered.
+	template<typename T>
+	inline ComponentContainer<T>* ECSManager::GetContainer() const
+	{
+		ComponentContainer<T>* container = this->FindContainer<T>();
+		BABS_ECS_CHECK(container != nullptr, babs_ecs::ComponentNotRegisteredException(this->GetComponentName<T>()));
+
+		return container;
+	}
+
+	// Returns the container of a component type, or nullptr if it isn't registered.
+	template<typename T>
+	inline ComponentContainer<T>* ECSManager::FindContainer() const
+	{
+		uint32_t typeId = ComponentTypeId<T>();
+		if (typeId >= this->containersByType.size())
+		{
+			return nullptr;
+		}
+
+		// RegisterComponent created this container for exactly this type
+		return static_cast<ComponentContainer<T>*>(this->containersByType[typeId]);
+	}
+
+	// TryAddComponents is AddComponents reporting problems as a Status instead of throwing.
+	// Nothing is added unless every component type is registered and the entity exists.
+	template<typename ...Ts>
+	inline Status ECSManager::TryAddComponents(Entity entity, Ts... components)
+	{
+		if (((this->FindContainer<Ts>() == nullptr) || ...))
+		{
+			return Status::ComponentNotRegistered;
+		}
+
+		if (this->FindEntity(entity.UUID) == nullptr)
+		{
+			return Status::EntityNotFound;
+		}
+
+		this->AddComponents(entity, std::move(components)...);
+		return Status::Ok;
+	}
+
+	// TryRemoveComponents is RemoveComponents reporting problems as a Status instead of throwing.
+	template<typename ...Ts>
+	inline Status ECSManager::TryRemoveComponents(Entity entity)
+	{
+		if (((this->FindContainer<Ts>() == nullptr) || ...))
+		{
+			return Status::ComponentNotRegistered;
+		}
+
+		if (this->FindEntity(entity.UUID) == nullptr)
+		{
+			return Status::EntityNotFound;
+		}
+
+		this->RemoveComponents<Ts...>(entity);
+		return Status::Ok;
+	}
+
+	template<typename T>
+	inline Result<T*> ECSManager::TryGetComponent(Entity entity)
+	{
+		this->UnshareComponent<T>(entity);
+		Result<const T*> result = std::as_const(*this).template TryGetComponent<T>(entity);
+		if (result.value != nullptr)
+		{
+			this->FindContainer<T>()->MarkChanged(entity.UUID);
+		}
+
+		return { result.status, const_cast<T*>(result.value) };
+	}
+
+	// TryGetComponent is GetComponent telling apart why there's no component, without throwing.
+	template<typename T>
+	inline Result<const T*> ECSManager::TryGetComponent(Entity entity) const
+	{
+		const ComponentContainer<T>* container = this->FindContainer<T>();
+		if (container == nullptr)
+		{
+			return { Status::ComponentNotRegistered, nullptr };
+		}
+
+		const Entity* stored = this->FindEntity(entity.UUID);
+		if (stored == nullptr)
+		{
+			return { Status::EntityNotFound, nullptr };
+		}
+
+		const T* component = ComponentOf(container, stored);
+		return { component != nullptr ? Status::Ok : Status::ComponentNotFound, component };
+	}
+
+	// TryEntitiesWith is EntitiesWith reporting unregistered component types as a Status instead of throwing.
+	template<typename ...Ts>
+	inline Result<std::vector<Entity>> ECSManager::TryEntitiesWith() const
+	{
+		if (((this->FindContainer<Ts>() == nullptr) || ...))
+		{
+			return { Status::ComponentNotRegistered, {} };
+		}
+
+		return { Status::Ok, this->EntitiesWith<Ts...>() };
+	}
+
+	// OnEnter registers a handler called whenever an entity starts matching all of the provided
+	// component types, e.g. right after the last missing component was added.
+	//
+	// Typical usage: ecs.OnEnter<Position, Collider>([&](babs_ecs::Entity e) { ... });
+	template<typename ...Ts>
+	inline void ECSManager::OnEnter(QueryHandler handler)
+	{
+		static_assert(sizeof...(Ts) > 0, "OnEnter needs at least one component type");
+		this->enterObservers.push_back(QueryObserver{ this->GetComponentMask<Ts...>(), std::move(handler) });
+	}
+
+	// OnExit registers a handler called whenever an entity stops matching all of the provided
+	// component types. It fires before the component or entity is removed, so the data is still readable.
+	template<typename ...Ts>
+	inline void ECSManager::OnExit(QueryHandler handler)
+	{
+		static_assert(sizeof...(Ts) > 0, "OnExit needs at least one component type");
+		this->exitObservers.push_back(QueryObserver{ this->GetComponentMask<Ts...>(), std::move(handler) });
+	}
+
+	// Returns the combined bitfield flags of the provided component types, which must all be registered.
+	template<typename T, typename... Ts>
+	inline bitfield::Bitfield ECSManager::GetComponentMask() const
+	{
+		bitfield::Bitfield mask = this->GetContainer<T>()->flag;
+		((mask = bitfield::Set(mask, this->GetContainer<Ts>()->flag)), ...);
+
+		return mask;
+	}
+
+	// Returns a list of Entity pointers of entities matching the provided list of component types.
+	//
+	// If no component types are provided, all entities will be returned. Disabled entities are never returned.
+	// 
+	// Typical usage: auto entities = ecs.EntitiesWith<Identity, Health>();
+	template<typename ...Ts>
+	inline std::vector<Entity> ECSManager::EntitiesWith() const
+	{
+		// if no components were provided, we'll return all entities
+		if constexpr (sizeof...(Ts) == 0)
+		{
+			// Asking for all entities
+			std::vector<Entity> requestedEntities;
+			for (auto e : this->entities)
+			{
+				if (e.UUID != 0 && Matches(e.bitfield, 0))
+				{
+					requestedEntities.push_back(e);
+				}
+			}
+			return requestedEntities;
+		}
+		else
+		{
+			// looks like they asked for 1+ components. first we'll get each component's container
+			// and build our search bitfield (throws if any of them isn't registered)
+			std::array<const BaseContainer*, sizeof...(Ts)> containers{ this->GetContainer<Ts>()... };
+			bitfield::Bitfield field = this->GetComponentMask<Ts...>();
+
+			// grab the container with the fewest owners
+			const BaseContainer* smallest = *std::min_element(containers.begin(), containers.end(), [](auto lhs, auto rhs) { return lhs->Size() < rhs->Size(); });
+
+			// using its owners as our base, we'll check each entity against the search bitfield
+			std::vector<Entity> requestedEntities;
+			requestedEntities.reserve(smallest->Size());
+			for (auto entityId : smallest->Owners()) {
+				const Entity& e = this->entities[entityId];
+				if (Matches(e.bitfield, field)) {
+					requestedEntities.emplace_back(e);
+				}
+			}
+
+			return requestedEntities;
+		}
+	}
+
+	// ForEach calls func(entity, component) for every enabled entity with the component, walking the
+	// component storage in order instead of looking each entity up. The order is unspecified and the
+	// callback must not add or remove components of this type.
+	//
+	// What the callback takes decides whether the components count as changed (see WriteDelta): a callback
+	// taking const T& only reads them, one taking T& gets them for writing and stamps the change tick of
+	// every component it's passed. Generic callbacks must spell the component type out, since a const auto&
+	// parameter is taken as a read and an auto& one doesn't compile.
+	//
+	// Typical usage: ecs.ForEach<Position>([&](babs_ecs::Entity e, const Position& position) { ... });
+	template<typename T, typename Func>
+	inline void ECSManager::ForEach(Func&& func)
+	{
+		if constexpr (std::is_invocable_v<Func&, Entity, const T&>)
+		{
+			std::as_const(*this).template ForEach<T>(std::forward<Func>(func));
+		}
+		else
+		{
+			ComponentContainer<T>* container = this->GetContainer<T>();
+			const std::vector<uint32_t>& owners = container->Owners();
+
+			for (size_t i = 0; i < owners.size(); ++i)
+			{
+				const Entity& e = this->entities[owners[i]];
+				if (!bitfield::Has(e.bitfield, DisabledFlag))
+				{
+					container->MarkChangedAt(i);
+					func(e, container->At(i));
+				}
+			}
+		}
+	}
+
+	template<typename T, typename Func>
+	inline void ECSManager::ForEach(Func&& func) const
+	{
+		const ComponentContainer<T>* container = this->GetContainer<T>();
+		const std::vector<uint32_t>& owners = container->Owners();
+
+		for (size_t i = 0; i < owners.size(); ++i)
+		{
+			const Entity& e = this->entities[owners[i]];
+			if (!bitfield::Has(e.bitfield, DisabledFlag))
+			{
+				func(e, container->At(i));
+			}
+		}
+	}
+
+	// ForEachChangedSince calls func(entity) for every entity that may have started or stopped matching
+	// EntitiesWith<Ts...>(), or whose Ts changed, at or after sinceTick: entities removed, created, enabled or
+	// disabled, and entities that had one of the Ts added, changed or removed. An entity can come up more than
+	// once and removed ones come up by UUID, so use MatchesQuery to see where each one stands now. Like in
+	// WriteDelta, removals only come up while a history cursor covering sinceTick is open.
+	//
+	// While one is, the changes come from the logs OpenHistory keeps, so the cost is that of the changes.
+	// Otherwise, or when sinceTick is older than the logs, every entity and component is checked.
+	//
+	// Typical usage: ecs.ForEachChangedSince<Position>(lastTick, [&](babs_ecs::Entity e) { ... });
+	template <typename... Ts, typename Func>
+	inline void ECSManager::ForEachChangedSince(uint32_t sinceTick, Func&& func) const
+	{
+		for (const auto& entry : this->destroyedEntities)
+		{
+			if (entry.second >= sinceTick)
+			{
+				func(Entity(entry.first));
+			}
+		}
+
+		std::array<const BaseContainer*, sizeof...(Ts)> containers{ this->GetContainer<Ts>()... };
+
+		if (this->HasHistoryCursors() && sinceTick >= this->changeLogStart)
+		{
+			// removed entities came up above, and so do the ones that lost a component below
+			auto visit = [&](uint32_t entityId) {
+				if (const Entity* stored = this->FindEntity(entityId))
+				{
+					func(*stored);
+				}
+			};
+
+			for (const auto& entry : this->changedEntities)
+			{
+				if (entry.second >= sinceTick)
+				{
+					visit(entry.first);
+				}
+			}
+
+			for (const BaseContainer* container : containers)
+			{
+				for (const auto& entry : container->removals)
+				{
+					if (entry.second >= sinceTick)
+					{
+						func(Entity(entry.first));
+					}
+				}
+
+				container->ForEachChangeSince(sinceTick, visit);
+			}
+
+			return;
+		}
+
+		for (uint32_t entityId = 1; entityId < this->entities.size(); ++entityId)
+		{
+			if (this->entities[entityId].UUID != 0 && this->entityTicks[entityId] >= sinceTick)
+			{
+				func(this->entities[entityId]);
+			}
+		}
+
+		for (const BaseContainer* container : containers)
+		{
+			for (const auto& entry : container->removals)
+			{
+				if (entry.second >= sinceTick)
+				{
+					func(Entity(entry.first));
+				}
+			}
+
+			for (size_t i = 0; i < container->Size(); ++i)
+			{
+				if (container->ChangeTickAt(i) >= sinceTick)
+				{
+					func(this->entities[container->Owners()[i]]);
+				}
+			}
+		}
+	}
+
+	// MatchesQuery returns true if the entity exists and EntitiesWith<Ts...>() would return it.
+	template <typename... Ts>
+	inline bool ECSManager::MatchesQuery(Entity entity) const
+	{
+		const Entity* stored = this->FindEntity(entity.UUID);
+		if (stored == nullptr)
+		{
+			return false;
+		}
+
+		if constexpr (sizeof...(Ts) == 0)
+		{
+			return Matches(stored->bitfield, 0);
+		}
+		else
+		{
+			return Matches(stored->bitfield, this->GetComponentMask<Ts...>());
+		}
 	}
 
 	// Returns the compiler created string for this component. We don't actually care what the
 	// string is, but generally it seems to match the type name.
 	template<typename T>
-	inline bool ECSManager::HasComponent(Entity entity)
+	inline bool ECSManager::HasComponent(Entity entity) const
 	{
 		return this->GetComponent<T>(entity) != nullptr ? true : false;
 	}
@@ -1,6 +1,11 @@
 #include "doctest.h"
 
 #include <string>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <utility>
+#include <vector>
 
 #include "ECSManager.hpp"
 #include "Exceptions.hpp"
@@ -21,6 +26,12 @@ struct Health
 	int current;
 };
 
+struct Momentum
+{
+	float dx;
+	float dy;
+};
+
 TEST_SUITE("Manager Setup")
 {
     TEST_CASE("CreateEntity starts with entity UUID of 1")
@@ -326,4 +337,1088 @@ TEST_SUITE("Manager deleting entities")
 
 		REQUIRE(ident == nullptr);
 	}
-}
\ No newline at end of file
+}
+
+TEST_SUITE("Manager query observers")
+{
+	TEST_CASE("OnEnter fires once the last component of the query is added")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+
+		int entered = 0;
+		ecs.OnEnter<Identity, Health>([&](babs_ecs::Entity e) {
+			REQUIRE(ecs.GetComponent<Health>(e)->max == 10);
+			entered++;
+		});
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Identity{ "babs" });
+		REQUIRE(entered == 0);
+
+		ecs.AddComponent(e, Health{ 10, 10 });
+		REQUIRE(entered == 1);
+
+		// replacing a component doesn't change the match state
+		ecs.AddComponent(e, Health{ 10, 5 });
+		REQUIRE(entered == 1);
+	}
+
+	TEST_CASE("OnExit fires before the component is removed")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+
+		int exited = 0;
+		ecs.OnExit<Identity, Health>([&](babs_ecs::Entity e) {
+			REQUIRE(ecs.GetComponent<Health>(e) != nullptr);
+			exited++;
+		});
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Identity{ "babs" });
+		ecs.AddComponent(e, Health{ 10, 10 });
+
+		ecs.RemoveComponent<Identity>(e);
+		REQUIRE(exited == 1);
+
+		// the entity no longer matches, so removing the rest of the query is silent
+		ecs.RemoveComponent<Health>(e);
+		ecs.RemoveComponent<Health>(e);
+		REQUIRE(exited == 1);
+		REQUIRE(ecs.HasComponent<Health>(e) == false);
+	}
+
+	TEST_CASE("OnExit fires when a matching entity is removed")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+
+		std::vector<uint32_t> exited;
+		ecs.OnExit<Health>([&](babs_ecs::Entity e) { exited.push_back(e.UUID); });
+
+		babs_ecs::Entity e0 = ecs.CreateEntity();
+		babs_ecs::Entity e1 = ecs.CreateEntity();
+		ecs.AddComponent(e1, Health{ 10, 10 });
+
+		ecs.RemoveEntity(e0);
+		ecs.RemoveEntity(e1);
+
+		REQUIRE(exited == std::vector<uint32_t>{ e1.UUID });
+	}
+
+	TEST_CASE("Observing an unregistered component should throw")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		CHECK_THROWS_AS((ecs.OnEnter<Health, AI>([](babs_ecs::Entity) {})), const babs_ecs::ComponentNotRegisteredException);
+	}
+
+	TEST_CASE("Named handlers can be registered")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		int entered = 0;
+		babs_ecs::ECSManager::QueryHandler handler = [&](babs_ecs::Entity) { entered++; };
+		ecs.OnEnter<Health>(handler);
+		ecs.OnExit<Health>(handler);
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Health{ 10, 10 });
+		ecs.RemoveEntity(e);
+
+		REQUIRE(entered == 2);
+	}
+
+	TEST_CASE("Handlers can register more observers")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+
+		int registered = 0;
+		int entered = 0;
+		ecs.OnEnter<Health>([&](babs_ecs::Entity) {
+			// enough registrations that a vector would have to grow under the running handler
+			for (int i = 0; i < 64; ++i)
+			{
+				ecs.OnEnter<Health>([&](babs_ecs::Entity) { entered++; });
+				registered++;
+			}
+		});
+
+		babs_ecs::Entity e1 = ecs.CreateEntity();
+		ecs.AddComponent(e1, Health{ 10, 10 });
+
+		// the new observers only see later changes
+		REQUIRE(registered == 64);
+		REQUIRE(entered == 0);
+
+		babs_ecs::Entity e2 = ecs.CreateEntity();
+		ecs.AddComponent(e2, Health{ 10, 10 });
+
+		REQUIRE(registered == 128);
+		REQUIRE(entered == 64);
+	}
+}
+
+TEST_SUITE("Manager disabling entities")
+{
+	TEST_CASE("Disabled entities are skipped by searches but keep their components")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+
+		babs_ecs::Entity e0 = ecs.CreateEntity();
+		babs_ecs::Entity e1 = ecs.CreateEntity();
+		ecs.AddComponent(e0, Health{ 10, 10 });
+		ecs.AddComponent(e1, Health{ 20, 20 });
+
+		ecs.Disable(e0);
+
+		REQUIRE(ecs.IsEnabled(e0) == false);
+		REQUIRE(ecs.EntitiesWith<Health>().size() == 1);
+		REQUIRE(ecs.EntitiesWith<Health>()[0].UUID == e1.UUID);
+		REQUIRE(ecs.EntitiesWith().size() == 1);
+		REQUIRE(ecs.GetComponent<Health>(e0)->max == 10);
+
+		ecs.Enable(e0);
+
+		REQUIRE(ecs.IsEnabled(e0) == true);
+		REQUIRE(ecs.EntitiesWith<Health>().size() == 2);
+		REQUIRE(ecs.EntitiesWith().size() == 2);
+	}
+
+	TEST_CASE("Disabling doesn't fire component events")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		int events = 0;
+		ecs.events.Subscribe<babs_ecs::ComponentRemoved<Health>>([&](const babs_ecs::ComponentRemoved<Health>&) { events++; });
+		ecs.events.Subscribe<babs_ecs::ComponentAdded<Health>>([&](const babs_ecs::ComponentAdded<Health>&) { events++; });
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Health{ 10, 10 });
+		ecs.Disable(e);
+		ecs.Enable(e);
+
+		REQUIRE(events == 1);
+	}
+
+	TEST_CASE("Disabling moves entities out of and back into observed queries")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		int entered = 0;
+		int exited = 0;
+		ecs.OnEnter<Health>([&](babs_ecs::Entity) { entered++; });
+		ecs.OnExit<Health>([&](babs_ecs::Entity) { exited++; });
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Health{ 10, 10 });
+		ecs.Disable(e);
+		ecs.Disable(e);
+
+		REQUIRE(entered == 1);
+		REQUIRE(exited == 1);
+
+		// a disabled entity already left its queries
+		ecs.Enable(e);
+		ecs.Disable(e);
+		ecs.RemoveEntity(e);
+
+		REQUIRE(entered == 2);
+		REQUIRE(exited == 2);
+	}
+
+	TEST_CASE("Disabling a removed entity should throw")
+	{
+		babs_ecs::ECSManager ecs;
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.RemoveEntity(e);
+
+		CHECK_THROWS_AS(ecs.Disable(e), const babs_ecs::EntityNotFoundException);
+		CHECK_THROWS_AS(ecs.Enable(e), const babs_ecs::EntityNotFoundException);
+	}
+}
+
+TEST_SUITE("Manager bulk component changes")
+{
+	TEST_CASE("AddComponents adds every component with a single query transition")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<AI>();
+
+		int entered = 0;
+		int added = 0;
+		ecs.OnEnter<Identity, Health>([&](babs_ecs::Entity) { entered++; });
+		ecs.events.Subscribe<babs_ecs::ComponentAdded<Health>>([&](const babs_ecs::ComponentAdded<Health>&) { added++; });
+		ecs.events.Subscribe<babs_ecs::ComponentAdded<Identity>>([&](const babs_ecs::ComponentAdded<Identity>&) { added++; });
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponents(e, Identity{ "babs" }, Health{ 10, 5 });
+
+		REQUIRE(entered == 1);
+		REQUIRE(added == 2);
+		REQUIRE(ecs.GetComponent<Identity>(e)->name == "babs");
+		REQUIRE(ecs.GetComponent<Health>(e)->current == 5);
+		REQUIRE(ecs.EntitiesWith<Identity, Health>().size() == 1);
+		REQUIRE(ecs.EntitiesWith<AI>().size() == 0);
+	}
+
+	TEST_CASE("RemoveComponents removes only the components the entity has")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<AI>();
+
+		int exited = 0;
+		int removed = 0;
+		ecs.OnExit<Identity>([&](babs_ecs::Entity e) {
+			REQUIRE(ecs.GetComponent<Identity>(e) != nullptr);
+			exited++;
+		});
+		ecs.events.Subscribe<babs_ecs::ComponentRemoved<Health>>([&](const babs_ecs::ComponentRemoved<Health>& e) {
+			REQUIRE(e.component.max == 10);
+			removed++;
+		});
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponents(e, Identity{ "babs" }, Health{ 10, 5 });
+
+		ecs.RemoveComponents<Identity, Health, AI>(e);
+
+		REQUIRE(exited == 1);
+		REQUIRE(removed == 1);
+		REQUIRE(ecs.HasComponent<Identity>(e) == false);
+		REQUIRE(ecs.HasComponent<Health>(e) == false);
+		REQUIRE(ecs.EntitiesWith<Health>().size() == 0);
+		REQUIRE(ecs.EntitiesWith().size() == 1);
+	}
+
+	TEST_CASE("Bulk changes with an unregistered component should throw without changing the entity")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+
+		CHECK_THROWS_AS(ecs.AddComponents(e, Health{ 10, 10 }, AI{ "hard" }), const babs_ecs::ComponentNotRegisteredException);
+		REQUIRE(ecs.HasComponent<Health>(e) == false);
+
+		CHECK_THROWS_AS((ecs.RemoveComponents<Health, AI>(e)), const babs_ecs::ComponentNotRegisteredException);
+	}
+}
+
+TEST_SUITE("Manager fetching multiple components")
+{
+	TEST_CASE("GetComponents returns every requested component")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<AI>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponents(e, Identity{ "babs" }, Health{ 10, 5 });
+
+		auto [identity, health, ai] = ecs.GetComponents<Identity, Health, AI>(e);
+
+		REQUIRE(identity->name == "babs");
+		REQUIRE(health->current == 5);
+		REQUIRE(ai == nullptr);
+
+		// the pointers refer to the stored data
+		health->current = 7;
+		REQUIRE(ecs.GetComponent<Health>(e)->current == 7);
+	}
+
+	TEST_CASE("GetComponents on a removed entity returns nullptrs")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponents(e, Identity{ "babs" }, Health{ 10, 5 });
+		ecs.RemoveEntity(e);
+
+		auto [identity, health] = ecs.GetComponents<Identity, Health>(e);
+
+		REQUIRE(identity == nullptr);
+		REQUIRE(health == nullptr);
+	}
+
+	TEST_CASE("GetComponents with an unregistered component throws")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+
+		CHECK_THROWS_AS((ecs.GetComponents<Health, AI>(e)), const babs_ecs::ComponentNotRegisteredException);
+	}
+}
+
+TEST_SUITE("Manager gathering components")
+{
+	TEST_CASE("Gather resolves a list of entities in order")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		std::vector<babs_ecs::Entity> targets;
+		for (int i = 0; i < 40; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			if (i % 3 != 0)
+			{
+				ecs.AddComponent(e, Health{ i, i });
+			}
+			targets.push_back(e);
+		}
+
+		ecs.RemoveEntity(targets[4]);
+		targets.push_back(babs_ecs::Entity(1000));
+
+		std::vector<Health*> healths(targets.size());
+		ecs.Gather(targets, healths.data());
+
+		for (size_t i = 0; i < 40; ++i)
+		{
+			if (i % 3 == 0 || i == 4)
+			{
+				REQUIRE(healths[i] == nullptr);
+			}
+			else
+			{
+				REQUIRE(healths[i] == ecs.GetComponent<Health>(targets[i]));
+				REQUIRE(healths[i]->max == (int)i);
+			}
+		}
+		REQUIRE(healths[40] == nullptr);
+	}
+
+	TEST_CASE("ForEachGathered visits only entities with the component")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		std::vector<babs_ecs::Entity> targets;
+		for (int i = 0; i < 20; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			if (i % 2 == 0)
+			{
+				ecs.AddComponent(e, Health{ i, i });
+			}
+			targets.push_back(e);
+		}
+
+		std::vector<uint32_t> visited;
+		ecs.ForEachGathered<Health>(targets, [&](babs_ecs::Entity e, Health& health) {
+			visited.push_back(e.UUID);
+			health.current = 0;
+		});
+
+		REQUIRE(visited.size() == 10);
+		for (size_t i = 0; i < visited.size(); ++i)
+		{
+			REQUIRE(visited[i] == targets[i * 2].UUID);
+			REQUIRE(ecs.GetComponent<Health>(targets[i * 2])->current == 0);
+		}
+	}
+
+	TEST_CASE("Gather with an unregistered component throws")
+	{
+		babs_ecs::ECSManager ecs;
+		std::vector<babs_ecs::Entity> targets = { ecs.CreateEntity() };
+		std::vector<AI*> ais(1);
+
+		CHECK_THROWS_AS(ecs.Gather(targets, ais.data()), const babs_ecs::ComponentNotRegisteredException);
+	}
+
+	TEST_CASE("ForEach walks every enabled entity with the component")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		int expected = 0;
+		for (int i = 0; i < 30; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			if (i % 2 == 0)
+			{
+				ecs.AddComponent(e, Health{ i, i });
+				expected += i;
+			}
+		}
+
+		ecs.RemoveEntity(babs_ecs::Entity(1));
+		ecs.Disable(babs_ecs::Entity(3));
+		expected -= 2;
+
+		int sum = 0;
+		size_t visited = 0;
+		ecs.ForEach<Health>([&](babs_ecs::Entity e, const Health& health) {
+			REQUIRE(ecs.GetComponent<Health>(e) == &health);
+			sum += health.max;
+			++visited;
+		});
+
+		REQUIRE(visited == 13);
+		REQUIRE(sum == expected);
+	}
+}
+
+TEST_SUITE("Manager unchecked access")
+{
+	TEST_CASE("GetUnchecked returns a reference to the stored data")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Health{ 10, 5 });
+
+		Health& health = ecs.GetUnchecked<Health>(e);
+		REQUIRE(health.max == 10);
+
+		health.current = 1;
+		REQUIRE(ecs.GetComponent<Health>(e)->current == 1);
+	}
+
+	TEST_CASE("GetUnchecked validates according to the check level")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+
+		// the tests are built with the default BABS_ECS_CHECK_THROW level
+		CHECK_THROWS_AS(ecs.GetUnchecked<Health>(e), const babs_ecs::ComponentNotFoundException);
+		CHECK_THROWS_AS(ecs.GetUnchecked<AI>(e), const babs_ecs::ComponentNotRegisteredException);
+	}
+}
+
+TEST_SUITE("Manager status reporting")
+{
+	TEST_CASE("Try functions report problems as a status")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		babs_ecs::Entity e = ecs.CreateEntity();
+		babs_ecs::Entity missing(42);
+
+		REQUIRE(ecs.TryAddComponents(e, Health{ 10, 5 }) == babs_ecs::Status::Ok);
+		REQUIRE(ecs.TryAddComponents(e, Health{ 10, 5 }, AI{ "easy" }) == babs_ecs::Status::ComponentNotRegistered);
+		REQUIRE(ecs.TryAddComponents(missing, Health{ 10, 5 }) == babs_ecs::Status::EntityNotFound);
+
+		auto health = ecs.TryGetComponent<Health>(e);
+		REQUIRE(health.Ok());
+		REQUIRE(health.value->current == 5);
+		REQUIRE(ecs.TryGetComponent<AI>(e).status == babs_ecs::Status::ComponentNotRegistered);
+		REQUIRE(ecs.TryGetComponent<Health>(missing).status == babs_ecs::Status::EntityNotFound);
+
+		REQUIRE(ecs.TryEntitiesWith<Health>().value.size() == 1);
+		REQUIRE(!ecs.TryEntitiesWith<Health, AI>());
+
+		REQUIRE(ecs.TryRemoveComponents<Health>(e) == babs_ecs::Status::Ok);
+		REQUIRE(ecs.TryGetComponent<Health>(e).status == babs_ecs::Status::ComponentNotFound);
+		REQUIRE(ecs.TryGetComponent<Health>(e).value == nullptr);
+
+		REQUIRE(ecs.TryRemoveEntity(e) == babs_ecs::Status::Ok);
+		REQUIRE(ecs.TryRemoveEntity(e) == babs_ecs::Status::EntityNotFound);
+	}
+
+	TEST_CASE("Exceptions describe the error through what()")
+	{
+		babs_ecs::ECSManager ecs;
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.RemoveEntity(e);
+
+		std::string message;
+		try
+		{
+			ecs.RemoveEntity(e);
+		}
+		catch (const babs_ecs::EntityNotFoundException& ex)
+		{
+			message = ex.what();
+		}
+
+		REQUIRE(message == "1 was not found.");
+	}
+}
+
+TEST_SUITE("Manager concurrent reads")
+{
+	// only the const API is used from the worker threads
+	int SumHealth(const babs_ecs::ECSManager& ecs)
+	{
+		int sum = 0;
+		for (babs_ecs::Entity e : ecs.EntitiesWith<Health>())
+		{
+			if (ecs.HasComponent<Identity>(e))
+			{
+				auto [health, identity] = ecs.GetComponents<Health, Identity>(e);
+				sum += health->max + (int)identity->name.size();
+			}
+			else
+			{
+				sum += ecs.GetComponent<Health>(e)->max;
+			}
+		}
+		return sum;
+	}
+
+	TEST_CASE("Const reads from many threads see the same world")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Identity>();
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<AI>();
+
+		int expected = 0;
+		for (int i = 0; i < 1000; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			ecs.AddComponent(e, Health{ i, i });
+			expected += i;
+			if (i % 4 == 0)
+			{
+				ecs.AddComponent(e, Identity{ "babs" });
+				expected += 4;
+			}
+		}
+
+		// AI was registered but never added, which must not create anything while querying
+		const babs_ecs::ECSManager& world = ecs;
+		std::atomic<int> mismatches{ 0 };
+		std::vector<std::thread> workers;
+		for (int t = 0; t < 8; ++t)
+		{
+			workers.emplace_back([&]() {
+				for (int i = 0; i < 20; ++i)
+				{
+					if (SumHealth(world) != expected || world.EntitiesWith<AI, Health>().size() != 0)
+					{
+						mismatches++;
+					}
+				}
+			});
+		}
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		REQUIRE(mismatches == 0);
+	}
+}
+
+TEST_SUITE("Manager reserving entities")
+{
+	TEST_CASE("Reserved entities exist after a flush")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+
+		int created = 0;
+		ecs.events.Subscribe<babs_ecs::EntityCreated>([&](const babs_ecs::EntityCreated&) { created++; });
+
+		babs_ecs::Entity reserved = ecs.ReserveEntity();
+		REQUIRE(reserved.UUID == 1);
+		REQUIRE(ecs.EntitiesWith().size() == 0);
+		REQUIRE(ecs.TryAddComponents(reserved, Health{ 1, 1 }) == babs_ecs::Status::EntityNotFound);
+
+		ecs.FlushReservedEntities();
+		ecs.FlushReservedEntities();
+
+		REQUIRE(created == 1);
+		REQUIRE(ecs.EntitiesWith().size() == 1);
+		REQUIRE(ecs.TryAddComponents(reserved, Health{ 1, 1 }) == babs_ecs::Status::Ok);
+	}
+
+	TEST_CASE("CreateEntity flushes pending reservations first")
+	{
+		babs_ecs::ECSManager ecs;
+
+		babs_ecs::Entity reserved = ecs.ReserveEntity();
+		babs_ecs::Entity created = ecs.CreateEntity();
+
+		REQUIRE(reserved.UUID == 1);
+		REQUIRE(created.UUID == 2);
+		REQUIRE(ecs.EntitiesWith().size() == 2);
+	}
+
+	TEST_CASE("Many threads can reserve entities at once")
+	{
+		babs_ecs::ECSManager ecs;
+
+		std::vector<std::vector<babs_ecs::Entity>> reservedPerThread(8);
+		std::vector<std::thread> workers;
+		for (size_t t = 0; t < reservedPerThread.size(); ++t)
+		{
+			workers.emplace_back([&, t]() {
+				for (int i = 0; i < 1000; ++i)
+				{
+					reservedPerThread[t].push_back(ecs.ReserveEntity());
+				}
+			});
+		}
+
+		for (auto& worker : workers)
+		{
+			worker.join();
+		}
+
+		ecs.FlushReservedEntities();
+
+		std::vector<uint32_t> ids;
+		for (auto& reserved : reservedPerThread)
+		{
+			for (auto e : reserved)
+			{
+				ids.push_back(e.UUID);
+			}
+		}
+		std::sort(ids.begin(), ids.end());
+
+		REQUIRE(std::unique(ids.begin(), ids.end()) == ids.end());
+		REQUIRE(ids.front() == 1);
+		REQUIRE(ids.back() == 8000);
+		REQUIRE(ecs.EntitiesWith().size() == 8000);
+	}
+}
+
+// Returns the snapshot of the world, which is the same for worlds in the same state.
+static std::string SnapshotOf(const babs_ecs::ECSManager& ecs)
+{
+	std::stringstream stream;
+	ecs.SaveSnapshot(stream);
+	return stream.str();
+}
+
+// Steps a small deterministic simulation: everything moves, hurt entities lose health and die.
+static void SimulateFrame(babs_ecs::ECSManager& ecs, int frame)
+{
+	for (babs_ecs::Entity e : ecs.EntitiesWith<Health, Momentum>())
+	{
+		auto [health, momentum] = ecs.GetComponents<Health, Momentum>(e);
+		momentum->dx += 0.5f;
+		health->current -= static_cast<int>(e.UUID % 3);
+
+		if (health->current <= 0)
+		{
+			ecs.RemoveEntity(e);
+		}
+	}
+
+	babs_ecs::Entity spawned = ecs.CreateEntity();
+	ecs.AddComponents(spawned, Health{ 10, 10 + frame }, Momentum{ 0.0f, static_cast<float>(frame) });
+}
+
+TEST_SUITE("Manager rollback")
+{
+	TEST_CASE("Restore brings back the world as it was captured")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<Momentum>();
+
+		std::vector<babs_ecs::Entity> entities;
+		for (int i = 0; i < 3000; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			ecs.AddComponent(e, Health{ 100, i });
+			if (i % 2 == 0)
+			{
+				ecs.AddComponent(e, Momentum{ 1.0f, 2.0f });
+			}
+			entities.push_back(e);
+		}
+		ecs.RemoveEntity(entities[10]);
+
+		std::string captured = SnapshotOf(ecs);
+		babs_ecs::FrameHandle frame = ecs.CaptureFrame();
+
+		ecs.GetComponent<Health>(entities[0])->current = -1;
+		ecs.RemoveComponent<Momentum>(entities[2]);
+		ecs.AddComponent(entities[3], Momentum{ 5.0f, 5.0f });
+		ecs.RemoveEntity(entities[4]);
+		ecs.Disable(entities[5]);
+		for (int i = 0; i < 2000; ++i)
+		{
+			ecs.AddComponent(ecs.CreateEntity(), Health{ 1, 1 });
+		}
+
+		REQUIRE(ecs.Restore(frame) == babs_ecs::Status::Ok);
+		REQUIRE(SnapshotOf(ecs) == captured);
+		REQUIRE(ecs.GetComponent<Health>(entities[0])->current == 0);
+		REQUIRE(ecs.EntitiesWith<Health>().size() == 2999);
+
+		// the recycled UUID is handed out again, just like it would have been without the rollback
+		REQUIRE(ecs.CreateEntity().UUID == entities[10].UUID);
+
+		// a frame can be restored any number of times
+		REQUIRE(ecs.Restore(frame) == babs_ecs::Status::Ok);
+		REQUIRE(SnapshotOf(ecs) == captured);
+	}
+
+	TEST_CASE("Resimulating from a restored frame reproduces the same frames")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<Momentum>();
+
+		std::vector<babs_ecs::FrameHandle> history;
+		std::vector<std::string> states;
+		for (int frame = 0; frame < 40; ++frame)
+		{
+			history.push_back(ecs.CaptureFrame());
+			states.push_back(SnapshotOf(ecs));
+			SimulateFrame(ecs, frame);
+		}
+
+		// roll back 8 frames and simulate them again
+		REQUIRE(ecs.Restore(history[32]) == babs_ecs::Status::Ok);
+		REQUIRE(SnapshotOf(ecs) == states[32]);
+		for (int frame = 32; frame < 40; ++frame)
+		{
+			REQUIRE(SnapshotOf(ecs) == states[frame]);
+			ecs.CaptureFrame();
+			SimulateFrame(ecs, frame);
+		}
+
+		// the ring only keeps the last RollbackFrames captures
+		REQUIRE(ecs.Restore(history[0]) == babs_ecs::Status::FrameExpired);
+		REQUIRE(ecs.Restore(babs_ecs::FrameHandle()) == babs_ecs::Status::FrameExpired);
+	}
+
+	TEST_CASE("Restore never hands out reserved entities again")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		ecs.CreateEntity();
+		babs_ecs::FrameHandle frame = ecs.CaptureFrame();
+
+		babs_ecs::Entity reserved = ecs.ReserveEntity();
+		REQUIRE(ecs.Restore(frame) == babs_ecs::Status::ReservationsPending);
+
+		babs_ecs::Entity created = ecs.CreateEntity();
+		REQUIRE(created.UUID != reserved.UUID);
+		ecs.AddComponent(reserved, Health{ 10, 10 });
+		REQUIRE(ecs.GetComponent<Health>(reserved)->max == 10);
+
+		// once flushed, the reserved entity is rolled back like any other
+		REQUIRE(ecs.Restore(frame) == babs_ecs::Status::Ok);
+		REQUIRE(ecs.GetComponent<Health>(reserved) == nullptr);
+		REQUIRE(ecs.EntitiesWith().size() == 1);
+	}
+
+	TEST_CASE("Rollbacks show up in deltas")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		babs_ecs::Entity kept = ecs.CreateEntity();
+		ecs.AddComponent(kept, Health{ 10, 10 });
+		babs_ecs::Entity hurt = ecs.CreateEntity();
+		ecs.AddComponent(hurt, Health{ 10, 10 });
+
+		babs_ecs::ECSManager replica;
+		replica.RegisterComponent<Health>();
+		std::stringstream snapshot(SnapshotOf(ecs));
+		REQUIRE(replica.LoadSnapshot(snapshot) == babs_ecs::Status::Ok);
+
+		babs_ecs::FrameHandle frame = ecs.CaptureFrame();
+		ecs.GetComponent<Health>(hurt)->current = 5;
+		ecs.AddComponent(ecs.CreateEntity(), Health{ 1, 1 });
+		ecs.RemoveComponent<Health>(kept);
+
+		uint32_t since = ecs.AdvanceTick();
+		ecs.OpenHistory(since);
+		REQUIRE(ecs.Restore(frame) == babs_ecs::Status::Ok);
+
+		std::stringstream delta;
+		REQUIRE(ecs.WriteDelta(since, delta) == babs_ecs::Status::Ok);
+		REQUIRE(replica.ApplyDelta(delta) == babs_ecs::Status::Ok);
+
+		REQUIRE(replica.EntitiesWith<Health>().size() == 2);
+		REQUIRE(replica.GetComponent<Health>(hurt)->current == 10);
+		REQUIRE(replica.GetComponent<Health>(kept)->current == 10);
+	}
+}
+
+// Builds the same world, adding the components in forward or reverse order so they're stored differently.
+static void BuildHashedWorld(babs_ecs::ECSManager& ecs, bool reversed)
+{
+	ecs.RegisterComponent<Health>();
+	ecs.RegisterComponent<Momentum>();
+
+	std::vector<babs_ecs::Entity> entities;
+	for (int i = 0; i < 2500; ++i)
+	{
+		entities.push_back(ecs.CreateEntity());
+	}
+
+	for (int n = 0; n < 2500; ++n)
+	{
+		int i = reversed ? 2499 - n : n;
+		ecs.AddComponent(entities[i], Health{ 100, i });
+		if (i % 3 == 0)
+		{
+			ecs.AddComponent(entities[i], Momentum{ static_cast<float>(i), 0.5f });
+		}
+	}
+}
+
+TEST_SUITE("Manager state hashing")
+{
+	TEST_CASE("StateHash only depends on the state of the world")
+	{
+		babs_ecs::ECSManager ecs;
+		babs_ecs::ECSManager other;
+		BuildHashedWorld(ecs, false);
+		BuildHashedWorld(other, true);
+
+		REQUIRE(ecs.StateHash() == other.StateHash());
+		REQUIRE(ecs.StateHash() != babs_ecs::ECSManager().StateHash());
+
+		babs_ecs::FrameHandle frame = ecs.CaptureFrame();
+		uint64_t hash = ecs.StateHash();
+
+		ecs.GetComponent<Momentum>(babs_ecs::Entity(4))->dy = 0.25f;
+		REQUIRE(ecs.StateHash() != hash);
+
+		ecs.Restore(frame);
+		REQUIRE(ecs.StateHash() == hash);
+
+		ecs.Disable(babs_ecs::Entity(7));
+		REQUIRE(ecs.StateHash() != hash);
+		ecs.Enable(babs_ecs::Entity(7));
+		REQUIRE(ecs.StateHash() == hash);
+
+		// the same data on other entities is another state
+		ecs.RemoveComponent<Momentum>(babs_ecs::Entity(1));
+		ecs.AddComponent(babs_ecs::Entity(2), Momentum{ 0.0f, 0.5f });
+		REQUIRE(ecs.StateHash() != hash);
+	}
+}
+
+TEST_SUITE("Manager forking")
+{
+	TEST_CASE("Forks share component pages until either world writes to them")
+	{
+		babs_ecs::ECSManager ecs;
+		BuildHashedWorld(ecs, false);
+		uint64_t hash = ecs.StateHash();
+
+		std::unique_ptr<babs_ecs::ECSManager> fork = ecs.Fork();
+		REQUIRE(fork->StateHash() == hash);
+
+		const babs_ecs::ECSManager& parent = ecs;
+		const babs_ecs::ECSManager& child = *fork;
+		babs_ecs::Entity first(1);
+		babs_ecs::Entity last(2500);
+		REQUIRE(child.GetComponent<Health>(first) == parent.GetComponent<Health>(first));
+
+		// writing copies the page in the writing world only
+		fork->GetComponent<Health>(first)->current = -5;
+		REQUIRE(child.GetComponent<Health>(first) != parent.GetComponent<Health>(first));
+		REQUIRE(child.GetComponent<Health>(last) == parent.GetComponent<Health>(last));
+		REQUIRE(parent.GetComponent<Health>(first)->current == 0);
+
+		fork->RemoveEntity(babs_ecs::Entity(30));
+		fork->RemoveComponent<Momentum>(babs_ecs::Entity(3));
+		fork->AddComponent(fork->CreateEntity(), Health{ 1, 1 });
+		REQUIRE(ecs.StateHash() == hash);
+
+		// and the other way around
+		ecs.GetComponent<Health>(last)->current = 42;
+		REQUIRE(child.GetComponent<Health>(last)->current == 2499);
+		REQUIRE(child.GetComponent<Momentum>(babs_ecs::Entity(4))->dx == 3.0f);
+		REQUIRE(fork->EntitiesWith<Health>().size() == 2500);
+		REQUIRE(ecs.EntitiesWith<Health>().size() == 2500);
+		REQUIRE(fork->CreateEntity().UUID == 2501);
+
+		ecs.GetComponent<Health>(last)->current = 2499;
+		REQUIRE(ecs.StateHash() == hash);
+	}
+
+	TEST_CASE("Forking invalidates the component pointers of the original")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Health{ 1, 1 });
+
+		Health* before = ecs.GetComponent<Health>(e);
+		std::unique_ptr<babs_ecs::ECSManager> fork = ecs.Fork();
+
+		// the old pointer still points into the page the fork uses
+		const babs_ecs::ECSManager& child = *fork;
+		REQUIRE(child.GetComponent<Health>(e) == before);
+
+		// fetching again copies the page, after which both worlds change independently
+		Health* after = ecs.GetComponent<Health>(e);
+		REQUIRE(after != before);
+		after->current = 5;
+		REQUIRE(child.GetComponent<Health>(e)->current == 1);
+
+		fork->GetComponent<Health>(e)->current = 7;
+		REQUIRE(ecs.GetComponent<Health>(e)->current == 5);
+	}
+
+	TEST_CASE("Many forks can simulate different futures side by side")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<Momentum>();
+		for (int frame = 0; frame < 50; ++frame)
+		{
+			SimulateFrame(ecs, frame);
+		}
+
+		uint64_t hash = ecs.StateHash();
+
+		std::vector<std::unique_ptr<babs_ecs::ECSManager>> futures;
+		for (int i = 0; i < 4; ++i)
+		{
+			futures.push_back(ecs.Fork());
+		}
+
+		std::vector<std::thread> threads;
+		for (int i = 0; i < 4; ++i)
+		{
+			threads.emplace_back([&, i]() {
+				for (int frame = 50; frame < 50 + 10 * (i + 1); ++frame)
+				{
+					SimulateFrame(*futures[i], frame);
+				}
+			});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		REQUIRE(ecs.StateHash() == hash);
+
+		// the same future simulated on an unforked copy of the world comes out the same
+		for (int frame = 50; frame < 70; ++frame)
+		{
+			SimulateFrame(ecs, frame);
+		}
+
+		REQUIRE(ecs.StateHash() == futures[1]->StateHash());
+		REQUIRE(ecs.StateHash() != futures[0]->StateHash());
+
+		// forks of forks work the same way
+		std::unique_ptr<babs_ecs::ECSManager> nested = futures[0]->Fork();
+		futures[0]->Unshare();
+		for (int frame = 60; frame < 70; ++frame)
+		{
+			SimulateFrame(*nested, frame);
+		}
+
+		REQUIRE(nested->StateHash() == ecs.StateHash());
+	}
+
+	TEST_CASE("Batch forks keep their pools side by side in one allocation")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<Momentum>();
+		for (int i = 0; i < 100; ++i)
+		{
+			ecs.AddComponent(ecs.CreateEntity(), Health{ i, i });
+		}
+
+		uint64_t hash = ecs.StateHash();
+		std::vector<std::unique_ptr<babs_ecs::ECSManager>> forks = ecs.ForkBatch(8);
+		REQUIRE(forks.size() == 8);
+
+		// 100 components make slices of 128, one after the other
+		babs_ecs::Entity first(1);
+		const Health* start = std::as_const(*forks[0]).GetComponent<Health>(first);
+		for (size_t i = 0; i < forks.size(); ++i)
+		{
+			REQUIRE(forks[i]->StateHash() == hash);
+			REQUIRE(std::as_const(*forks[i]).GetComponent<Health>(first) == start + 128 * i);
+		}
+
+		// writing doesn't copy anything, and only changes the world written to
+		REQUIRE(forks[1]->GetComponent<Health>(first) == start + 128);
+		forks[1]->GetComponent<Health>(first)->current = -1;
+		REQUIRE(forks[0]->GetComponent<Health>(first)->current == 0);
+		REQUIRE(ecs.GetComponent<Health>(first)->current == 0);
+
+		// a fork outgrowing its slice adds pages of the same size, and empty pools grow from nothing
+		for (int i = 0; i < 200; ++i)
+		{
+			forks[2]->AddComponents(forks[2]->CreateEntity(), Health{ i, i }, Momentum{ 1.0f, 1.0f });
+		}
+		forks[2]->RemoveEntity(babs_ecs::Entity(50));
+
+		REQUIRE(forks[2]->EntitiesWith<Health>().size() == 299);
+		REQUIRE(forks[2]->GetComponent<Health>(babs_ecs::Entity(300))->current == 199);
+		REQUIRE(forks[2]->EntitiesWith<Health, Momentum>().size() == 200);
+		REQUIRE(forks[3]->StateHash() == hash);
+		REQUIRE(ecs.StateHash() == hash);
+	}
+
+	TEST_CASE("CopyFrom makes a world a copy of another in its own storage")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Health>();
+		ecs.RegisterComponent<Momentum>();
+		for (int i = 0; i < 100; ++i)
+		{
+			ecs.AddComponent(ecs.CreateEntity(), Health{ i, i });
+		}
+
+		std::vector<std::unique_ptr<babs_ecs::ECSManager>> forks = ecs.ForkBatch(2);
+		babs_ecs::ECSManager& world = *forks[0];
+		const Health* slot = std::as_const(world).GetComponent<Health>(babs_ecs::Entity(1));
+
+		world.RemoveEntity(babs_ecs::Entity(1));
+		world.AddComponents(world.CreateEntity(), Health{ 7, 7 }, Momentum{ 1.0f, 0.0f });
+		world.GetComponent<Health>(babs_ecs::Entity(2))->current = -1;
+		REQUIRE(world.StateHash() != ecs.StateHash());
+
+		REQUIRE(world.CopyFrom(ecs) == babs_ecs::Status::Ok);
+		REQUIRE(world.StateHash() == ecs.StateHash());
+		REQUIRE(world.GetComponent<Health>(babs_ecs::Entity(1)) == slot);
+		REQUIRE(world.EntitiesWith<Momentum>().empty());
+		REQUIRE(world.CreateEntity().UUID == 101);
+
+		// worlds registering other components, or in another order, are left alone
+		babs_ecs::ECSManager other;
+		other.RegisterComponent<Momentum>();
+		other.RegisterComponent<Health>();
+		REQUIRE(other.CopyFrom(ecs) == babs_ecs::Status::ComponentNotRegistered);
+		REQUIRE(other.EntitiesWith().empty());
+
+		// like Restore, reserved entities must be flushed first
+		forks[1]->ReserveEntity();
+		REQUIRE(forks[1]->CopyFrom(ecs) == babs_ecs::Status::ReservationsPending);
+		forks[1]->FlushReservedEntities();
+		REQUIRE(forks[1]->CopyFrom(ecs) == babs_ecs::Status::Ok);
+		REQUIRE(forks[1]->StateHash() == ecs.StateHash());
+	}
+}
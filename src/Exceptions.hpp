@@ -1,34 +1,60 @@
 #pragma once
 
-#include <iostream>
+#include <cstdint>
 #include <string>
-#include <sstream>
 #include <exception>
 
 namespace babs_ecs
 {
+    // The exceptions only build their message; nothing is written out when they're thrown,
+    // so callers decide if and where the friendly error text ends up (see what()).
     struct EntityNotFoundException : public std::exception
     {
     public:
-        EntityNotFoundException(uint32_t id) : entityId(id)
+        EntityNotFoundException(uint32_t id) : entityId(id), message(std::to_string(id) + " was not found.") {}
+
+        const char* what() const noexcept override
         {
-            std::cerr << this->entityId<< " was not found." << std::endl;
+            return this->message.c_str();
         }
 
     private:
         uint32_t entityId;
+        std::string message;
     };
 
 
     struct ComponentNotRegisteredException : public std::exception
     {
     public:
-        ComponentNotRegisteredException(std::string componentName) : componentNotRegistered(componentName) 
+        ComponentNotRegisteredException(std::string componentName)
+            : componentNotRegistered(componentName), message(componentName + " must be registered before being used.") {}
+
+        const char* what() const noexcept override
         {
-            std::cerr << this->componentNotRegistered << " must be registered before being used." << std::endl;
+            return this->message.c_str();
         }
 
     private:
         std::string componentNotRegistered;
+        std::string message;
+    };
+
+
+    struct ComponentNotFoundException : public std::exception
+    {
+    public:
+        ComponentNotFoundException(std::string componentName, uint32_t id)
+            : componentNotFound(componentName), entityId(id), message(std::to_string(id) + " doesn't have a " + componentName + " component.") {}
+
+        const char* what() const noexcept override
+        {
+            return this->message.c_str();
+        }
+
+    private:
+        std::string componentNotFound;
+        uint32_t entityId;
+        std::string message;
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,524 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Entity.hpp"
+
+namespace babs_ecs
+{
+	// InterestRule decides whether the candidate entity is relevant to the observer entity. Rules get the world
+	// as a const ECSManager&, so reading components in them doesn't count as changing them.
+	using InterestRule = std::function<bool(const ECSManager& ecs, Entity observer, Entity candidate)>;
+
+	// InterestSet is a set of entities that can be walked as a dense array, like the component storage.
+	class InterestSet
+	{
+	public:
+		const std::vector<Entity>& Entities() const
+		{
+			return this->entities;
+		}
+
+		size_t Size() const
+		{
+			return this->entities.size();
+		}
+
+		bool Contains(uint32_t entityId) const
+		{
+			return entityId < this->sparse.size() && this->sparse[entityId] != 0;
+		}
+
+		void Insert(uint32_t entityId)
+		{
+			if (this->Contains(entityId))
+			{
+				return;
+			}
+
+			if (entityId >= this->sparse.size())
+			{
+				this->sparse.resize(entityId + 1, 0);
+			}
+
+			this->entities.emplace_back(entityId);
+			this->sparse[entityId] = static_cast<uint32_t>(this->entities.size());
+		}
+
+		void Erase(uint32_t entityId)
+		{
+			if (!this->Contains(entityId))
+			{
+				return;
+			}
+
+			uint32_t index = this->sparse[entityId] - 1;
+			Entity last = this->entities.back();
+
+			this->entities[index] = last;
+			this->sparse[last.UUID] = index + 1;
+			this->entities.pop_back();
+			this->sparse[entityId] = 0;
+		}
+
+		void Clear()
+		{
+			for (Entity entity : this->entities)
+			{
+				this->sparse[entity.UUID] = 0;
+			}
+
+			this->entities.clear();
+		}
+
+	private:
+		std::vector<Entity> entities;
+
+		// sparse[UUID] is the index of the entity in entities plus one, 0 if it isn't in the set
+		std::vector<uint32_t> sparse;
+	};
+
+	// InterestManager keeps, for every observer (usually the entity of a player or an AI agent), the set of
+	// candidate entities relevant to it under an InterestRule, so replication and perception only walk those.
+	// Candidates are the entities EntitiesWith<Ts...>() returns for the tracked component types.
+	//
+	// Update is incremental: it uses the change ticks of the world (see ECSManager::AdvanceTick) to re-check
+	// only the candidates that were created, removed, enabled, disabled or had a tracked component changed
+	// since the last Update, and re-checks every candidate only for observers that changed themselves. The
+	// rule must only depend on the tracked components of the two entities; call Invalidate when it depends on
+	// anything else that changed. With UseGrid, observers that changed only re-check the candidates near them.
+	// The manager keeps a history cursor open on the world (see ECSManager::OpenHistory), so removals stay
+	// remembered until its next Update and the changes come from the world's change log: an Update costs
+	// what changed since the last one, not the size of the world.
+	//
+	// Typical usage:
+	//   babs_ecs::InterestManager interest(ecs, babs_ecs::InterestManager::WithinDistance<Position>(50.0f));
+	//   interest.Track<Position>();
+	//   interest.AddObserver(player);
+	//   interest.Update();                                 // once per tick, right before AdvanceTick
+	//   for (babs_ecs::Entity e : interest.RelevantTo(player)) { ... }
+	class InterestManager
+	{
+	public:
+		InterestManager(ECSManager& ecs, InterestRule rule) : ecs(ecs), rule(std::move(rule))
+		{
+			this->cursor = ecs.OpenHistory(ecs.CurrentTick());
+			this->Track<>();
+		}
+
+		InterestManager(const InterestManager&) = delete;
+		InterestManager& operator=(const InterestManager&) = delete;
+
+		~InterestManager()
+		{
+			this->ecs.CloseHistory(this->cursor);
+		}
+
+		// Track makes the entities with all of the Ts the candidates, and changes to the Ts what makes them
+		// be re-checked. Without a call to Track every entity is a candidate.
+		template <typename... Ts>
+		void Track()
+		{
+			this->forEachChanged = [](const ECSManager& ecs, uint32_t sinceTick, const std::function<void(Entity)>& func) {
+				ecs.ForEachChangedSince<Ts...>(sinceTick, func);
+			};
+			this->matches = [](const ECSManager& ecs, Entity entity) { return ecs.MatchesQuery<Ts...>(entity); };
+			this->everyCandidate = [](const ECSManager& ecs) { return ecs.EntitiesWith<Ts...>(); };
+			this->Invalidate();
+		}
+
+		// UseGrid keeps the candidates in a grid of radius sized cells by the x and y of their T, so an observer
+		// that changed only re-checks the candidates in the cells around its own (and its explicit ones) instead
+		// of every candidate. It's only right for rules that never make a candidate farther than radius from the
+		// observer relevant, like WithinDistance<T>(radius) or an AllOf with it. T must be one of the tracked
+		// component types, so candidates that move are moved in the grid too.
+		//
+		// Typical usage: interest.Track<Position, Team>(); interest.UseGrid<Position>(50.0f);
+		template <typename T>
+		void UseGrid(float radius)
+		{
+			this->cellOf = [radius](const ECSManager& ecs, Entity entity, int64_t& x, int64_t& y) {
+				const T* position = ecs.GetComponent<T>(entity);
+				if (position == nullptr)
+				{
+					return false;
+				}
+
+				// a position that isn't finite is never within radius, so it stays out of the grid; the others
+				// are clamped to the cells CellKey tells apart before the cast, which would overflow otherwise
+				double cellX = std::floor(static_cast<double>(position->x) / radius);
+				double cellY = std::floor(static_cast<double>(position->y) / radius);
+				if (!std::isfinite(cellX) || !std::isfinite(cellY))
+				{
+					return false;
+				}
+
+				x = static_cast<int64_t>(std::clamp(cellX, static_cast<double>(INT32_MIN), static_cast<double>(INT32_MAX)));
+				y = static_cast<int64_t>(std::clamp(cellY, static_cast<double>(INT32_MIN), static_cast<double>(INT32_MAX)));
+				return true;
+			};
+			this->Invalidate();
+		}
+
+		// AddObserver starts keeping the relevant set of the observer, filled by the next Update.
+		void AddObserver(Entity observer)
+		{
+			this->observers[observer.UUID].dirty = true;
+		}
+
+		void RemoveObserver(Entity observer)
+		{
+			this->observers.erase(observer.UUID);
+		}
+
+		// AddExplicit makes the candidate relevant to the observer whatever the rule says, for as long as it
+		// stays a candidate.
+		void AddExplicit(Entity observer, Entity candidate)
+		{
+			Observer& state = this->observers.at(observer.UUID);
+			state.explicitCandidates.insert(candidate.UUID);
+
+			if (this->candidates.Contains(candidate.UUID))
+			{
+				state.relevant.Insert(candidate.UUID);
+			}
+		}
+
+		void RemoveExplicit(Entity observer, Entity candidate)
+		{
+			Observer& state = this->observers.at(observer.UUID);
+			state.explicitCandidates.erase(candidate.UUID);
+			this->Evaluate(observer.UUID, state, candidate.UUID, this->candidates.Contains(candidate.UUID));
+		}
+
+		// Invalidate makes the next Update re-check every candidate for the observer.
+		void Invalidate(Entity observer)
+		{
+			this->observers.at(observer.UUID).dirty = true;
+		}
+
+		// Invalidate makes the next Update rebuild every set from scratch, e.g. after the rule's settings
+		// changed or a snapshot was loaded.
+		void Invalidate()
+		{
+			this->rebuild = true;
+		}
+
+		// Update brings every relevant set up to date with the changes made to the world since the last Update.
+		// Call it at the end of a tick, after that tick's changes: once the world moved on to a later tick,
+		// changes still stamped with the tick of the last Update aren't looked at again.
+		void Update()
+		{
+			uint32_t currentTick = this->ecs.CurrentTick();
+
+			if (this->rebuild)
+			{
+				this->candidates.Clear();
+				this->cells.clear();
+				this->candidateCells.clear();
+				for (Entity candidate : this->everyCandidate(this->ecs))
+				{
+					this->candidates.Insert(candidate.UUID);
+					this->PlaceInGrid(candidate.UUID, true);
+				}
+
+				for (auto& observer : this->observers)
+				{
+					this->Refresh(observer.first, observer.second);
+				}
+
+				this->rebuild = false;
+				this->lastTick = currentTick;
+				this->ecs.MoveHistory(this->cursor, currentTick);
+				return;
+			}
+
+			// the changes of the last Update's tick were all seen then, unless the tick hasn't moved on since
+			uint32_t sinceTick = currentTick != this->lastTick ? this->lastTick + 1 : this->lastTick;
+
+			// the same entity can come up several times, seen[UUID] filters out all but the first
+			++this->updates;
+			this->touched.clear();
+			this->forEachChanged(this->ecs, sinceTick, [this](Entity entity) {
+				if (entity.UUID >= this->seen.size())
+				{
+					this->seen.resize(entity.UUID + 1, 0);
+				}
+
+				if (this->seen[entity.UUID] != this->updates)
+				{
+					this->seen[entity.UUID] = this->updates;
+					this->touched.push_back(entity.UUID);
+				}
+			});
+
+			for (uint32_t entityId : this->touched)
+			{
+				bool isCandidate = this->matches(this->ecs, Entity(entityId));
+				if (isCandidate)
+				{
+					this->candidates.Insert(entityId);
+				}
+				else
+				{
+					this->candidates.Erase(entityId);
+				}
+				this->PlaceInGrid(entityId, isCandidate);
+
+				auto observer = this->observers.find(entityId);
+				if (observer != this->observers.end())
+				{
+					observer->second.dirty = true;
+				}
+			}
+
+			for (auto& observer : this->observers)
+			{
+				if (observer.second.dirty)
+				{
+					this->Refresh(observer.first, observer.second);
+					continue;
+				}
+
+				for (uint32_t entityId : this->touched)
+				{
+					this->Evaluate(observer.first, observer.second, entityId, this->candidates.Contains(entityId));
+				}
+			}
+
+			this->lastTick = currentTick;
+			this->ecs.MoveHistory(this->cursor, currentTick);
+		}
+
+		// RelevantTo returns the entities relevant to the observer as of the last Update, in no particular order.
+		const std::vector<Entity>& RelevantTo(Entity observer) const
+		{
+			return this->observers.at(observer.UUID).relevant.Entities();
+		}
+
+		bool IsRelevant(Entity observer, Entity candidate) const
+		{
+			auto state = this->observers.find(observer.UUID);
+			return state != this->observers.end() && state->second.relevant.Contains(candidate.UUID);
+		}
+
+		// Candidates returns every entity matching the tracked components as of the last Update.
+		const std::vector<Entity>& Candidates() const
+		{
+			return this->candidates.Entities();
+		}
+
+		// WithinDistance makes candidates relevant when their T is at most radius away from the observer's T.
+		// T needs x and y members, and z is used too when it has one.
+		template <typename T>
+		static InterestRule WithinDistance(float radius)
+		{
+			return [radius](const ECSManager& ecs, Entity observer, Entity candidate) {
+				const T* from = ecs.GetComponent<T>(observer);
+				const T* to = ecs.GetComponent<T>(candidate);
+				return from != nullptr && to != nullptr && DistanceSquared(*from, *to, 0) <= radius * radius;
+			};
+		}
+
+		// SameValue makes candidates relevant when their T compares equal to the observer's, e.g. a team.
+		template <typename T>
+		static InterestRule SameValue()
+		{
+			return [](const ECSManager& ecs, Entity observer, Entity candidate) {
+				const T* from = ecs.GetComponent<T>(observer);
+				const T* to = ecs.GetComponent<T>(candidate);
+				return from != nullptr && to != nullptr && *from == *to;
+			};
+		}
+
+		static InterestRule AllOf(InterestRule first, InterestRule second)
+		{
+			return [first, second](const ECSManager& ecs, Entity observer, Entity candidate) {
+				return first(ecs, observer, candidate) && second(ecs, observer, candidate);
+			};
+		}
+
+		static InterestRule AnyOf(InterestRule first, InterestRule second)
+		{
+			return [first, second](const ECSManager& ecs, Entity observer, Entity candidate) {
+				return first(ecs, observer, candidate) || second(ecs, observer, candidate);
+			};
+		}
+
+	private:
+		struct Observer
+		{
+			InterestSet relevant;
+			std::unordered_set<uint32_t> explicitCandidates;
+			bool dirty = true;
+		};
+
+		// Where a candidate is in the grid, see UseGrid.
+		struct GridPlace
+		{
+			bool placed = false;
+			uint64_t cell = 0;
+		};
+
+		static uint64_t CellKey(int64_t x, int64_t y)
+		{
+			return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+		}
+
+		template <typename T>
+		static auto DistanceSquared(const T& from, const T& to, int) -> decltype(from.z, float())
+		{
+			float x = to.x - from.x;
+			float y = to.y - from.y;
+			float z = to.z - from.z;
+			return x * x + y * y + z * z;
+		}
+
+		template <typename T>
+		static float DistanceSquared(const T& from, const T& to, long)
+		{
+			float x = to.x - from.x;
+			float y = to.y - from.y;
+			return x * x + y * y;
+		}
+
+		void Evaluate(uint32_t observerId, Observer& observer, uint32_t candidateId, bool isCandidate)
+		{
+			bool relevant = isCandidate && (observer.explicitCandidates.count(candidateId) != 0 || this->rule(this->ecs, Entity(observerId), Entity(candidateId)));
+
+			if (relevant)
+			{
+				observer.relevant.Insert(candidateId);
+			}
+			else
+			{
+				observer.relevant.Erase(candidateId);
+			}
+		}
+
+		void Refresh(uint32_t observerId, Observer& observer)
+		{
+			observer.relevant.Clear();
+			observer.dirty = false;
+
+			if (!this->cellOf)
+			{
+				for (Entity candidate : this->candidates.Entities())
+				{
+					this->Evaluate(observerId, observer, candidate.UUID, true);
+				}
+				return;
+			}
+
+			// with cells as large as the radius, every candidate within it is in the 3x3 cells around the observer
+			int64_t x = 0;
+			int64_t y = 0;
+			if (this->cellOf(this->ecs, Entity(observerId), x, y))
+			{
+				for (int64_t cellX = x - 1; cellX <= x + 1; ++cellX)
+				{
+					for (int64_t cellY = y - 1; cellY <= y + 1; ++cellY)
+					{
+						auto cell = this->cells.find(CellKey(cellX, cellY));
+						if (cell == this->cells.end())
+						{
+							continue;
+						}
+
+						for (uint32_t candidateId : cell->second)
+						{
+							this->Evaluate(observerId, observer, candidateId, true);
+						}
+					}
+				}
+			}
+
+			for (uint32_t candidateId : observer.explicitCandidates)
+			{
+				if (this->candidates.Contains(candidateId))
+				{
+					observer.relevant.Insert(candidateId);
+				}
+			}
+		}
+
+		// Moves the entity to the grid cell of its position, or out of the grid when it isn't a candidate.
+		void PlaceInGrid(uint32_t entityId, bool isCandidate)
+		{
+			if (!this->cellOf)
+			{
+				return;
+			}
+
+			GridPlace place;
+			int64_t x = 0;
+			int64_t y = 0;
+			if (isCandidate && this->cellOf(this->ecs, Entity(entityId), x, y))
+			{
+				place.placed = true;
+				place.cell = CellKey(x, y);
+			}
+
+			if (entityId >= this->candidateCells.size())
+			{
+				this->candidateCells.resize(entityId + 1);
+			}
+
+			GridPlace& current = this->candidateCells[entityId];
+			if (current.placed == place.placed && current.cell == place.cell)
+			{
+				return;
+			}
+
+			if (current.placed)
+			{
+				std::vector<uint32_t>& cell = this->cells[current.cell];
+				auto found = std::find(cell.begin(), cell.end(), entityId);
+				*found = cell.back();
+				cell.pop_back();
+				if (cell.empty())
+				{
+					this->cells.erase(current.cell);
+				}
+			}
+
+			if (place.placed)
+			{
+				this->cells[place.cell].push_back(entityId);
+			}
+
+			current = place;
+		}
+
+		ECSManager& ecs;
+		InterestRule rule;
+		HistoryCursor cursor;
+
+		// set by Track for its component types
+		std::function<void(const ECSManager&, uint32_t, const std::function<void(Entity)>&)> forEachChanged;
+		std::function<bool(const ECSManager&, Entity)> matches;
+		std::function<std::vector<Entity>(const ECSManager&)> everyCandidate;
+
+		// set by UseGrid: the grid cell of the entity's position, false if it has none
+		std::function<bool(const ECSManager&, Entity, int64_t&, int64_t&)> cellOf;
+		std::unordered_map<uint64_t, std::vector<uint32_t>> cells;
+		// candidateCells[UUID] is where the candidate is in the grid
+		std::vector<GridPlace> candidateCells;
+
+		std::unordered_map<uint32_t, Observer> observers;
+		InterestSet candidates;
+		bool rebuild = true;
+		uint32_t lastTick = 0;
+
+		std::vector<uint32_t> touched;
+		std::vector<uint32_t> seen;
+		uint32_t updates = 0;
+	};
+}
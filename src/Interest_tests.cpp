@@ -0,0 +1,360 @@
+#include "doctest.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Interest.hpp"
+#include "Replication.hpp"
+
+struct InterestPosition
+{
+	float x;
+	float y;
+};
+
+struct InterestTeam
+{
+	int id;
+
+	bool operator==(const InterestTeam& other) const
+	{
+		return this->id == other.id;
+	}
+};
+
+// Computes the relevant set of the observer from scratch, the way InterestManager must keep it.
+static std::vector<uint32_t> RelevantByScan(const babs_ecs::ECSManager& ecs, const babs_ecs::InterestRule& rule, babs_ecs::Entity observer)
+{
+	std::vector<uint32_t> relevant;
+	for (babs_ecs::Entity e : ecs.EntitiesWith<InterestPosition, InterestTeam>())
+	{
+		if (rule(ecs, observer, e))
+		{
+			relevant.push_back(e.UUID);
+		}
+	}
+
+	std::sort(relevant.begin(), relevant.end());
+	return relevant;
+}
+
+static std::vector<uint32_t> Sorted(const std::vector<babs_ecs::Entity>& entities)
+{
+	std::vector<uint32_t> ids;
+	for (babs_ecs::Entity e : entities)
+	{
+		ids.push_back(e.UUID);
+	}
+
+	std::sort(ids.begin(), ids.end());
+	return ids;
+}
+
+TEST_SUITE("Interest")
+{
+	TEST_CASE("Relevant sets follow changes to the world without rescanning it")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<InterestPosition>();
+		ecs.RegisterComponent<InterestTeam>();
+
+		std::vector<babs_ecs::Entity> entities;
+		for (int i = 0; i < 400; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			ecs.AddComponents(e, InterestPosition{ static_cast<float>(i % 20) * 5.0f, static_cast<float>(i / 20) * 5.0f }, InterestTeam{ i % 3 });
+			entities.push_back(e);
+		}
+
+		babs_ecs::InterestRule rule = babs_ecs::InterestManager::AllOf(
+			babs_ecs::InterestManager::WithinDistance<InterestPosition>(12.0f),
+			babs_ecs::InterestManager::SameValue<InterestTeam>());
+
+		size_t ruleCalls = 0;
+		babs_ecs::InterestManager interest(ecs, [&](const babs_ecs::ECSManager& world, babs_ecs::Entity observer, babs_ecs::Entity candidate) {
+			++ruleCalls;
+			return rule(world, observer, candidate);
+		});
+		interest.Track<InterestPosition, InterestTeam>();
+
+		std::vector<babs_ecs::Entity> observers = { entities[0], entities[150], entities[399] };
+		for (babs_ecs::Entity observer : observers)
+		{
+			interest.AddObserver(observer);
+		}
+
+		interest.Update();
+		ecs.AdvanceTick();
+		REQUIRE(interest.Candidates().size() == 400);
+		REQUIRE(ruleCalls == 3 * 400);
+
+		for (babs_ecs::Entity observer : observers)
+		{
+			REQUIRE(Sorted(interest.RelevantTo(observer)) == RelevantByScan(ecs, rule, observer));
+		}
+
+		// nothing changed, so nothing is checked again
+		ruleCalls = 0;
+		interest.Update();
+		ecs.AdvanceTick();
+		REQUIRE(ruleCalls == 0);
+
+		for (int tick = 0; tick < 20; ++tick)
+		{
+			// a few candidates move, one is removed, one is created and one is disabled or enabled
+			for (int i = tick + 1; i < 400; i += 50)
+			{
+				if (ecs.MatchesQuery<>(entities[i]))
+				{
+					ecs.GetComponent<InterestPosition>(entities[i])->x += 3.0f;
+				}
+			}
+
+			ecs.RemoveEntity(entities[100 + tick]);
+
+			babs_ecs::Entity created = ecs.CreateEntity();
+			ecs.AddComponents(created, InterestPosition{ static_cast<float>(tick) * 4.0f, 2.0f }, InterestTeam{ 0 });
+
+			if (tick % 2 == 0)
+			{
+				ecs.Disable(entities[300]);
+			}
+			else
+			{
+				ecs.Enable(entities[300]);
+			}
+
+			if (tick == 10)
+			{
+				ecs.RemoveComponent<InterestTeam>(entities[5]);
+				ecs.GetComponent<InterestPosition>(observers[1])->y -= 20.0f;
+			}
+
+			ruleCalls = 0;
+			interest.Update();
+			ecs.AdvanceTick();
+
+			if (tick != 10)
+			{
+				// each observer only looks at the handful of entities touched during the tick
+				REQUIRE(ruleCalls <= 3 * 12);
+			}
+
+			REQUIRE(interest.Candidates().size() == ecs.EntitiesWith<InterestPosition, InterestTeam>().size());
+			for (babs_ecs::Entity observer : observers)
+			{
+				REQUIRE(Sorted(interest.RelevantTo(observer)) == RelevantByScan(ecs, rule, observer));
+			}
+		}
+
+		REQUIRE_FALSE(interest.IsRelevant(observers[0], entities[5]));
+	}
+
+	TEST_CASE("With a grid, moving observers only re-check the candidates near them")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<InterestPosition>();
+		ecs.RegisterComponent<InterestTeam>();
+
+		std::vector<babs_ecs::Entity> entities;
+		for (int i = 0; i < 400; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			ecs.AddComponents(e, InterestPosition{ static_cast<float>(i % 20) * 5.0f, static_cast<float>(i / 20) * 5.0f }, InterestTeam{ i % 3 });
+			entities.push_back(e);
+		}
+
+		babs_ecs::InterestRule rule = babs_ecs::InterestManager::AllOf(
+			babs_ecs::InterestManager::WithinDistance<InterestPosition>(12.0f),
+			babs_ecs::InterestManager::SameValue<InterestTeam>());
+
+		size_t ruleCalls = 0;
+		babs_ecs::InterestManager interest(ecs, [&](const babs_ecs::ECSManager& world, babs_ecs::Entity observer, babs_ecs::Entity candidate) {
+			++ruleCalls;
+			return rule(world, observer, candidate);
+		});
+		interest.Track<InterestPosition, InterestTeam>();
+		interest.UseGrid<InterestPosition>(12.0f);
+
+		std::vector<babs_ecs::Entity> observers = { entities[0], entities[150], entities[399] };
+		for (babs_ecs::Entity observer : observers)
+		{
+			interest.AddObserver(observer);
+		}
+		interest.AddExplicit(observers[0], entities[399]);
+
+		interest.Update();
+		ecs.AdvanceTick();
+		REQUIRE(ruleCalls < 3 * 100);
+
+		for (int tick = 0; tick < 20; ++tick)
+		{
+			// every observer moves across the world, and so do a few candidates
+			for (babs_ecs::Entity observer : observers)
+			{
+				ecs.GetComponent<InterestPosition>(observer)->x = static_cast<float>((tick * 7 + observer.UUID) % 100);
+				ecs.GetComponent<InterestPosition>(observer)->y = static_cast<float>((tick * 11 + observer.UUID) % 100);
+			}
+
+			for (int i = tick + 1; i < 400; i += 50)
+			{
+				ecs.GetComponent<InterestPosition>(entities[i])->x += 13.0f;
+			}
+
+			if (tick == 10)
+			{
+				ecs.RemoveEntity(entities[200]);
+				ecs.RemoveComponent<InterestTeam>(entities[201]);
+			}
+
+			ruleCalls = 0;
+			interest.Update();
+			ecs.AdvanceTick();
+
+			// a 3x3 block of cells holds about 50 of the 400 candidates
+			REQUIRE(ruleCalls < 3 * 100);
+
+			for (babs_ecs::Entity observer : observers)
+			{
+				std::vector<uint32_t> expected = RelevantByScan(ecs, rule, observer);
+				if (observer == observers[0])
+				{
+					expected.push_back(entities[399].UUID);
+					std::sort(expected.begin(), expected.end());
+					expected.erase(std::unique(expected.begin(), expected.end()), expected.end());
+				}
+
+				REQUIRE(Sorted(interest.RelevantTo(observer)) == expected);
+			}
+		}
+	}
+
+	TEST_CASE("Positions the grid can't hold are handled without overflowing")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<InterestPosition>();
+
+		babs_ecs::Entity observer = ecs.CreateEntity();
+		babs_ecs::Entity near = ecs.CreateEntity();
+		babs_ecs::Entity lost = ecs.CreateEntity();
+		babs_ecs::Entity infinite = ecs.CreateEntity();
+		babs_ecs::Entity huge = ecs.CreateEntity();
+		ecs.AddComponent(observer, InterestPosition{ 0.0f, 0.0f });
+		ecs.AddComponent(near, InterestPosition{ 1.0f, 1.0f });
+		ecs.AddComponent(lost, InterestPosition{ std::numeric_limits<float>::quiet_NaN(), 0.0f });
+		ecs.AddComponent(infinite, InterestPosition{ 0.0f, -std::numeric_limits<float>::infinity() });
+		ecs.AddComponent(huge, InterestPosition{ 1e30f, -1e30f });
+
+		babs_ecs::InterestManager interest(ecs, babs_ecs::InterestManager::WithinDistance<InterestPosition>(5.0f));
+		interest.Track<InterestPosition>();
+		interest.UseGrid<InterestPosition>(5.0f);
+		interest.AddObserver(observer);
+		interest.AddObserver(huge);
+		interest.Update();
+
+		REQUIRE(Sorted(interest.RelevantTo(observer)) == std::vector<uint32_t>{ observer.UUID, near.UUID });
+		REQUIRE(Sorted(interest.RelevantTo(huge)) == std::vector<uint32_t>{ huge.UUID });
+
+		// moving to and from those positions keeps the grid consistent
+		ecs.AdvanceTick();
+		ecs.GetComponent<InterestPosition>(lost)->x = 2.0f;
+		ecs.GetComponent<InterestPosition>(near)->y = std::numeric_limits<float>::infinity();
+		ecs.GetComponent<InterestPosition>(huge)->x = 1e29f;
+		interest.Update();
+
+		REQUIRE(Sorted(interest.RelevantTo(observer)) == std::vector<uint32_t>{ observer.UUID, lost.UUID });
+		REQUIRE(Sorted(interest.RelevantTo(huge)) == std::vector<uint32_t>{ huge.UUID });
+	}
+
+	TEST_CASE("Explicit interest overrides the rule while the entity is a candidate")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<InterestPosition>();
+
+		babs_ecs::Entity observer = ecs.CreateEntity();
+		babs_ecs::Entity near = ecs.CreateEntity();
+		babs_ecs::Entity far = ecs.CreateEntity();
+		ecs.AddComponent(observer, InterestPosition{ 0.0f, 0.0f });
+		ecs.AddComponent(near, InterestPosition{ 1.0f, 1.0f });
+		ecs.AddComponent(far, InterestPosition{ 100.0f, 0.0f });
+
+		babs_ecs::InterestManager interest(ecs, babs_ecs::InterestManager::WithinDistance<InterestPosition>(5.0f));
+		interest.Track<InterestPosition>();
+		interest.AddObserver(observer);
+		interest.Update();
+
+		REQUIRE(interest.IsRelevant(observer, near));
+		REQUIRE_FALSE(interest.IsRelevant(observer, far));
+
+		interest.AddExplicit(observer, far);
+		REQUIRE(interest.IsRelevant(observer, far));
+
+		ecs.AdvanceTick();
+		ecs.GetComponent<InterestPosition>(far)->x = 200.0f;
+		interest.Update();
+		REQUIRE(interest.IsRelevant(observer, far));
+
+		ecs.AdvanceTick();
+		ecs.RemoveComponent<InterestPosition>(far);
+		interest.Update();
+		REQUIRE_FALSE(interest.IsRelevant(observer, far));
+
+		ecs.AdvanceTick();
+		ecs.AddComponent(far, InterestPosition{ 200.0f, 0.0f });
+		interest.Update();
+		REQUIRE(interest.IsRelevant(observer, far));
+
+		interest.RemoveExplicit(observer, far);
+		REQUIRE_FALSE(interest.IsRelevant(observer, far));
+		REQUIRE(interest.RelevantTo(observer).size() == 2);
+	}
+
+	TEST_CASE("Replicated clients only receive the entities relevant to their observer")
+	{
+		babs_ecs::ECSManager server;
+		server.RegisterComponent<InterestPosition>();
+
+		std::vector<babs_ecs::Entity> entities;
+		for (int i = 0; i < 100; ++i)
+		{
+			babs_ecs::Entity e = server.CreateEntity();
+			server.AddComponent(e, InterestPosition{ static_cast<float>(i), 0.0f });
+			entities.push_back(e);
+		}
+
+		babs_ecs::InterestManager interest(server, babs_ecs::InterestManager::WithinDistance<InterestPosition>(10.0f));
+		interest.Track<InterestPosition>();
+		interest.AddObserver(entities[0]);
+
+		babs_ecs::Replicator replicator(server);
+		replicator.Replicate<InterestPosition>();
+		uint32_t client = replicator.AddClient();
+		replicator.SetInterest(client, interest, entities[0]);
+
+		babs_ecs::ECSManager local;
+		local.RegisterComponent<InterestPosition>();
+		babs_ecs::ReplicaClient replica(local);
+		replica.Replicate<InterestPosition>();
+
+		interest.Update();
+		replicator.Capture();
+		auto ack = replica.ReadPacket(replicator.WritePacket(client));
+		REQUIRE(ack.status == babs_ecs::Status::Ok);
+		replicator.Acknowledge(client, ack.value);
+		REQUIRE(local.EntitiesWith<InterestPosition>().size() == 11);
+
+		// the observer moves away: what it left behind is removed on the client, what it reached arrives
+		server.AdvanceTick();
+		server.GetComponent<InterestPosition>(entities[0])->x = 50.0f;
+		interest.Update();
+		replicator.Capture();
+		ack = replica.ReadPacket(replicator.WritePacket(client));
+		REQUIRE(ack.status == babs_ecs::Status::Ok);
+
+		REQUIRE(local.EntitiesWith<InterestPosition>().size() == 22);
+		REQUIRE(local.GetComponent<InterestPosition>(replica.EntityFor(entities[5].UUID)) == nullptr);
+		REQUIRE(local.GetComponent<InterestPosition>(replica.EntityFor(entities[45].UUID))->x == 45.0f);
+	}
+}
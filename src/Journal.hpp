@@ -0,0 +1,368 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "ECSManager.hpp"
+#include "MappedFile.hpp"
+#include "Serialization.hpp"
+#include "Status.hpp"
+
+namespace babs_ecs
+{
+	// Journal is a crash recovery log for a world: every Commit appends what changed since the previous one
+	// (entities created and removed, components added, changed and removed) as a compact binary record, and
+	// every Checkpoint saves a full snapshot the journal then restarts from. Records and snapshots are made on
+	// the calling thread, which is cheap for records, and written to disk by a background thread, so a crash
+	// loses at most the commits still queued. Recover rebuilds the world from the files.
+	//
+	// The files are path + ".checkpoint" and path + ".journal". Written data is flushed to the OS after every
+	// batch, so it survives the process crashing but not necessarily the machine losing power.
+	//
+	// The journal follows the world's tick (see ECSManager::AdvanceTick) without advancing it itself, and keeps
+	// a history cursor of its own, so other consumers of the ticks and the removal history (InterestManager,
+	// deltas) aren't affected. Commit at the end of a tick, after its changes and before the tick advances: once
+	// the world moved on, changes still stamped with the tick of the last Commit aren't looked at again, while
+	// committing again in the same tick writes that tick's changes once more, which recovery applies twice
+	// without harm. Like any structural change, Commit and Checkpoint must not overlap with other uses of the
+	// world.
+	//
+	// Typical usage:
+	//   babs_ecs::Journal::Recover(ecs, "world");         // on startup, after registering the components
+	//   babs_ecs::Journal journal(ecs, "world", 3600);    // checkpoints every 3600 commits
+	//   journal.Commit();                                 // at the end of every tick, then ecs.AdvanceTick()
+	class Journal
+	{
+	public:
+		// Journal takes a first checkpoint right away. With a checkpointInterval, Commit takes a checkpoint
+		// on its own after that many commits.
+		Journal(ECSManager& ecs, std::string path, uint32_t checkpointInterval = 0) :
+			ecs(ecs), path(std::move(path)), checkpointInterval(checkpointInterval)
+		{
+			// generations tell a journal apart from the one of an earlier checkpoint left over by a crash
+			std::ifstream previous(this->path + ".checkpoint", std::ios::binary);
+			uint32_t magic = 0;
+			ReadValue(previous, magic);
+			ReadValue(previous, this->generation);
+			if (!previous || magic != CheckpointMagic)
+			{
+				this->generation = 0;
+			}
+
+			this->cursor = this->ecs.OpenHistory(this->ecs.CurrentTick());
+			this->writer = std::thread([this]() { this->Write(); });
+			this->Checkpoint();
+		}
+
+		Journal(const Journal&) = delete;
+		Journal& operator=(const Journal&) = delete;
+
+		// Waits for everything committed to be written.
+		~Journal()
+		{
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->stopping = true;
+			}
+
+			this->wake.notify_all();
+			this->writer.join();
+			this->ecs.CloseHistory(this->cursor);
+		}
+
+		// Commit queues a record of every change made since the last Commit or Checkpoint.
+		void Commit()
+		{
+			// the changes of the last commit's tick were all written then, unless the tick hasn't moved on since
+			uint32_t currentTick = this->ecs.CurrentTick();
+			uint32_t sinceTick = currentTick != this->committedTick ? this->committedTick + 1 : this->committedTick;
+
+			std::ostringstream record;
+			Status status = this->ecs.WriteDelta(sinceTick, record);
+			this->Committed(currentTick);
+
+			this->Enqueue(Task{ false, 0, status == Status::Ok ? record.str() : std::string(), status });
+
+			if (this->checkpointInterval != 0 && ++this->commits >= this->checkpointInterval)
+			{
+				this->Checkpoint();
+			}
+		}
+
+		// Checkpoint queues a snapshot of the whole world, after which the journal starts over empty.
+		void Checkpoint()
+		{
+			std::ostringstream snapshot;
+			Status status = this->ecs.SaveSnapshot(snapshot);
+			this->Committed(this->ecs.CurrentTick());
+			this->commits = 0;
+
+			this->Enqueue(Task{ true, ++this->generation, status == Status::Ok ? snapshot.str() : std::string(), status });
+		}
+
+		// Flush waits until everything queued so far is written and returns the first error met, if any. After an
+		// error, commits are dropped until a checkpoint is written successfully, so recovery gets back the world
+		// as of the last record written before the error rather than an inconsistent one.
+		Status Flush()
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->idle.wait(lock, [this]() { return this->tasks.empty() && !this->writing; });
+			return this->error;
+		}
+
+		// Recover replaces the world with the last checkpoint and replays the journal written after it, up to
+		// the last complete record. Every component type in the files must be registered. Recovering when
+		// there's no checkpoint yet returns StreamError and leaves the world untouched.
+		static Status Recover(ECSManager& ecs, const std::string& path)
+		{
+			std::ifstream checkpoint(path + ".checkpoint", std::ios::binary);
+			uint32_t magic = 0;
+			uint32_t generation = 0;
+			ReadValue(checkpoint, magic);
+			ReadValue(checkpoint, generation);
+
+			if (!checkpoint)
+			{
+				return Status::StreamError;
+			}
+
+			if (magic != CheckpointMagic)
+			{
+				return Status::InvalidSnapshot;
+			}
+
+			Status status = ecs.LoadSnapshot(checkpoint);
+			if (status != Status::Ok)
+			{
+				return status;
+			}
+
+			std::ifstream journal(path + ".journal", std::ios::binary);
+			uint32_t version = 0;
+			uint32_t journalGeneration = 0;
+			ReadValue(journal, magic);
+			ReadValue(journal, version);
+			ReadValue(journal, journalGeneration);
+
+			// a journal from an older checkpoint only holds changes the checkpoint already has
+			if (!journal || magic != JournalMagic || version != JournalVersion || journalGeneration != generation)
+			{
+				return Status::Ok;
+			}
+
+			std::string record;
+			while (true)
+			{
+				uint32_t size = 0;
+				uint32_t checksum = 0;
+				ReadValue(journal, size);
+				ReadValue(journal, checksum);
+
+				// the record the crash interrupted ends the journal
+				if (!ReadRecord(journal, size, record) || Checksum(record) != checksum)
+				{
+					return Status::Ok;
+				}
+
+				MemoryStreamBuffer buffer(record.data(), record.size());
+				std::istream stream(&buffer);
+
+				status = ecs.ApplyDelta(stream);
+				if (status != Status::Ok)
+				{
+					return status;
+				}
+			}
+		}
+
+	private:
+		// "BECK" starts checkpoints, "BECJ" journals
+		static constexpr uint32_t CheckpointMagic = 0x4B434542;
+		static constexpr uint32_t JournalMagic = 0x4A434542;
+		static constexpr uint32_t JournalVersion = 1;
+
+		struct Task
+		{
+			bool checkpoint;
+			uint32_t generation;
+			std::string bytes;
+			Status status;
+		};
+
+		// FNV-1a, enough to tell a torn record from a complete one
+		static uint32_t Checksum(const std::string& bytes)
+		{
+			uint32_t hash = 2166136261u;
+			for (char byte : bytes)
+			{
+				hash = (hash ^ static_cast<uint8_t>(byte)) * 16777619u;
+			}
+
+			return hash;
+		}
+
+		// Reads the record a chunk at a time, so a torn size can't allocate more than the file holds.
+		static bool ReadRecord(std::istream& stream, uint32_t size, std::string& record)
+		{
+			record.clear();
+			char buffer[4096];
+			while (stream && size > 0)
+			{
+				uint32_t chunk = size < sizeof(buffer) ? size : static_cast<uint32_t>(sizeof(buffer));
+				stream.read(buffer, chunk);
+				record.append(buffer, static_cast<size_t>(stream.gcount()));
+				size -= chunk;
+			}
+
+			return static_cast<bool>(stream);
+		}
+
+		// Moves the history cursor up to the tick written last, the oldest one the next Commit may still need.
+		void Committed(uint32_t tick)
+		{
+			this->committedTick = tick;
+			this->ecs.MoveHistory(this->cursor, tick);
+		}
+
+		void Enqueue(Task&& task)
+		{
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->tasks.push_back(std::move(task));
+			}
+
+			this->wake.notify_one();
+		}
+
+		// The background thread: writes whatever is queued, then flushes the whole batch at once.
+		void Write()
+		{
+			std::unique_lock<std::mutex> lock(this->mutex);
+			while (true)
+			{
+				this->wake.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+
+				if (this->tasks.empty())
+				{
+					return;
+				}
+
+				std::deque<Task> batch;
+				batch.swap(this->tasks);
+				this->writing = true;
+				lock.unlock();
+
+				Status status = Status::Ok;
+				for (Task& task : batch)
+				{
+					Status written = task.status;
+					if (written == Status::Ok && task.checkpoint)
+					{
+						written = this->WriteCheckpoint(task);
+					}
+					else if (written == Status::Ok && this->appending)
+					{
+						written = this->WriteRecord(task);
+					}
+
+					// a record missing from the journal, or one appended to the journal of an older checkpoint,
+					// would make recovery apply changes to a world they weren't made in, so nothing is appended
+					// until the next checkpoint has been written
+					if (written != Status::Ok)
+					{
+						this->appending = false;
+					}
+
+					status = status != Status::Ok ? status : written;
+				}
+
+				this->journal.flush();
+				if (status == Status::Ok && !this->journal)
+				{
+					status = Status::StreamError;
+				}
+
+				lock.lock();
+				this->writing = false;
+				this->error = this->error != Status::Ok ? this->error : status;
+				this->idle.notify_all();
+			}
+		}
+
+		Status WriteCheckpoint(const Task& task)
+		{
+			std::string checkpointPath = this->path + ".checkpoint";
+			std::string temporaryPath = checkpointPath + ".tmp";
+
+			{
+				std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+				WriteValue(file, CheckpointMagic);
+				WriteValue(file, task.generation);
+				file.write(task.bytes.data(), static_cast<std::streamsize>(task.bytes.size()));
+				file.flush();
+
+				if (!file)
+				{
+					return Status::StreamError;
+				}
+			}
+
+			// the checkpoint must be complete before it replaces the previous one, and before the journal
+			// of the previous one is dropped
+#ifdef _WIN32
+			std::remove(checkpointPath.c_str());
+#endif
+			if (std::rename(temporaryPath.c_str(), checkpointPath.c_str()) != 0)
+			{
+				return Status::StreamError;
+			}
+
+			this->journal.close();
+			this->journal.clear();
+			this->journal.open(this->path + ".journal", std::ios::binary | std::ios::trunc);
+			WriteValue(this->journal, JournalMagic);
+			WriteValue(this->journal, JournalVersion);
+			WriteValue(this->journal, task.generation);
+
+			this->appending = static_cast<bool>(this->journal);
+			return this->journal ? Status::Ok : Status::StreamError;
+		}
+
+		Status WriteRecord(const Task& task)
+		{
+			WriteValue(this->journal, static_cast<uint32_t>(task.bytes.size()));
+			WriteValue(this->journal, Checksum(task.bytes));
+			this->journal.write(task.bytes.data(), static_cast<std::streamsize>(task.bytes.size()));
+
+			return this->journal ? Status::Ok : Status::StreamError;
+		}
+
+		ECSManager& ecs;
+		std::string path;
+		uint32_t checkpointInterval;
+		uint32_t commits = 0;
+		uint32_t generation = 0;
+		uint32_t committedTick = 0;
+		HistoryCursor cursor;
+
+		// everything below is shared with the background thread, which alone touches the journal file and
+		// whether records are appended to it
+		std::ofstream journal;
+		bool appending = false;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		std::deque<Task> tasks;
+		bool writing = false;
+		bool stopping = false;
+		Status error = Status::Ok;
+		std::thread writer;
+	};
+}
@@ -0,0 +1,276 @@
+#include "doctest.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Interest.hpp"
+#include "Journal.hpp"
+
+struct Wallet
+{
+	int32_t gold;
+};
+
+struct Home
+{
+	float x;
+	float y;
+};
+
+static const char* JournalPath = "babs_ecs_journal_test";
+
+static void RemoveJournalFiles()
+{
+	std::remove((std::string(JournalPath) + ".checkpoint").c_str());
+	std::remove((std::string(JournalPath) + ".journal").c_str());
+}
+
+static std::string ReadFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void RegisterJournaled(babs_ecs::ECSManager& ecs)
+{
+	ecs.RegisterComponent<Wallet>();
+	ecs.RegisterComponent<Home>();
+}
+
+// Checks that the recovered world holds the same entities and components as the original one.
+static void RequireSameWorld(const babs_ecs::ECSManager& original, const babs_ecs::ECSManager& recovered)
+{
+	REQUIRE(recovered.EntitiesWith<>().size() == original.EntitiesWith<>().size());
+	REQUIRE(recovered.EntitiesWith<Wallet>().size() == original.EntitiesWith<Wallet>().size());
+	REQUIRE(recovered.EntitiesWith<Home>().size() == original.EntitiesWith<Home>().size());
+
+	original.ForEach<Wallet>([&](babs_ecs::Entity e, const Wallet& wallet) {
+		REQUIRE(recovered.GetComponent<Wallet>(e)->gold == wallet.gold);
+	});
+
+	original.ForEach<Home>([&](babs_ecs::Entity e, const Home& home) {
+		REQUIRE(recovered.GetComponent<Home>(e)->x == home.x);
+	});
+}
+
+TEST_SUITE("Journal")
+{
+	TEST_CASE("Recover rebuilds the world from the checkpoint and the journal")
+	{
+		RemoveJournalFiles();
+
+		babs_ecs::ECSManager ecs;
+		RegisterJournaled(ecs);
+
+		std::vector<babs_ecs::Entity> players;
+		for (int i = 0; i < 50; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			ecs.AddComponent(e, Wallet{ i });
+			players.push_back(e);
+		}
+
+		{
+			babs_ecs::Journal journal(ecs, JournalPath, 4);
+
+			for (int tick = 0; tick < 10; ++tick)
+			{
+				ecs.GetComponent<Wallet>(players[tick])->gold += 100;
+				ecs.AddComponent(players[tick + 10], Home{ static_cast<float>(tick), 1.0f });
+				ecs.RemoveEntity(players[tick + 30]);
+				ecs.AddComponent(ecs.CreateEntity(), Wallet{ 1000 + tick });
+
+				if (tick == 7)
+				{
+					ecs.RemoveComponent<Wallet>(players[1]);
+					ecs.Disable(players[2]);
+				}
+
+				journal.Commit();
+				ecs.AdvanceTick();
+			}
+
+			REQUIRE(journal.Flush() == babs_ecs::Status::Ok);
+		}
+
+		babs_ecs::ECSManager recovered;
+		RegisterJournaled(recovered);
+		REQUIRE(babs_ecs::Journal::Recover(recovered, JournalPath) == babs_ecs::Status::Ok);
+		RequireSameWorld(ecs, recovered);
+		REQUIRE_FALSE(recovered.IsEnabled(players[2]));
+
+		// the recovered world carries on journaling where the crashed one stopped
+		{
+			babs_ecs::Journal journal(recovered, JournalPath);
+			recovered.GetComponent<Wallet>(players[0])->gold = 7;
+			journal.Commit();
+		}
+
+		babs_ecs::ECSManager again;
+		RegisterJournaled(again);
+		REQUIRE(babs_ecs::Journal::Recover(again, JournalPath) == babs_ecs::Status::Ok);
+		RequireSameWorld(recovered, again);
+		REQUIRE(again.GetComponent<Wallet>(players[0])->gold == 7);
+
+		RemoveJournalFiles();
+	}
+
+	TEST_CASE("Recover stops at a torn record and ignores journals of older checkpoints")
+	{
+		RemoveJournalFiles();
+
+		babs_ecs::ECSManager ecs;
+		RegisterJournaled(ecs);
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Wallet{ 1 });
+
+		std::string olderJournal;
+		{
+			babs_ecs::Journal journal(ecs, JournalPath);
+			ecs.GetComponent<Wallet>(e)->gold = 2;
+			journal.Commit();
+			REQUIRE(journal.Flush() == babs_ecs::Status::Ok);
+			olderJournal = ReadFile(std::string(JournalPath) + ".journal");
+
+			ecs.GetComponent<Wallet>(e)->gold = 3;
+			journal.Commit();
+		}
+
+		// the crash cut the last record short
+		std::string journalPath = std::string(JournalPath) + ".journal";
+		std::string complete = ReadFile(journalPath);
+		std::ofstream(journalPath, std::ios::binary | std::ios::trunc) << complete.substr(0, complete.size() - 5);
+
+		babs_ecs::ECSManager recovered;
+		RegisterJournaled(recovered);
+		REQUIRE(babs_ecs::Journal::Recover(recovered, JournalPath) == babs_ecs::Status::Ok);
+		REQUIRE(recovered.GetComponent<Wallet>(e)->gold == 2);
+
+		// the crash came between a new checkpoint and its new journal
+		{
+			babs_ecs::Journal journal(ecs, JournalPath);
+		}
+		std::ofstream(journalPath, std::ios::binary | std::ios::trunc) << olderJournal;
+
+		REQUIRE(babs_ecs::Journal::Recover(recovered, JournalPath) == babs_ecs::Status::Ok);
+		REQUIRE(recovered.GetComponent<Wallet>(e)->gold == 3);
+
+		RemoveJournalFiles();
+		REQUIRE(babs_ecs::Journal::Recover(recovered, JournalPath) == babs_ecs::Status::StreamError);
+		REQUIRE(recovered.GetComponent<Wallet>(e)->gold == 3);
+	}
+
+	TEST_CASE("Journaling leaves the tick and the removal history to the other consumers")
+	{
+		RemoveJournalFiles();
+
+		babs_ecs::ECSManager ecs;
+		RegisterJournaled(ecs);
+
+		babs_ecs::Entity observer = ecs.CreateEntity();
+		ecs.AddComponent(observer, Home{ 0.0f, 0.0f });
+		std::vector<babs_ecs::Entity> neighbours;
+		for (int i = 0; i < 10; ++i)
+		{
+			neighbours.push_back(ecs.CreateEntity());
+			ecs.AddComponent(neighbours.back(), Home{ static_cast<float>(i), 0.0f });
+		}
+
+		babs_ecs::InterestManager interest(ecs, babs_ecs::InterestManager::WithinDistance<Home>(20.0f));
+		interest.Track<Home>();
+		interest.AddObserver(observer);
+		interest.Update();
+		REQUIRE(interest.RelevantTo(observer).size() == 11);
+
+		{
+			babs_ecs::Journal journal(ecs, JournalPath);
+			for (int tick = 0; tick < 5; ++tick)
+			{
+				ecs.RemoveEntity(neighbours[2 * tick]);
+				ecs.RemoveComponent<Home>(neighbours[2 * tick + 1]);
+
+				// the journal commits first, and must neither advance the tick nor drop the removals
+				journal.Commit();
+				REQUIRE(ecs.CurrentTick() == static_cast<uint32_t>(tick));
+				interest.Update();
+				REQUIRE(interest.RelevantTo(observer).size() == static_cast<size_t>(9 - 2 * tick));
+
+				ecs.AdvanceTick();
+			}
+
+			REQUIRE(journal.Flush() == babs_ecs::Status::Ok);
+		}
+
+		// and the interest manager's own cursor doesn't cost the journal anything
+		babs_ecs::ECSManager recovered;
+		RegisterJournaled(recovered);
+		REQUIRE(babs_ecs::Journal::Recover(recovered, JournalPath) == babs_ecs::Status::Ok);
+		RequireSameWorld(ecs, recovered);
+		REQUIRE(recovered.EntitiesWith<>().size() == 6);
+
+		RemoveJournalFiles();
+	}
+
+	TEST_CASE("Nothing is journaled after a checkpoint failed until one succeeds")
+	{
+		RemoveJournalFiles();
+
+		babs_ecs::ECSManager ecs;
+		RegisterJournaled(ecs);
+		babs_ecs::Entity first = ecs.CreateEntity();
+		ecs.AddComponent(first, Wallet{ 1 });
+
+		// a directory in the way of the temporary checkpoint file makes writing it fail
+		std::string blocked = std::string(JournalPath) + ".checkpoint.tmp";
+		std::filesystem::remove(blocked);
+
+		babs_ecs::ECSManager committed;
+		{
+			babs_ecs::Journal journal(ecs, JournalPath);
+			ecs.GetComponent<Wallet>(first)->gold = 2;
+			journal.Commit();
+			ecs.AdvanceTick();
+			REQUIRE(journal.Flush() == babs_ecs::Status::Ok);
+
+			RegisterJournaled(committed);
+			REQUIRE(babs_ecs::Journal::Recover(committed, JournalPath) == babs_ecs::Status::Ok);
+
+			// the entity only reaches the checkpoint that fails, later records change it
+			REQUIRE(std::filesystem::create_directory(blocked));
+			babs_ecs::Entity second = ecs.CreateEntity();
+			ecs.AddComponent(second, Wallet{ 10 });
+			journal.Checkpoint();
+			ecs.AdvanceTick();
+
+			ecs.GetComponent<Wallet>(second)->gold = 20;
+			journal.Commit();
+			ecs.AdvanceTick();
+			REQUIRE(journal.Flush() == babs_ecs::Status::StreamError);
+
+			babs_ecs::ECSManager recovered;
+			RegisterJournaled(recovered);
+			REQUIRE(babs_ecs::Journal::Recover(recovered, JournalPath) == babs_ecs::Status::Ok);
+			RequireSameWorld(committed, recovered);
+
+			// once a checkpoint goes through, journaling resumes
+			std::filesystem::remove(blocked);
+			journal.Checkpoint();
+			ecs.GetComponent<Wallet>(first)->gold = 3;
+			journal.Commit();
+			journal.Flush();
+		}
+
+		babs_ecs::ECSManager recovered;
+		RegisterJournaled(recovered);
+		REQUIRE(babs_ecs::Journal::Recover(recovered, JournalPath) == babs_ecs::Status::Ok);
+		RequireSameWorld(ecs, recovered);
+		REQUIRE(recovered.GetComponent<Wallet>(first)->gold == 3);
+
+		RemoveJournalFiles();
+	}
+}
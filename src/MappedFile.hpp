@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <fstream>
+#include <memory>
+#include <new>
+#include <streambuf>
+#include <string>
+
+#include "Config.hpp"
+
+#if BABS_ECS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace babs_ecs
+{
+	// Sections of mapped snapshots start at multiples of this many bytes, so they're aligned for any
+	// component and start on an OS page.
+	constexpr size_t MappedAlignment = 4096;
+
+	// Rounds size up to the next multiple of MappedAlignment.
+	inline size_t AlignMapped(size_t size)
+	{
+		return (size + MappedAlignment - 1) / MappedAlignment * MappedAlignment;
+	}
+
+	// MappedFile is a private, writable view of a whole file. Writes only change the memory of this
+	// process and never reach the file. With BABS_ECS_MMAP the file is memory mapped, so its pages are only
+	// read when first touched; otherwise it's read into memory up front.
+	class MappedFile
+	{
+	public:
+		// Returns nullptr if the file can't be opened, is empty, or can't be mapped.
+		static std::shared_ptr<MappedFile> Open(const std::string& path)
+		{
+			std::shared_ptr<MappedFile> file(new MappedFile());
+
+#if BABS_ECS_MMAP
+			int descriptor = ::open(path.c_str(), O_RDONLY);
+			if (descriptor < 0)
+			{
+				return nullptr;
+			}
+
+			struct stat info;
+			if (::fstat(descriptor, &info) != 0 || info.st_size <= 0)
+			{
+				::close(descriptor);
+				return nullptr;
+			}
+
+			void* data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, descriptor, 0);
+			::close(descriptor);
+
+			if (data == MAP_FAILED)
+			{
+				return nullptr;
+			}
+
+			file->data = static_cast<char*>(data);
+			file->size = static_cast<size_t>(info.st_size);
+#else
+			std::ifstream stream(path, std::ios::binary | std::ios::ate);
+			std::streamoff size = stream ? static_cast<std::streamoff>(stream.tellg()) : 0;
+			if (size <= 0)
+			{
+				return nullptr;
+			}
+
+			file->data = new (std::align_val_t(MappedAlignment)) char[static_cast<size_t>(size)];
+			file->size = static_cast<size_t>(size);
+
+			stream.seekg(0);
+			if (!stream.read(file->data, size))
+			{
+				return nullptr;
+			}
+#endif
+
+			return file;
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		~MappedFile()
+		{
+			if (this->data == nullptr)
+			{
+				return;
+			}
+
+#if BABS_ECS_MMAP
+			::munmap(this->data, this->size);
+#else
+			::operator delete[](this->data, std::align_val_t(MappedAlignment));
+#endif
+		}
+
+		char* Data()
+		{
+			return this->data;
+		}
+
+		size_t Size() const
+		{
+			return this->size;
+		}
+
+	private:
+		MappedFile() {};
+
+		char* data = nullptr;
+		size_t size = 0;
+	};
+
+	// MemoryStreamBuffer lets an std::istream read bytes that are already in memory without copying them.
+	//
+	// Typical usage: MemoryStreamBuffer buffer(data, size); std::istream stream(&buffer);
+	class MemoryStreamBuffer : public std::streambuf
+	{
+	public:
+		MemoryStreamBuffer(const char* data, size_t size)
+		{
+			char* begin = const_cast<char*>(data);
+			this->setg(begin, begin, begin + size);
+		}
+	};
+}
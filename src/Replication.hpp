@@ -0,0 +1,701 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Entity.hpp"
+#include "Interest.hpp"
+#include "Status.hpp"
+
+namespace babs_ecs
+{
+	// BitWriter packs values of any bit width, least significant bit first.
+	class BitWriter
+	{
+	public:
+		// Writes the low bits of value, bits being 0 to 32.
+		void Write(uint32_t value, unsigned bits)
+		{
+			this->scratch |= (static_cast<uint64_t>(value) & ((uint64_t(1) << bits) - 1)) << this->used;
+			this->used += bits;
+
+			while (this->used >= 8)
+			{
+				this->bytes.push_back(static_cast<uint8_t>(this->scratch));
+				this->scratch >>= 8;
+				this->used -= 8;
+			}
+		}
+
+		// Writes value in groups of 4 bits plus a continuation bit, so small values stay small.
+		void WriteVarint(uint32_t value)
+		{
+			while (value >= 16)
+			{
+				this->Write((value & 15) | 16, 5);
+				value >>= 4;
+			}
+
+			this->Write(value, 5);
+		}
+
+		// Flushes the last partial byte and returns everything written.
+		std::vector<uint8_t> Finish()
+		{
+			if (this->used > 0)
+			{
+				this->bytes.push_back(static_cast<uint8_t>(this->scratch));
+				this->scratch = 0;
+				this->used = 0;
+			}
+
+			return std::move(this->bytes);
+		}
+
+	private:
+		std::vector<uint8_t> bytes;
+		uint64_t scratch = 0;
+		unsigned used = 0;
+	};
+
+	// BitReader reads what a BitWriter wrote. Reading past the end returns zeros and sets Failed().
+	class BitReader
+	{
+	public:
+		BitReader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+		uint32_t Read(unsigned bits)
+		{
+			while (this->used < bits)
+			{
+				if (this->position == this->size)
+				{
+					this->failed = true;
+					return 0;
+				}
+
+				this->scratch |= static_cast<uint64_t>(this->data[this->position++]) << this->used;
+				this->used += 8;
+			}
+
+			uint32_t value = static_cast<uint32_t>(this->scratch & ((uint64_t(1) << bits) - 1));
+			this->scratch >>= bits;
+			this->used -= bits;
+			return value;
+		}
+
+		uint32_t ReadVarint()
+		{
+			uint32_t value = 0;
+			for (unsigned shift = 0; shift < 32; shift += 4)
+			{
+				uint32_t group = this->Read(5);
+				value |= (group & 15) << shift;
+
+				if ((group & 16) == 0)
+				{
+					return value;
+				}
+			}
+
+			this->failed = true;
+			return 0;
+		}
+
+		bool Failed() const
+		{
+			return this->failed;
+		}
+
+	private:
+		const uint8_t* data;
+		size_t size;
+		size_t position = 0;
+		uint64_t scratch = 0;
+		unsigned used = 0;
+		bool failed = false;
+	};
+
+	// ReplicationFrame is the replicated state of a world at one sequence number: for every replicated
+	// component type, the UUIDs holding it in ascending order and their components as 32 bit words.
+	struct ReplicationFrame
+	{
+		struct Components
+		{
+			std::vector<uint32_t> ids;
+			std::vector<uint32_t> words;
+		};
+
+		uint32_t sequence = 0;
+		std::vector<Components> components;
+	};
+
+	// ReplicatedComponent is how the replication classes read and write one component type as words.
+	struct ReplicatedComponent
+	{
+		size_t wordCount;
+		std::function<void(const ECSManager&, ReplicationFrame::Components&)> capture;
+		std::function<void(ECSManager&, Entity, const uint32_t*)> apply;
+		std::function<void(ECSManager&, Entity)> remove;
+
+		template <typename T>
+		static ReplicatedComponent Of()
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "replicated components must be trivially copyable");
+			constexpr size_t wordCount = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+			ReplicatedComponent replicated;
+			replicated.wordCount = wordCount;
+
+			replicated.capture = [](const ECSManager& ecs, ReplicationFrame::Components& state) {
+				std::vector<std::pair<uint32_t, const T*>> owners;
+				ecs.ForEach<T>([&](Entity e, const T& component) { owners.emplace_back(e.UUID, &component); });
+				std::sort(owners.begin(), owners.end(), [](const auto& lhs, const auto& rhs) { return lhs.first < rhs.first; });
+
+				state.ids.resize(owners.size());
+				state.words.assign(owners.size() * wordCount, 0);
+				for (size_t i = 0; i < owners.size(); ++i)
+				{
+					state.ids[i] = owners[i].first;
+					std::memcpy(&state.words[i * wordCount], owners[i].second, sizeof(T));
+				}
+			};
+
+			replicated.apply = [](ECSManager& ecs, Entity entity, const uint32_t* words) {
+				T component;
+				std::memcpy(&component, words, sizeof(T));
+
+				if (T* existing = ecs.GetComponent<T>(entity))
+				{
+					*existing = component;
+				}
+				else
+				{
+					ecs.AddComponent(entity, component);
+				}
+			};
+
+			replicated.remove = [](ECSManager& ecs, Entity entity) {
+				ecs.RemoveComponent<T>(entity);
+			};
+
+			return replicated;
+		}
+	};
+
+	// Writes the changes from baseline to current for one component type. Every entity whose component
+	// was added, removed or changed gets a record: the UUID as the difference to the previous record's,
+	// then either a removal bit or a mask of the changed words followed by each changed word XORed with the
+	// baseline (zero for added components), stored with only its significant bits.
+	inline void EncodeReplicationDelta(BitWriter& writer, const ReplicationFrame::Components& baseline, const ReplicationFrame::Components& current, size_t wordCount)
+	{
+		std::vector<uint32_t> changes(wordCount);
+		uint32_t previousId = 0;
+
+		size_t b = 0;
+		size_t c = 0;
+		while (b < baseline.ids.size() || c < current.ids.size())
+		{
+			bool inBaseline = b < baseline.ids.size() && (c == current.ids.size() || baseline.ids[b] <= current.ids[c]);
+			bool inCurrent = c < current.ids.size() && (b == baseline.ids.size() || current.ids[c] <= baseline.ids[b]);
+			uint32_t entityId = inCurrent ? current.ids[c] : baseline.ids[b];
+
+			if (!inCurrent)
+			{
+				writer.WriteVarint(entityId - previousId);
+				writer.Write(1, 1);
+				previousId = entityId;
+				++b;
+				continue;
+			}
+
+			const uint32_t* after = &current.words[c * wordCount];
+			bool changed = false;
+			for (size_t w = 0; w < wordCount; ++w)
+			{
+				uint32_t before = inBaseline ? baseline.words[b * wordCount + w] : 0;
+				changes[w] = before ^ after[w];
+				changed = changed || changes[w] != 0 || !inBaseline;
+			}
+
+			if (changed)
+			{
+				writer.WriteVarint(entityId - previousId);
+				writer.Write(0, 1);
+				previousId = entityId;
+
+				for (size_t w = 0; w < wordCount; ++w)
+				{
+					writer.Write(changes[w] != 0 ? 1 : 0, 1);
+				}
+
+				for (size_t w = 0; w < wordCount; ++w)
+				{
+					if (changes[w] != 0)
+					{
+						unsigned bits = 32;
+						while ((changes[w] >> (bits - 1)) == 0)
+						{
+							--bits;
+						}
+
+						writer.Write(bits - 1, 5);
+						writer.Write(changes[w], bits);
+					}
+				}
+			}
+
+			b += inBaseline ? 1 : 0;
+			++c;
+		}
+
+		// UUIDs only increase, so a difference of 0 ends the records
+		writer.WriteVarint(0);
+	}
+
+	// Reads what EncodeReplicationDelta wrote, turning baseline into the current state. Returns false for
+	// damaged records.
+	inline bool DecodeReplicationDelta(BitReader& reader, const ReplicationFrame::Components& baseline, ReplicationFrame::Components& current, size_t wordCount)
+	{
+		current.ids.clear();
+		current.words.clear();
+
+		// carries the baseline components nobody changed up to (but not including) this UUID
+		size_t b = 0;
+		auto copyBaselineBelow = [&](uint64_t entityId) {
+			for (; b < baseline.ids.size() && baseline.ids[b] < entityId; ++b)
+			{
+				current.ids.push_back(baseline.ids[b]);
+				current.words.insert(current.words.end(), baseline.words.begin() + b * wordCount, baseline.words.begin() + (b + 1) * wordCount);
+			}
+		};
+
+		uint64_t entityId = 0;
+		for (uint32_t difference = reader.ReadVarint(); difference != 0 && !reader.Failed(); difference = reader.ReadVarint())
+		{
+			entityId += difference;
+			if (entityId > UINT32_MAX)
+			{
+				return false;
+			}
+
+			copyBaselineBelow(entityId);
+			bool inBaseline = b < baseline.ids.size() && baseline.ids[b] == entityId;
+
+			if (reader.Read(1) == 1)
+			{
+				b += inBaseline ? 1 : 0;
+				continue;
+			}
+
+			std::vector<uint32_t> mask(wordCount);
+			for (size_t w = 0; w < wordCount; ++w)
+			{
+				mask[w] = reader.Read(1);
+			}
+
+			current.ids.push_back(static_cast<uint32_t>(entityId));
+			for (size_t w = 0; w < wordCount; ++w)
+			{
+				uint32_t word = inBaseline ? baseline.words[b * wordCount + w] : 0;
+				if (mask[w] != 0)
+				{
+					word ^= reader.Read(reader.Read(5) + 1);
+				}
+
+				current.words.push_back(word);
+			}
+
+			b += inBaseline ? 1 : 0;
+		}
+
+		copyBaselineBelow(uint64_t(UINT32_MAX) + 1);
+		return !reader.Failed();
+	}
+
+	// Replicator encodes the components marked replicated for any number of clients. Every packet is a delta
+	// against the last state its client acknowledged, so only the words that changed since then are sent, and
+	// lost packets are made up for by the next one instead of being resent. Replicated components must be
+	// trivially copyable; disabled entities aren't replicated.
+	//
+	// Typical usage:
+	//   babs_ecs::Replicator replicator(ecs);
+	//   replicator.Replicate<Position>();
+	//   uint32_t client = replicator.AddClient();
+	//   replicator.Capture();                                      // once per network tick
+	//   transport.Send(replicator.WritePacket(client));            // for every client
+	//   replicator.Acknowledge(client, ackFromClient);             // whenever an ack arrives
+	class Replicator
+	{
+	public:
+		// Packets sent to a client but not acknowledged yet are kept as possible baselines up to this many.
+		static constexpr size_t MaxPendingFrames = 64;
+
+		explicit Replicator(const ECSManager& ecs) : ecs(ecs) {}
+
+		// Replicate marks the component type as replicated. Clients must replicate the same types in the same order.
+		template <typename T>
+		void Replicate()
+		{
+			this->replicated.push_back(ReplicatedComponent::Of<T>());
+		}
+
+		uint32_t AddClient()
+		{
+			uint32_t client = this->nextClient++;
+			this->clients[client] = Client{ this->Empty(), {}, nullptr, Entity() };
+			return client;
+		}
+
+		void RemoveClient(uint32_t client)
+		{
+			this->clients.erase(client);
+		}
+
+		// SetInterest limits the client's packets to the entities relevant to the observer, which the interest
+		// manager must keep for as long as the client uses it. Entities that stop being relevant are removed
+		// on the client like entities that lost their components.
+		void SetInterest(uint32_t client, const InterestManager& interest, Entity observer)
+		{
+			Client& state = this->clients.at(client);
+			state.interest = &interest;
+			state.observer = observer;
+		}
+
+		void ClearInterest(uint32_t client)
+		{
+			this->clients.at(client).interest = nullptr;
+		}
+
+		// Capture records the current state of the replicated components as the next sequence, which the
+		// following WritePacket calls send.
+		void Capture()
+		{
+			auto frame = std::make_shared<ReplicationFrame>();
+			frame->sequence = ++this->sequence;
+			frame->components.resize(this->replicated.size());
+
+			for (size_t i = 0; i < this->replicated.size(); ++i)
+			{
+				this->replicated[i].capture(this->ecs, frame->components[i]);
+			}
+
+			this->current = frame;
+		}
+
+		// WritePacket returns the packet bringing the client from its acknowledged state to the last capture.
+		std::vector<uint8_t> WritePacket(uint32_t client)
+		{
+			if (this->current == nullptr)
+			{
+				this->Capture();
+			}
+
+			Client& state = this->clients.at(client);
+			const ReplicationFrame& baseline = *state.baseline;
+
+			// clients with an interest get their own copy of the capture, filtered once per sequence
+			std::shared_ptr<const ReplicationFrame> frame = this->current;
+			if (state.interest != nullptr)
+			{
+				bool filtered = !state.pending.empty() && state.pending.back()->sequence == this->current->sequence;
+				frame = filtered ? state.pending.back() : this->Filter(*state.interest, state.observer);
+			}
+
+			BitWriter writer;
+			writer.Write(frame->sequence, 32);
+			writer.Write(baseline.sequence, 32);
+			writer.Write(static_cast<uint32_t>(this->replicated.size()), 8);
+
+			for (size_t i = 0; i < this->replicated.size(); ++i)
+			{
+				size_t wordCount = this->replicated[i].wordCount;
+				writer.Write(static_cast<uint32_t>(wordCount), 16);
+				EncodeReplicationDelta(writer, i < baseline.components.size() ? baseline.components[i] : ReplicationFrame::Components(), frame->components[i], wordCount);
+			}
+
+			if (state.pending.empty() || state.pending.back()->sequence != frame->sequence)
+			{
+				state.pending.push_back(frame);
+				if (state.pending.size() > MaxPendingFrames)
+				{
+					state.pending.pop_front();
+				}
+			}
+
+			return writer.Finish();
+		}
+
+		// Acknowledge makes the sequence the client confirmed the baseline of its next packets. Older or
+		// unknown sequences are ignored.
+		void Acknowledge(uint32_t client, uint32_t sequence)
+		{
+			Client& state = this->clients.at(client);
+
+			while (!state.pending.empty() && state.pending.front()->sequence <= sequence)
+			{
+				if (state.pending.front()->sequence == sequence)
+				{
+					state.baseline = state.pending.front();
+				}
+
+				state.pending.pop_front();
+			}
+		}
+
+	private:
+		struct Client
+		{
+			std::shared_ptr<const ReplicationFrame> baseline;
+			std::deque<std::shared_ptr<const ReplicationFrame>> pending;
+			const InterestManager* interest = nullptr;
+			Entity observer;
+		};
+
+		// Filter returns the last capture without the entities that aren't relevant to the observer.
+		std::shared_ptr<const ReplicationFrame> Filter(const InterestManager& interest, Entity observer) const
+		{
+			auto frame = std::make_shared<ReplicationFrame>();
+			frame->sequence = this->current->sequence;
+			frame->components.resize(this->replicated.size());
+
+			for (size_t i = 0; i < this->replicated.size(); ++i)
+			{
+				size_t wordCount = this->replicated[i].wordCount;
+				const ReplicationFrame::Components& all = this->current->components[i];
+				ReplicationFrame::Components& relevant = frame->components[i];
+
+				for (size_t j = 0; j < all.ids.size(); ++j)
+				{
+					if (interest.IsRelevant(observer, Entity(all.ids[j])))
+					{
+						relevant.ids.push_back(all.ids[j]);
+						relevant.words.insert(relevant.words.end(), all.words.begin() + j * wordCount, all.words.begin() + (j + 1) * wordCount);
+					}
+				}
+			}
+
+			return frame;
+		}
+
+		std::shared_ptr<const ReplicationFrame> Empty() const
+		{
+			auto empty = std::make_shared<ReplicationFrame>();
+			empty->components.resize(this->replicated.size());
+			return empty;
+		}
+
+		const ECSManager& ecs;
+		std::vector<ReplicatedComponent> replicated;
+		std::unordered_map<uint32_t, Client> clients;
+		std::shared_ptr<const ReplicationFrame> current;
+		uint32_t sequence = 0;
+		uint32_t nextClient = 1;
+	};
+
+	// ReplicaClient applies the packets of a Replicator to a local world. Replicated entities get local
+	// entities of their own, created when their first replicated component arrives and removed along with
+	// the last one. Packets older than the last applied one are ignored.
+	//
+	// Typical usage:
+	//   babs_ecs::ReplicaClient replica(localEcs);
+	//   replica.Replicate<Position>();
+	//   if (auto ack = replica.ReadPacket(packet)) { SendAck(ack.value); }
+	class ReplicaClient
+	{
+	public:
+		static constexpr size_t MaxFrames = Replicator::MaxPendingFrames + 1;
+
+		explicit ReplicaClient(ECSManager& ecs) : ecs(ecs)
+		{
+			this->frames.emplace_back();
+		}
+
+		template <typename T>
+		void Replicate()
+		{
+			this->replicated.push_back(ReplicatedComponent::Of<T>());
+			this->frames.front().components.resize(this->replicated.size());
+		}
+
+		// ReadPacket applies the packet and returns the sequence to acknowledge to the Replicator.
+		Result<uint32_t> ReadPacket(const std::vector<uint8_t>& packet)
+		{
+			BitReader reader(packet.data(), packet.size());
+			uint32_t sequence = reader.Read(32);
+			uint32_t baselineSequence = reader.Read(32);
+			uint32_t componentCount = reader.Read(8);
+
+			if (reader.Failed() || componentCount != this->replicated.size())
+			{
+				return { Status::InvalidSnapshot, 0 };
+			}
+
+			const ReplicationFrame& latest = this->frames.back();
+			if (sequence <= latest.sequence)
+			{
+				return { Status::Ok, latest.sequence };
+			}
+
+			auto baseline = std::find_if(this->frames.begin(), this->frames.end(), [&](const ReplicationFrame& frame) { return frame.sequence == baselineSequence; });
+			if (baseline == this->frames.end())
+			{
+				return { Status::InvalidSnapshot, 0 };
+			}
+
+			ReplicationFrame frame;
+			frame.sequence = sequence;
+			frame.components.resize(componentCount);
+			for (size_t i = 0; i < componentCount; ++i)
+			{
+				size_t wordCount = this->replicated[i].wordCount;
+				if (reader.Read(16) != wordCount || !DecodeReplicationDelta(reader, baseline->components[i], frame.components[i], wordCount))
+				{
+					return { Status::InvalidSnapshot, 0 };
+				}
+			}
+
+			this->Apply(latest, frame);
+
+			// the Replicator never goes back to a baseline older than the one it just used
+			this->frames.erase(this->frames.begin(), baseline);
+			this->frames.push_back(std::move(frame));
+			if (this->frames.size() > MaxFrames)
+			{
+				this->frames.pop_front();
+			}
+
+			return { Status::Ok, sequence };
+		}
+
+		// Returns the local entity standing for the replicated UUID, or the dummy entity if there's none.
+		Entity EntityFor(uint32_t replicatedId) const
+		{
+			auto entity = this->entities.find(replicatedId);
+			return entity != this->entities.end() ? entity->second : Entity();
+		}
+
+	private:
+		// Changes the local world from the state of one frame to the next.
+		void Apply(const ReplicationFrame& from, const ReplicationFrame& to)
+		{
+			std::unordered_set<uint32_t> present;
+
+			for (size_t i = 0; i < this->replicated.size(); ++i)
+			{
+				const ReplicatedComponent& replicated = this->replicated[i];
+				const ReplicationFrame::Components& before = from.components[i];
+				const ReplicationFrame::Components& after = to.components[i];
+				size_t wordCount = replicated.wordCount;
+
+				size_t b = 0;
+				for (size_t a = 0; a < after.ids.size(); ++a)
+				{
+					uint32_t entityId = after.ids[a];
+					present.insert(entityId);
+
+					for (; b < before.ids.size() && before.ids[b] < entityId; ++b)
+					{
+						replicated.remove(this->ecs, this->entities[before.ids[b]]);
+					}
+
+					const uint32_t* words = &after.words[a * wordCount];
+					bool unchanged = b < before.ids.size() && before.ids[b] == entityId
+						&& std::equal(words, words + wordCount, before.words.begin() + b * wordCount);
+
+					if (!unchanged)
+					{
+						replicated.apply(this->ecs, this->LocalEntity(entityId), words);
+					}
+
+					b += b < before.ids.size() && before.ids[b] == entityId ? 1 : 0;
+				}
+
+				for (; b < before.ids.size(); ++b)
+				{
+					replicated.remove(this->ecs, this->entities[before.ids[b]]);
+				}
+			}
+
+			for (auto entity = this->entities.begin(); entity != this->entities.end();)
+			{
+				if (present.count(entity->first) == 0)
+				{
+					this->ecs.RemoveEntity(entity->second);
+					entity = this->entities.erase(entity);
+				}
+				else
+				{
+					++entity;
+				}
+			}
+		}
+
+		Entity LocalEntity(uint32_t replicatedId)
+		{
+			auto entity = this->entities.find(replicatedId);
+			if (entity == this->entities.end())
+			{
+				entity = this->entities.emplace(replicatedId, this->ecs.CreateEntity()).first;
+			}
+
+			return entity->second;
+		}
+
+		ECSManager& ecs;
+		std::vector<ReplicatedComponent> replicated;
+
+		// the frames that can still be the baseline of a packet, oldest first; the last one is applied
+		std::deque<ReplicationFrame> frames;
+
+		// local entity of every replicated UUID
+		std::unordered_map<uint32_t, Entity> entities;
+	};
+
+	// LoopbackTransport carries packets in process, e.g. for tests or a listen server's own client. It can
+	// drop packets to exercise the acknowledgement handling, and counts the bytes sent.
+	class LoopbackTransport
+	{
+	public:
+		// every dropEvery-th packet is lost, 0 keeps them all
+		size_t dropEvery = 0;
+		size_t bytesSent = 0;
+
+		void Send(std::vector<uint8_t> packet)
+		{
+			this->bytesSent += packet.size();
+			if (this->dropEvery != 0 && ++this->sent % this->dropEvery == 0)
+			{
+				return;
+			}
+
+			this->packets.push_back(std::move(packet));
+		}
+
+		// Pops the oldest packet in flight into packet. Returns false if there's none.
+		bool Receive(std::vector<uint8_t>& packet)
+		{
+			if (this->packets.empty())
+			{
+				return false;
+			}
+
+			packet = std::move(this->packets.front());
+			this->packets.pop_front();
+			return true;
+		}
+
+	private:
+		std::deque<std::vector<uint8_t>> packets;
+		size_t sent = 0;
+	};
+}
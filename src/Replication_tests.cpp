@@ -0,0 +1,198 @@
+#include "doctest.h"
+
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Replication.hpp"
+
+struct NetPosition
+{
+	float x;
+	float y;
+	float z;
+};
+
+struct NetScore
+{
+	int32_t kills;
+	int32_t deaths;
+};
+
+// Moves every player a little, like a server tick would.
+static void Simulate(babs_ecs::ECSManager& ecs, int tick)
+{
+	int index = 0;
+	ecs.ForEachGathered<NetPosition>(ecs.EntitiesWith<NetPosition>(), [&](babs_ecs::Entity, NetPosition& position) {
+		if (index++ % 10 == tick % 10)
+		{
+			position.x += 0.25f;
+		}
+	});
+}
+
+// Checks that the client world holds the same replicated components as the server world.
+static void RequireInSync(const babs_ecs::ECSManager& server, const babs_ecs::ECSManager& client, const babs_ecs::ReplicaClient& replica)
+{
+	REQUIRE(client.EntitiesWith<NetPosition>().size() == server.EntitiesWith<NetPosition>().size());
+	REQUIRE(client.EntitiesWith<NetScore>().size() == server.EntitiesWith<NetScore>().size());
+
+	server.ForEach<NetPosition>([&](babs_ecs::Entity e, const NetPosition& position) {
+		const NetPosition* replicated = client.GetComponent<NetPosition>(replica.EntityFor(e.UUID));
+		REQUIRE(replicated != nullptr);
+		REQUIRE(replicated->x == position.x);
+		REQUIRE(replicated->z == position.z);
+	});
+
+	server.ForEach<NetScore>([&](babs_ecs::Entity e, const NetScore& score) {
+		REQUIRE(client.GetComponent<NetScore>(replica.EntityFor(e.UUID))->kills == score.kills);
+	});
+}
+
+TEST_SUITE("Replication")
+{
+	TEST_CASE("Bits and varints read back as written")
+	{
+		babs_ecs::BitWriter writer;
+		writer.Write(5, 3);
+		writer.WriteVarint(0);
+		writer.WriteVarint(300000);
+		writer.Write(0xFFFFFFFF, 32);
+		writer.Write(1, 1);
+		std::vector<uint8_t> bytes = writer.Finish();
+
+		babs_ecs::BitReader reader(bytes.data(), bytes.size());
+		REQUIRE(reader.Read(3) == 5);
+		REQUIRE(reader.ReadVarint() == 0);
+		REQUIRE(reader.ReadVarint() == 300000);
+		REQUIRE(reader.Read(32) == 0xFFFFFFFF);
+		REQUIRE(reader.Read(1) == 1);
+		REQUIRE_FALSE(reader.Failed());
+
+		reader.Read(8);
+		REQUIRE(reader.Failed());
+	}
+
+	TEST_CASE("Clients converge on the server state and packets shrink to the changes")
+	{
+		babs_ecs::ECSManager server;
+		server.RegisterComponent<NetPosition>();
+		server.RegisterComponent<NetScore>();
+
+		for (int i = 0; i < 200; ++i)
+		{
+			babs_ecs::Entity player = server.CreateEntity();
+			server.AddComponents(player, NetPosition{ float(i), 0.0f, 10.0f }, NetScore{ 0, 0 });
+		}
+
+		babs_ecs::ECSManager client;
+		client.RegisterComponent<NetPosition>();
+		client.RegisterComponent<NetScore>();
+
+		babs_ecs::Replicator replicator(server);
+		replicator.Replicate<NetPosition>();
+		replicator.Replicate<NetScore>();
+		uint32_t clientId = replicator.AddClient();
+
+		babs_ecs::ReplicaClient replica(client);
+		replica.Replicate<NetPosition>();
+		replica.Replicate<NetScore>();
+
+		babs_ecs::LoopbackTransport transport;
+		std::vector<uint8_t> packet;
+
+		// the first packet holds everything
+		replicator.Capture();
+		transport.Send(replicator.WritePacket(clientId));
+		size_t fullSize = transport.bytesSent;
+		REQUIRE(fullSize < 200 * (sizeof(NetPosition) + sizeof(NetScore)));
+		REQUIRE(transport.Receive(packet));
+		replicator.Acknowledge(clientId, replica.ReadPacket(packet).value);
+		RequireInSync(server, client, replica);
+
+		// then only a tenth of the players move per tick
+		transport.bytesSent = 0;
+		for (int tick = 0; tick < 10; ++tick)
+		{
+			Simulate(server, tick);
+			replicator.Capture();
+			transport.Send(replicator.WritePacket(clientId));
+
+			REQUIRE(transport.Receive(packet));
+			auto ack = replica.ReadPacket(packet);
+			REQUIRE(ack.Ok());
+			replicator.Acknowledge(clientId, ack.value);
+			RequireInSync(server, client, replica);
+		}
+
+		REQUIRE(transport.bytesSent / 10 < fullSize / 20);
+
+		// removals reach the client too
+		server.RemoveComponent<NetScore>(babs_ecs::Entity(1));
+		server.RemoveEntity(babs_ecs::Entity(2));
+		replicator.Capture();
+		REQUIRE(replica.ReadPacket(replicator.WritePacket(clientId)).Ok());
+		RequireInSync(server, client, replica);
+		REQUIRE(replica.EntityFor(2) == babs_ecs::Entity());
+	}
+
+	TEST_CASE("Lost packets and late acknowledgements are made up for by later packets")
+	{
+		babs_ecs::ECSManager server;
+		server.RegisterComponent<NetPosition>();
+		server.RegisterComponent<NetScore>();
+
+		babs_ecs::ECSManager client;
+		client.RegisterComponent<NetPosition>();
+		client.RegisterComponent<NetScore>();
+
+		babs_ecs::Replicator replicator(server);
+		replicator.Replicate<NetPosition>();
+		replicator.Replicate<NetScore>();
+		uint32_t clientId = replicator.AddClient();
+
+		babs_ecs::ReplicaClient replica(client);
+		replica.Replicate<NetPosition>();
+		replica.Replicate<NetScore>();
+
+		babs_ecs::LoopbackTransport transport;
+		transport.dropEvery = 3;
+
+		std::vector<uint32_t> acks;
+		std::vector<uint8_t> packet;
+		for (int tick = 0; tick < 40; ++tick)
+		{
+			babs_ecs::Entity player = server.CreateEntity();
+			server.AddComponent(player, NetPosition{ float(tick), 1.0f, 2.0f });
+			if (tick % 4 == 0)
+			{
+				server.AddComponent(player, NetScore{ tick, 1 });
+			}
+			if (tick % 5 == 0)
+			{
+				server.RemoveEntity(babs_ecs::Entity(static_cast<uint32_t>(tick / 2 + 1)));
+			}
+			Simulate(server, tick);
+
+			replicator.Capture();
+			transport.Send(replicator.WritePacket(clientId));
+
+			while (transport.Receive(packet))
+			{
+				auto ack = replica.ReadPacket(packet);
+				REQUIRE(ack.Ok());
+				acks.push_back(ack.value);
+			}
+
+			// acknowledgements arrive two ticks late
+			if (acks.size() > 2)
+			{
+				replicator.Acknowledge(clientId, acks[acks.size() - 3]);
+			}
+		}
+
+		transport.dropEvery = 0;
+		replicator.Capture();
+		REQUIRE(replica.ReadPacket(replicator.WritePacket(clientId)).Ok());
+		RequireInSync(server, client, replica);
+	}
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+namespace babs_ecs
+{
+	// Serializer<T> is how snapshots save components that aren't trivially copyable (std::string members,
+	// containers, ...) or whose raw bytes mean nothing in another process (pointers, handles). Trivially
+	// copyable components don't need one: their storage is written as a single block of bytes.
+	//
+	// Typical usage:
+	//   namespace babs_ecs {
+	//   template <> struct Serializer<Identity>
+	//   {
+	//       static void Write(std::ostream& stream, const Identity& identity) { WriteString(stream, identity.name); }
+	//       static void Read(std::istream& stream, Identity& identity) { ReadString(stream, identity.name); }
+	//   };
+	//   }
+	template <typename T, typename Enable = void>
+	struct Serializer {};
+
+	template <typename T, typename = void>
+	struct HasSerializer : std::false_type {};
+
+	template <typename T>
+	struct HasSerializer<T, std::void_t<
+		decltype(Serializer<T>::Write(std::declval<std::ostream&>(), std::declval<const T&>())),
+		decltype(Serializer<T>::Read(std::declval<std::istream&>(), std::declval<T&>()))>> : std::true_type {};
+
+	// A component can be saved if it has a Serializer or, failing that, if its bytes can be copied as they are.
+	template <typename T>
+	struct IsSerializable : std::bool_constant<HasSerializer<T>::value || std::is_trivially_copyable<T>::value> {};
+
+	// HashBytes returns a 64-bit hash of the bytes, different for every seed. It's meant for comparing states
+	// (see ECSManager::StateHash), not for security, and like the rest of this file depends on byte order.
+	inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed)
+	{
+		constexpr uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		uint64_t hash = (seed + size) * multiplier;
+
+		for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), bytes += sizeof(uint64_t))
+		{
+			uint64_t word;
+			std::memcpy(&word, bytes, sizeof(word));
+			hash = (hash ^ word) * multiplier;
+			hash ^= hash >> 29;
+		}
+
+		if (size > 0)
+		{
+			uint64_t word = 0;
+			std::memcpy(&word, bytes, size);
+			hash = (hash ^ word) * multiplier;
+		}
+
+		// the splitmix64 finalizer, so every input bit affects every output bit
+		hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+		hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+		return hash ^ (hash >> 31);
+	}
+
+	// The helpers below read and write values in the native byte order, so a stream can only be read back
+	// on a machine with the same endianness and type sizes.
+
+	template <typename T>
+	inline void WriteArray(std::ostream& stream, const T* values, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "WriteArray needs a trivially copyable type");
+		stream.write(reinterpret_cast<const char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+	}
+
+	template <typename T>
+	inline void ReadArray(std::istream& stream, T* values, size_t count)
+	{
+		static_assert(std::is_trivially_copyable<T>::value, "ReadArray needs a trivially copyable type");
+		stream.read(reinterpret_cast<char*>(values), static_cast<std::streamsize>(count * sizeof(T)));
+	}
+
+	template <typename T>
+	inline void WriteValue(std::ostream& stream, const T& value)
+	{
+		WriteArray(stream, &value, 1);
+	}
+
+	template <typename T>
+	inline void ReadValue(std::istream& stream, T& value)
+	{
+		ReadArray(stream, &value, 1);
+	}
+
+	inline void WriteString(std::ostream& stream, const std::string& value)
+	{
+		WriteValue(stream, static_cast<uint32_t>(value.size()));
+		stream.write(value.data(), static_cast<std::streamsize>(value.size()));
+	}
+
+	// ReadString leaves the stream failed, instead of allocating, if the stored length runs past its end.
+	inline void ReadString(std::istream& stream, std::string& value)
+	{
+		uint32_t size = 0;
+		ReadValue(stream, size);
+
+		value.clear();
+		char buffer[256];
+		while (stream && size > 0)
+		{
+			uint32_t chunk = size < sizeof(buffer) ? size : static_cast<uint32_t>(sizeof(buffer));
+			stream.read(buffer, chunk);
+			value.append(buffer, static_cast<size_t>(stream.gcount()));
+			size -= chunk;
+		}
+	}
+}
@@ -0,0 +1,612 @@
+#include "doctest.h"
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Serialization.hpp"
+
+struct Transform
+{
+	float x;
+	float y;
+};
+
+struct Nametag
+{
+	std::string name;
+};
+
+struct Inventory
+{
+	std::vector<int> items;
+};
+
+namespace babs_ecs
+{
+	template <>
+	struct Serializer<Nametag>
+	{
+		static void Write(std::ostream& stream, const Nametag& nametag)
+		{
+			WriteString(stream, nametag.name);
+		}
+
+		static void Read(std::istream& stream, Nametag& nametag)
+		{
+			ReadString(stream, nametag.name);
+		}
+	};
+}
+
+static_assert(babs_ecs::IsSerializable<Transform>::value, "trivially copyable components are saved as raw bytes");
+static_assert(babs_ecs::HasSerializer<Nametag>::value, "the Serializer specialization is detected");
+static_assert(!babs_ecs::IsSerializable<Inventory>::value, "other components need a Serializer");
+
+// Returns the snapshot of a world with a single Transform.
+static std::string SavedTransforms()
+{
+	babs_ecs::ECSManager ecs;
+	ecs.RegisterComponent<Transform>();
+	ecs.AddComponent(ecs.CreateEntity(), Transform{ 1.0f, 2.0f });
+
+	std::stringstream stream;
+	ecs.SaveSnapshot(stream);
+	return stream.str();
+}
+
+TEST_SUITE("Snapshots")
+{
+	TEST_CASE("A saved world loads back with the same entities and components")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+		ecs.RegisterComponent<Nametag>();
+
+		// enough entities to fill more than one page of Transforms
+		std::vector<babs_ecs::Entity> entities;
+		for (int i = 0; i < 2500; ++i)
+		{
+			babs_ecs::Entity e = ecs.CreateEntity();
+			ecs.AddComponent(e, Transform{ float(i), float(-i) });
+			if (i % 3 == 0)
+			{
+				ecs.AddComponent(e, Nametag{ "entity " + std::to_string(i) });
+			}
+			entities.push_back(e);
+		}
+
+		ecs.RemoveEntity(entities[10]);
+		ecs.RemoveComponent<Transform>(entities[20]);
+		ecs.Disable(entities[30]);
+
+		std::stringstream stream;
+		REQUIRE(ecs.SaveSnapshot(stream) == babs_ecs::Status::Ok);
+
+		babs_ecs::ECSManager loaded;
+		loaded.RegisterComponent<Nametag>();
+		loaded.RegisterComponent<Transform>();
+		REQUIRE(loaded.LoadSnapshot(stream) == babs_ecs::Status::Ok);
+
+		REQUIRE(loaded.EntitiesWith<Transform>().size() == ecs.EntitiesWith<Transform>().size());
+		REQUIRE(loaded.EntitiesWith<Transform, Nametag>().size() == ecs.EntitiesWith<Transform, Nametag>().size());
+
+		REQUIRE(loaded.GetComponent<Transform>(entities[2499])->x == 2499.0f);
+		REQUIRE(loaded.GetComponent<Nametag>(entities[2499])->name == "entity 2499");
+		REQUIRE(loaded.GetComponent<Nametag>(entities[2498]) == nullptr);
+		REQUIRE(loaded.GetComponent<Transform>(entities[20]) == nullptr);
+		REQUIRE(loaded.GetComponent<Nametag>(entities[21])->name == "entity 21");
+		REQUIRE_FALSE(loaded.IsEnabled(entities[30]));
+
+		REQUIRE(loaded.TryGetComponent<Transform>(entities[10]).status == babs_ecs::Status::EntityNotFound);
+
+		// the removed entity's UUID is recycled first, just like in the original world
+		REQUIRE(loaded.CreateEntity().UUID == entities[10].UUID);
+		REQUIRE(loaded.CreateEntity().UUID == entities.back().UUID + 1);
+	}
+
+	TEST_CASE("Components that can't be saved are reported")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Inventory>();
+		ecs.AddComponent(ecs.CreateEntity(), Inventory{ { 1, 2, 3 } });
+
+		std::stringstream stream;
+		REQUIRE(ecs.SaveSnapshot(stream) == babs_ecs::Status::ComponentNotSerializable);
+	}
+
+	TEST_CASE("Loading a snapshot with an unregistered component empties the world")
+	{
+		std::stringstream stream(SavedTransforms());
+
+		babs_ecs::ECSManager loaded;
+		babs_ecs::Entity e = loaded.CreateEntity();
+
+		REQUIRE(loaded.LoadSnapshot(stream) == babs_ecs::Status::InvalidSnapshot);
+		REQUIRE(loaded.TryRemoveEntity(e) == babs_ecs::Status::EntityNotFound);
+	}
+
+	TEST_CASE("Loading a truncated snapshot reports a stream error")
+	{
+		std::string bytes = SavedTransforms();
+		std::stringstream stream(bytes.substr(0, bytes.size() - 3));
+
+		babs_ecs::ECSManager loaded;
+		loaded.RegisterComponent<Transform>();
+
+		REQUIRE(loaded.LoadSnapshot(stream) == babs_ecs::Status::StreamError);
+		REQUIRE(loaded.EntitiesWith().empty());
+	}
+
+	TEST_CASE("Loading something that isn't a snapshot leaves the world untouched")
+	{
+		std::stringstream stream("definitely not a snapshot");
+
+		babs_ecs::ECSManager loaded;
+		babs_ecs::Entity e = loaded.CreateEntity();
+
+		REQUIRE(loaded.LoadSnapshot(stream) == babs_ecs::Status::InvalidSnapshot);
+		REQUIRE(loaded.TryRemoveEntity(e) == babs_ecs::Status::Ok);
+	}
+
+	TEST_CASE("A mapped snapshot is usable in place and can keep changing")
+	{
+		const char* path = "babs_ecs_mapped_snapshot_test.bin";
+
+		{
+			babs_ecs::ECSManager ecs;
+			ecs.RegisterComponent<Transform>();
+			ecs.RegisterComponent<Nametag>();
+
+			for (int i = 0; i < 1500; ++i)
+			{
+				babs_ecs::Entity e = ecs.CreateEntity();
+				ecs.AddComponent(e, Transform{ float(i), 0.0f });
+				if (i % 2 == 0)
+				{
+					ecs.AddComponent(e, Nametag{ "node " + std::to_string(i) });
+				}
+			}
+
+			ecs.RemoveEntity(babs_ecs::Entity(5));
+			ecs.Disable(babs_ecs::Entity(6));
+
+			std::ofstream file(path, std::ios::binary);
+			REQUIRE(ecs.SaveMappedSnapshot(file) == babs_ecs::Status::Ok);
+		}
+
+		{
+			babs_ecs::ECSManager ecs;
+			ecs.RegisterComponent<Transform>();
+			ecs.RegisterComponent<Nametag>();
+			REQUIRE(ecs.MapSnapshot(path) == babs_ecs::Status::Ok);
+
+			REQUIRE(ecs.GetComponent<Transform>(babs_ecs::Entity(1500))->x == 1499.0f);
+			REQUIRE(ecs.GetComponent<Nametag>(babs_ecs::Entity(1))->name == "node 0");
+			REQUIRE(ecs.GetComponent<Transform>(babs_ecs::Entity(5)) == nullptr);
+			REQUIRE_FALSE(ecs.IsEnabled(babs_ecs::Entity(6)));
+			REQUIRE(ecs.EntitiesWith<Transform, Nametag>().size() == 749);
+
+			// writes go to memory only, and new components fill the mapped page before allocating one
+			ecs.GetComponent<Transform>(babs_ecs::Entity(1))->y = 42.0f;
+			REQUIRE(ecs.CreateEntity().UUID == 5);
+			for (int i = 0; i < 600; ++i)
+			{
+				ecs.AddComponent(ecs.CreateEntity(), Transform{ -1.0f, -1.0f });
+			}
+			ecs.RemoveEntity(babs_ecs::Entity(2));
+
+			REQUIRE(ecs.GetComponent<Transform>(babs_ecs::Entity(1))->y == 42.0f);
+			REQUIRE(ecs.GetComponent<Transform>(babs_ecs::Entity(1500))->x == 1499.0f);
+			// entity 6 is disabled
+			REQUIRE(ecs.EntitiesWith<Transform>().size() == 1498 + 600 - 1);
+		}
+
+		{
+			babs_ecs::ECSManager ecs;
+			ecs.RegisterComponent<Transform>();
+			ecs.RegisterComponent<Nametag>();
+			REQUIRE(ecs.MapSnapshot(path) == babs_ecs::Status::Ok);
+			REQUIRE(ecs.GetComponent<Transform>(babs_ecs::Entity(1))->y == 0.0f);
+
+			// a regular snapshot isn't a mapped one
+			std::stringstream stream;
+			REQUIRE(ecs.SaveSnapshot(stream) == babs_ecs::Status::Ok);
+			std::ofstream(path, std::ios::binary) << stream.str();
+
+			REQUIRE(ecs.MapSnapshot(path) == babs_ecs::Status::InvalidSnapshot);
+			REQUIRE(ecs.EntitiesWith<Transform>().size() == 1498);
+		}
+
+		std::remove(path);
+		REQUIRE(babs_ecs::ECSManager().MapSnapshot(path) == babs_ecs::Status::StreamError);
+	}
+
+	TEST_CASE("A mapped snapshot can be taken after removals emptied pages")
+	{
+		const char* path = "babs_ecs_mapped_removals_test.bin";
+
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+		for (int i = 0; i < 2000; ++i)
+		{
+			ecs.AddComponent(ecs.CreateEntity(), Transform{ float(i), 0.0f });
+		}
+
+		// 500 components are left, a page's worth less than the container allocated
+		for (uint32_t uuid = 1; uuid <= 1500; ++uuid)
+		{
+			ecs.RemoveComponent<Transform>(babs_ecs::Entity(uuid));
+		}
+
+		{
+			std::ofstream file(path, std::ios::binary);
+			REQUIRE(ecs.SaveMappedSnapshot(file) == babs_ecs::Status::Ok);
+		}
+
+		babs_ecs::ECSManager mapped;
+		mapped.RegisterComponent<Transform>();
+		REQUIRE(mapped.MapSnapshot(path) == babs_ecs::Status::Ok);
+		REQUIRE(mapped.EntitiesWith<Transform>().size() == 500);
+		REQUIRE(mapped.GetComponent<Transform>(babs_ecs::Entity(1)) == nullptr);
+		REQUIRE(mapped.GetComponent<Transform>(babs_ecs::Entity(1501))->x == 1500.0f);
+		REQUIRE(mapped.GetComponent<Transform>(babs_ecs::Entity(2000))->x == 1999.0f);
+
+		// and after removing every component
+		for (uint32_t uuid = 1501; uuid <= 2000; ++uuid)
+		{
+			ecs.RemoveComponent<Transform>(babs_ecs::Entity(uuid));
+		}
+
+		{
+			std::ofstream file(path, std::ios::binary);
+			REQUIRE(ecs.SaveMappedSnapshot(file) == babs_ecs::Status::Ok);
+		}
+
+		babs_ecs::ECSManager empty;
+		empty.RegisterComponent<Transform>();
+		REQUIRE(empty.MapSnapshot(path) == babs_ecs::Status::Ok);
+		REQUIRE(empty.EntitiesWith<Transform>().empty());
+		REQUIRE(empty.EntitiesWith().size() == 2000);
+
+		empty.AddComponent(babs_ecs::Entity(7), Transform{ 7.0f, 0.0f });
+		REQUIRE(empty.GetComponent<Transform>(babs_ecs::Entity(7))->x == 7.0f);
+
+		std::remove(path);
+	}
+
+	TEST_CASE("A world with the smaller pages of a batch fork maps back the same")
+	{
+		const char* path = "babs_ecs_mapped_batch_test.bin";
+
+		babs_ecs::ECSManager prototype;
+		prototype.RegisterComponent<Transform>();
+		for (int i = 0; i < 100; ++i)
+		{
+			prototype.AddComponent(prototype.CreateEntity(), Transform{ float(i), 0.0f });
+		}
+
+		// 100 components, then 100 more on a second page of 128
+		std::unique_ptr<babs_ecs::ECSManager> world = std::move(prototype.ForkBatch(1)[0]);
+		for (int i = 100; i < 200; ++i)
+		{
+			world->AddComponent(world->CreateEntity(), Transform{ float(i), 1.0f });
+		}
+
+		{
+			std::ofstream file(path, std::ios::binary);
+			REQUIRE(world->SaveMappedSnapshot(file) == babs_ecs::Status::Ok);
+		}
+
+		babs_ecs::ECSManager mapped;
+		mapped.RegisterComponent<Transform>();
+		REQUIRE(mapped.MapSnapshot(path) == babs_ecs::Status::Ok);
+		REQUIRE(mapped.StateHash() == world->StateHash());
+
+		// the rest of the mapped page is there for new components
+		mapped.AddComponent(mapped.CreateEntity(), Transform{ 200.0f, 0.0f });
+		REQUIRE(mapped.GetComponent<Transform>(babs_ecs::Entity(201))->x == 200.0f);
+
+		std::remove(path);
+	}
+
+	TEST_CASE("Deltas carry only the changes since a tick")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+		ecs.RegisterComponent<Nametag>();
+
+		for (int i = 0; i < 100; ++i)
+		{
+			ecs.AddComponent(ecs.CreateEntity(), Transform{ float(i), 0.0f });
+		}
+
+		std::stringstream snapshot;
+		REQUIRE(ecs.SaveSnapshot(snapshot) == babs_ecs::Status::Ok);
+		uint32_t saved = ecs.AdvanceTick();
+		ecs.OpenHistory(saved);
+
+		babs_ecs::ECSManager replica;
+		replica.RegisterComponent<Transform>();
+		replica.RegisterComponent<Nametag>();
+		REQUIRE(replica.LoadSnapshot(snapshot) == babs_ecs::Status::Ok);
+
+		ecs.GetComponent<Transform>(babs_ecs::Entity(1))->y = 5.0f;
+		ecs.AddComponent(babs_ecs::Entity(2), Nametag{ "renamed" });
+		ecs.RemoveComponent<Transform>(babs_ecs::Entity(3));
+		ecs.RemoveEntity(babs_ecs::Entity(4));
+		ecs.Disable(babs_ecs::Entity(5));
+		babs_ecs::Entity recycled = ecs.CreateEntity();
+		ecs.AddComponent(recycled, Nametag{ "recycled" });
+		ecs.AddComponent(ecs.CreateEntity(), Transform{ 101.0f, 0.0f });
+
+		std::stringstream delta;
+		REQUIRE(ecs.WriteDelta(saved, delta) == babs_ecs::Status::Ok);
+
+		// unchanged components aren't part of the delta
+		std::stringstream full;
+		REQUIRE(ecs.SaveSnapshot(full) == babs_ecs::Status::Ok);
+		REQUIRE(delta.str().size() < full.str().size() / 4);
+
+		std::vector<babs_ecs::Entity> entered;
+		replica.OnEnter<Nametag>([&](babs_ecs::Entity e) { entered.push_back(e); });
+		REQUIRE(replica.ApplyDelta(delta) == babs_ecs::Status::Ok);
+
+		REQUIRE(replica.GetComponent<Transform>(babs_ecs::Entity(1))->y == 5.0f);
+		REQUIRE(replica.GetComponent<Nametag>(babs_ecs::Entity(2))->name == "renamed");
+		REQUIRE(replica.GetComponent<Transform>(babs_ecs::Entity(3)) == nullptr);
+		REQUIRE(replica.GetComponent<Transform>(recycled) == nullptr);
+		REQUIRE(replica.GetComponent<Nametag>(recycled)->name == "recycled");
+		REQUIRE_FALSE(replica.IsEnabled(babs_ecs::Entity(5)));
+		REQUIRE(replica.GetComponent<Transform>(babs_ecs::Entity(101))->x == 101.0f);
+		REQUIRE(entered.size() == 2);
+
+		REQUIRE(replica.EntitiesWith<Transform>().size() == ecs.EntitiesWith<Transform>().size());
+		REQUIRE(replica.EntitiesWith<Nametag>().size() == ecs.EntitiesWith<Nametag>().size());
+
+		// both worlds hand out the same UUIDs from here on
+		REQUIRE(replica.CreateEntity().UUID == ecs.CreateEntity().UUID);
+	}
+
+	TEST_CASE("Deltas since the current tick are empty once the tick advanced")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponent(e, Transform{ 1.0f, 1.0f });
+
+		uint32_t next = ecs.AdvanceTick();
+		ecs.GetComponent<Transform>(babs_ecs::Entity(e))->x = 2.0f;
+
+		std::stringstream changed;
+		REQUIRE(ecs.WriteDelta(next, changed) == babs_ecs::Status::Ok);
+
+		// only the mutable getter stamps, reading through a const manager doesn't
+		next = ecs.AdvanceTick();
+		const babs_ecs::ECSManager& reader = ecs;
+		REQUIRE(reader.GetComponent<Transform>(e)->x == 2.0f);
+
+		std::stringstream unchanged;
+		REQUIRE(ecs.WriteDelta(next, unchanged) == babs_ecs::Status::Ok);
+		REQUIRE(unchanged.str().size() < changed.str().size());
+
+		ecs.MarkChanged<Transform>(e);
+		std::stringstream marked;
+		REQUIRE(ecs.WriteDelta(next, marked) == babs_ecs::Status::Ok);
+		REQUIRE(marked.str().size() == changed.str().size());
+	}
+
+	TEST_CASE("Only components handed out for writing count as changed")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+
+		std::vector<babs_ecs::Entity> entities;
+		for (int i = 0; i < 100; ++i)
+		{
+			entities.push_back(ecs.CreateEntity());
+			ecs.AddComponent(entities.back(), Transform{ float(i), 0.0f });
+		}
+
+		auto changedSince = [&ecs](uint32_t tick) {
+			size_t changed = 0;
+			ecs.ForEachChangedSince<Transform>(tick, [&](babs_ecs::Entity) { ++changed; });
+			return changed;
+		};
+
+		// reading systems leave the next delta empty
+		uint32_t next = ecs.AdvanceTick();
+		float sum = 0.0f;
+		ecs.ForEach<Transform>([&](babs_ecs::Entity, const Transform& transform) { sum += transform.x; });
+		ecs.ForEachGathered<Transform>(entities, [&](babs_ecs::Entity, const Transform& transform) { sum += transform.x; });
+		sum += std::as_const(ecs).GetComponent<Transform>(entities[0])->x;
+		REQUIRE(sum == 2 * 4950.0f);
+		REQUIRE(changedSince(next) == 0);
+
+		// the world can't tell a read through a non-const getter from a write
+		sum += ecs.GetComponent<Transform>(entities[1])->x;
+		REQUIRE(changedSince(next) == 1);
+
+		// and a callback taking T& gets every component for writing, whether it writes or not
+		next = ecs.AdvanceTick();
+		ecs.ForEach<Transform>([&](babs_ecs::Entity, Transform& transform) { sum += transform.x; });
+		REQUIRE(changedSince(next) == 100);
+
+		next = ecs.AdvanceTick();
+		ecs.ForEachGathered<Transform>(entities.data(), 10, [&](babs_ecs::Entity, Transform& transform) { transform.y = 1.0f; });
+		REQUIRE(changedSince(next) == 10);
+	}
+
+	TEST_CASE("Discarded history isn't part of later deltas")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+		babs_ecs::HistoryCursor cursor = ecs.OpenHistory(0);
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.RemoveEntity(e);
+
+		std::stringstream before;
+		REQUIRE(ecs.WriteDelta(0, before) == babs_ecs::Status::Ok);
+
+		ecs.MoveHistory(cursor, ecs.AdvanceTick());
+
+		std::stringstream after;
+		REQUIRE(ecs.WriteDelta(0, after) == babs_ecs::Status::Ok);
+		REQUIRE(after.str().size() == before.str().size() - sizeof(uint32_t));
+	}
+
+	TEST_CASE("Removal history stays bounded in a steady state")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+
+		auto churn = [&ecs]() {
+			std::vector<babs_ecs::Entity> created;
+			for (int i = 0; i < 1000; ++i)
+			{
+				created.push_back(ecs.CreateEntity());
+				ecs.AddComponent(created.back(), Transform{ 1.0f, 1.0f });
+			}
+
+			for (size_t i = 0; i < created.size(); ++i)
+			{
+				if (i % 2 == 0)
+				{
+					ecs.RemoveComponent<Transform>(created[i]);
+				}
+				ecs.RemoveEntity(created[i]);
+			}
+		};
+
+		// without a history cursor nothing is remembered
+		for (int round = 0; round < 50; ++round)
+		{
+			churn();
+			ecs.AdvanceTick();
+		}
+		REQUIRE(ecs.HistorySize() == 0);
+
+		// with one, only the removals it hasn't moved past yet
+		babs_ecs::HistoryCursor cursor = ecs.OpenHistory(ecs.CurrentTick());
+		for (int round = 0; round < 50; ++round)
+		{
+			churn();
+			REQUIRE(ecs.HistorySize() == 1500);
+			ecs.MoveHistory(cursor, ecs.AdvanceTick());
+		}
+		REQUIRE(ecs.HistorySize() == 0);
+
+		// forks start without history, and closing the last cursor drops it
+		churn();
+		REQUIRE(ecs.Fork()->HistorySize() == 0);
+		ecs.CloseHistory(cursor);
+		REQUIRE(ecs.HistorySize() == 0);
+	}
+
+	TEST_CASE("Discarding history keeps what open cursors still need")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+		babs_ecs::HistoryCursor slow = ecs.OpenHistory(0);
+		babs_ecs::HistoryCursor fast = ecs.OpenHistory(0);
+
+		ecs.RemoveEntity(ecs.CreateEntity());
+		uint32_t next = ecs.AdvanceTick();
+		ecs.RemoveEntity(ecs.CreateEntity());
+
+		ecs.MoveHistory(fast, next + 1);
+		ecs.DiscardHistory(next + 1);
+		REQUIRE(ecs.HistorySize() == 2);
+
+		ecs.MoveHistory(slow, next);
+		REQUIRE(ecs.HistorySize() == 1);
+
+		ecs.CloseHistory(slow);
+		REQUIRE(ecs.HistorySize() == 0);
+		ecs.CloseHistory(fast);
+	}
+
+	TEST_CASE("With a history cursor open, changes since a tick come from the log")
+	{
+		babs_ecs::ECSManager ecs;
+		ecs.RegisterComponent<Transform>();
+		ecs.RegisterComponent<Nametag>();
+
+		std::vector<babs_ecs::Entity> entities;
+		for (int i = 0; i < 1000; ++i)
+		{
+			entities.push_back(ecs.CreateEntity());
+			ecs.AddComponent(entities.back(), Transform{ float(i), 0.0f });
+		}
+
+		auto changedSince = [&ecs](uint32_t tick) {
+			std::set<uint32_t> changed;
+			ecs.ForEachChangedSince<Transform>(tick, [&](babs_ecs::Entity e) { changed.insert(e.UUID); });
+			return changed;
+		};
+
+		babs_ecs::HistoryCursor cursor = ecs.OpenHistory(ecs.CurrentTick());
+		for (uint32_t round = 0; round < 5; ++round)
+		{
+			uint32_t next = ecs.AdvanceTick();
+			std::set<uint32_t> expected;
+
+			// threads writing to different entities log each component once
+			std::vector<std::thread> threads;
+			for (uint32_t thread = 0; thread < 4; ++thread)
+			{
+				threads.emplace_back([&, thread]() {
+					for (size_t i = thread; i < 400; i += 4)
+					{
+						ecs.GetComponent<Transform>(entities[i])->y += 1.0f;
+						ecs.GetComponent<Transform>(entities[i])->y += 1.0f;
+					}
+				});
+			}
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+			for (size_t i = 0; i < 400; ++i)
+			{
+				expected.insert(entities[i].UUID);
+			}
+
+			babs_ecs::Entity created = ecs.CreateEntity();
+			ecs.AddComponent(created, Transform{ 0.0f, 0.0f });
+			entities.push_back(created);
+			expected.insert(created.UUID);
+
+			ecs.RemoveEntity(entities[500 + round]);
+			expected.insert(entities[500 + round].UUID);
+
+			ecs.RemoveComponent<Transform>(entities[600 + round]);
+			expected.insert(entities[600 + round].UUID);
+
+			ecs.Disable(entities[700 + round]);
+			expected.insert(entities[700 + round].UUID);
+
+			// changes to components that aren't asked about don't come up
+			ecs.AddComponent(entities[800 + round], Nametag{});
+
+			REQUIRE(changedSince(next) == expected);
+			ecs.MoveHistory(cursor, next);
+		}
+
+		// a rollback isn't logged, so the world is scanned for the ticks it covers
+		babs_ecs::FrameHandle frame = ecs.CaptureFrame();
+		ecs.GetComponent<Transform>(entities[999])->x = -1.0f;
+		REQUIRE(ecs.Restore(frame) == babs_ecs::Status::Ok);
+		REQUIRE(changedSince(ecs.CurrentTick()).size() >= ecs.EntitiesWith<Transform>().size());
+
+		ecs.CloseHistory(cursor);
+		REQUIRE(changedSince(ecs.CurrentTick()).size() >= ecs.EntitiesWith<Transform>().size());
+	}
+}
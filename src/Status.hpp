@@ -0,0 +1,59 @@
+#pragma once
+
+namespace babs_ecs
+{
+	// Status is what the Try* functions of ECSManager report instead of throwing.
+	enum class Status
+	{
+		Ok,
+		EntityNotFound,
+		ComponentNotRegistered,
+		ComponentNotFound,
+		ComponentLimitReached,
+		ComponentNotSerializable,
+		InvalidSnapshot,
+		StreamError,
+		FrameExpired,
+		ReservationsPending,
+	};
+
+	// Returns a short, static description of the status that's safe to log from anywhere.
+	inline const char* ToString(Status status)
+	{
+		switch (status)
+		{
+		case Status::Ok: return "ok";
+		case Status::EntityNotFound: return "entity was not found";
+		case Status::ComponentNotRegistered: return "component must be registered before being used";
+		case Status::ComponentNotFound: return "entity doesn't have the component";
+		case Status::ComponentLimitReached: return "exceeded available flags for the bitfield";
+		case Status::ComponentNotSerializable: return "component isn't trivially copyable and has no Serializer";
+		case Status::InvalidSnapshot: return "snapshot is corrupt or doesn't match the registered components";
+		case Status::StreamError: return "failed to read or write the stream";
+		case Status::FrameExpired: return "frame was overwritten by later captures";
+		case Status::ReservationsPending: return "reserved entities must be flushed first";
+		}
+
+		return "unknown status";
+	}
+
+	// Result pairs a Status with the value produced when the status is Ok.
+	//
+	// Typical usage: if (auto health = ecs.TryGetComponent<Health>(e)) { health.value->current--; }
+	template <typename T>
+	struct Result
+	{
+		Status status;
+		T value;
+
+		bool Ok() const
+		{
+			return this->status == Status::Ok;
+		}
+
+		explicit operator bool() const
+		{
+			return this->Ok();
+		}
+	};
+}
@@ -0,0 +1,211 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "Entity.hpp"
+
+namespace babs_ecs
+{
+	// WorldBatch runs many small, independent worlds side by side, e.g. the environments of a reinforcement
+	// learning run. The worlds are copies of a prototype world made with ECSManager::ForkBatch, so creating
+	// one doesn't register components or rebuild entities, and the components of each type live in one
+	// allocation for the whole batch, with a slice per world sized to the prototype's pool instead of a page
+	// of 1024 components per world and type. Resetting a world copies the prototype back into its slices.
+	// Systems run over every world in one call, spread over a pool of threads the batch starts once and
+	// keeps for its lifetime.
+	//
+	// The prototype must outlive the batch, must not change while worlds are created or reset, and must not
+	// register components after the batch is created.
+	//
+	// Typical usage:
+	//   babs_ecs::WorldBatch batch(prototype, 4096);
+	//   batch.ParallelForEach<Velocity>([](size_t world, babs_ecs::Entity e, Velocity& velocity) { ... });
+	//   if (Done(batch.World(i))) { batch.Reset(i); }
+	class WorldBatch
+	{
+	public:
+		// WorldBatch makes count worlds and starts threadCount - 1 worker threads (0 for one thread per core),
+		// the calling thread being the last one.
+		WorldBatch(ECSManager& prototype, size_t count, size_t threadCount = 0) : prototype(prototype)
+		{
+			this->worlds = prototype.ForkBatch(count);
+
+			if (threadCount == 0)
+			{
+				threadCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+			}
+
+			threadCount = std::min(threadCount, std::max<size_t>(1, count));
+			for (size_t i = 1; i < threadCount; ++i)
+			{
+				this->workers.emplace_back([this]() { this->Work(); });
+			}
+		}
+
+		WorldBatch(const WorldBatch&) = delete;
+		WorldBatch& operator=(const WorldBatch&) = delete;
+
+		~WorldBatch()
+		{
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->stopping = true;
+			}
+
+			this->wake.notify_all();
+			for (std::thread& worker : this->workers)
+			{
+				worker.join();
+			}
+		}
+
+		size_t Size() const
+		{
+			return this->worlds.size();
+		}
+
+		ECSManager& World(size_t index)
+		{
+			return *this->worlds[index];
+		}
+
+		const ECSManager& World(size_t index) const
+		{
+			return *this->worlds[index];
+		}
+
+		// Reset puts the world back in the state of the prototype, see ECSManager::CopyFrom. Its tick, handlers
+		// and history cursors are kept, and the entities reserved in it are flushed first.
+		void Reset(size_t index)
+		{
+			this->worlds[index]->FlushReservedEntities();
+			this->worlds[index]->CopyFrom(this->prototype);
+		}
+
+		// ForEach calls func(world, entity, component) for every enabled entity with the component, world
+		// after world, walking each world's storage like ECSManager::ForEach.
+		template <typename T, typename Func>
+		void ForEach(Func&& func)
+		{
+			for (size_t world = 0; world < this->worlds.size(); ++world)
+			{
+				this->worlds[world]->template ForEach<T>([&](Entity entity, T& component) { func(world, entity, component); });
+			}
+		}
+
+		// ParallelForEach is ForEach with the worlds split among the batch's threads. Each world is only used
+		// by one thread, so func can change anything in the world it's given, but it must not throw or touch
+		// other worlds.
+		template <typename T, typename Func>
+		void ParallelForEach(Func&& func)
+		{
+			this->ParallelForEachWorld([&](size_t world, ECSManager& ecs) {
+				ecs.template ForEach<T>([&](Entity entity, T& component) { func(world, entity, component); });
+			});
+		}
+
+		// ParallelForEachWorld calls func(index, world) for every world, split among the batch's threads, for
+		// systems that need more than one component type. It returns once every world is done, and must not
+		// be called from func.
+		template <typename Func>
+		void ParallelForEachWorld(Func&& func)
+		{
+			std::function<void(size_t)> job = [this, &func](size_t world) { func(world, *this->worlds[world]); };
+
+			if (this->workers.empty())
+			{
+				for (size_t world = 0; world < this->worlds.size(); ++world)
+				{
+					job(world);
+				}
+
+				return;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->job = &job;
+				this->next = 0;
+				this->busy = this->workers.size();
+				++this->generation;
+			}
+
+			this->wake.notify_all();
+			this->Run(job);
+
+			std::unique_lock<std::mutex> lock(this->mutex);
+			this->idle.wait(lock, [this]() { return this->busy == 0; });
+			this->job = nullptr;
+		}
+
+	private:
+		// Takes contiguous chunks of worlds until there are none left, so threads that finish early help out
+		// with the rest instead of waiting.
+		void Run(const std::function<void(size_t)>& job)
+		{
+			size_t count = this->worlds.size();
+			size_t chunk = std::max<size_t>(1, count / ((this->workers.size() + 1) * 8));
+
+			for (size_t first = this->next.fetch_add(chunk); first < count; first = this->next.fetch_add(chunk))
+			{
+				size_t last = std::min(first + chunk, count);
+				for (size_t world = first; world < last; ++world)
+				{
+					job(world);
+				}
+			}
+		}
+
+		// The worker threads: wait for the next job, run it alongside the calling thread, report back.
+		void Work()
+		{
+			uint64_t done = 0;
+			std::unique_lock<std::mutex> lock(this->mutex);
+			while (true)
+			{
+				this->wake.wait(lock, [this, done]() { return this->stopping || this->generation != done; });
+
+				if (this->stopping)
+				{
+					return;
+				}
+
+				done = this->generation;
+				const std::function<void(size_t)>* current = this->job;
+				lock.unlock();
+
+				this->Run(*current);
+
+				lock.lock();
+				if (--this->busy == 0)
+				{
+					this->idle.notify_one();
+				}
+			}
+		}
+
+		ECSManager& prototype;
+		std::vector<std::unique_ptr<ECSManager>> worlds;
+
+		// everything below is shared with the worker threads
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable idle;
+		const std::function<void(size_t)>* job = nullptr;
+		uint64_t generation = 0;
+		size_t busy = 0;
+		std::atomic<size_t> next{ 0 };
+		bool stopping = false;
+	};
+}
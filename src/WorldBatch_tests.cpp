@@ -0,0 +1,156 @@
+#include "doctest.h"
+
+#include <algorithm>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ECSManager.hpp"
+#include "WorldBatch.hpp"
+
+struct Agent
+{
+	float x;
+	float speed;
+};
+
+struct Reward
+{
+	float total;
+};
+
+// Builds the starting state of every environment: a few agents collecting rewards.
+static void BuildEnvironment(babs_ecs::ECSManager& ecs)
+{
+	ecs.RegisterComponent<Agent>();
+	ecs.RegisterComponent<Reward>();
+
+	for (int i = 0; i < 200; ++i)
+	{
+		babs_ecs::Entity e = ecs.CreateEntity();
+		ecs.AddComponents(e, Agent{ 0.0f, static_cast<float>(i % 7) }, Reward{ 0.0f });
+	}
+}
+
+// One step of an environment: agents move by their speed, which differs per world, and collect rewards.
+static void StepEnvironment(size_t world, babs_ecs::ECSManager& ecs)
+{
+	ecs.ForEach<Agent>([&](babs_ecs::Entity e, Agent& agent) {
+		agent.x += agent.speed + static_cast<float>(world % 3);
+		ecs.GetComponent<Reward>(e)->total += agent.x > 10.0f ? 1.0f : 0.0f;
+	});
+}
+
+TEST_SUITE("WorldBatch")
+{
+	TEST_CASE("Systems step every world of the batch independently")
+	{
+		babs_ecs::ECSManager prototype;
+		BuildEnvironment(prototype);
+		uint64_t initial = prototype.StateHash();
+
+		babs_ecs::WorldBatch batch(prototype, 64, 4);
+		babs_ecs::WorldBatch sequential(prototype, 64, 1);
+		REQUIRE(batch.Size() == 64);
+
+		for (int step = 0; step < 10; ++step)
+		{
+			batch.ParallelForEachWorld(StepEnvironment);
+			for (size_t world = 0; world < sequential.Size(); ++world)
+			{
+				StepEnvironment(world, sequential.World(world));
+			}
+		}
+
+		batch.ParallelForEach<Reward>([](size_t world, babs_ecs::Entity, Reward& reward) { reward.total *= static_cast<float>(world); });
+		sequential.ForEach<Reward>([](size_t world, babs_ecs::Entity, Reward& reward) { reward.total *= static_cast<float>(world); });
+
+		for (size_t world = 0; world < batch.Size(); ++world)
+		{
+			REQUIRE(batch.World(world).StateHash() == sequential.World(world).StateHash());
+		}
+
+		// worlds with different speeds end up in different states, the prototype isn't touched
+		REQUIRE(batch.World(0).StateHash() != batch.World(1).StateHash());
+		REQUIRE(prototype.StateHash() == initial);
+	}
+
+	TEST_CASE("Reset starts a world over from the prototype")
+	{
+		babs_ecs::ECSManager prototype;
+		BuildEnvironment(prototype);
+
+		babs_ecs::WorldBatch batch(prototype, 8);
+		batch.ParallelForEachWorld(StepEnvironment);
+		batch.World(5).RemoveEntity(babs_ecs::Entity(1));
+
+		batch.Reset(5);
+		REQUIRE(batch.World(5).StateHash() == prototype.StateHash());
+		REQUIRE(batch.World(4).StateHash() != prototype.StateHash());
+		REQUIRE(batch.World(5).EntitiesWith<Agent, Reward>().size() == 200);
+	}
+
+	TEST_CASE("The worlds of a batch keep using the slices they started with")
+	{
+		babs_ecs::ECSManager prototype;
+		BuildEnvironment(prototype);
+
+		// 200 agents per world take slices of 256 agents, one after the other
+		babs_ecs::WorldBatch batch(prototype, 16, 4);
+		const Agent* start = std::as_const(batch.World(0)).GetComponent<Agent>(babs_ecs::Entity(1));
+		for (size_t world = 0; world < batch.Size(); ++world)
+		{
+			REQUIRE(std::as_const(batch.World(world)).GetComponent<Agent>(babs_ecs::Entity(1)) == start + 256 * world);
+		}
+
+		for (int step = 0; step < 5; ++step)
+		{
+			batch.ParallelForEachWorld(StepEnvironment);
+		}
+
+		// stepping and resetting write in place
+		batch.World(7).AddComponents(batch.World(7).CreateEntity(), Agent{ 0.0f, 1.0f }, Reward{ 0.0f });
+		batch.Reset(7);
+		REQUIRE(batch.World(7).StateHash() == prototype.StateHash());
+		for (size_t world = 0; world < batch.Size(); ++world)
+		{
+			REQUIRE(batch.World(world).GetComponent<Agent>(babs_ecs::Entity(1)) == start + 256 * world);
+		}
+	}
+
+	TEST_CASE("Every call runs on the same pool of threads")
+	{
+		babs_ecs::ECSManager prototype;
+		BuildEnvironment(prototype);
+
+		std::mutex mutex;
+		std::set<std::thread::id> threads;
+		std::vector<int> steps(256, 0);
+		auto step = [&](size_t world, babs_ecs::ECSManager& ecs) {
+			StepEnvironment(world, ecs);
+			steps[world]++;
+
+			std::lock_guard<std::mutex> lock(mutex);
+			threads.insert(std::this_thread::get_id());
+		};
+
+		{
+			babs_ecs::WorldBatch batch(prototype, 256, 4);
+			for (int call = 0; call < 50; ++call)
+			{
+				batch.ParallelForEachWorld(step);
+			}
+		}
+
+		REQUIRE(threads.size() <= 4);
+		REQUIRE(std::all_of(steps.begin(), steps.end(), [](int count) { return count == 50; }));
+
+		// a single thread is the calling one
+		threads.clear();
+		babs_ecs::WorldBatch single(prototype, 8, 1);
+		single.ParallelForEachWorld(step);
+		REQUIRE(threads == std::set<std::thread::id>{ std::this_thread::get_id() });
+	}
+}
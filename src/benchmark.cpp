@@ -1,97 +1,431 @@
-#include <chrono>
+#include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <string>
-#include <iomanip>
+#include <vector>
 
 #include "ECS.hpp"
+#include "benchmark/Harness.hpp"
+#include "benchmark/Report.hpp"
 
-class Timer {
-public:
-	std::chrono::milliseconds elapsed;
-	std::chrono::high_resolution_clock::time_point start;
+struct Identity
+{
+	int uuid;
+};
+
+struct Tag {};
+
+struct Position
+{
+	float x;
+	float y;
+};
+
+struct Velocity
+{
+	float x;
+	float y;
+};
+
+struct Health
+{
+	int32_t points;
+};
+
+struct Hit
+{
+	babs_ecs::Entity entity;
+	int32_t damage;
+};
+
+static void RegisterComponents(babs_ecs::ECSManager& ecs)
+{
+	ecs.RegisterComponent<Identity>();
+	ecs.RegisterComponent<Tag>();
+	ecs.RegisterComponent<Position>();
+	ecs.RegisterComponent<Velocity>();
+	ecs.RegisterComponent<Health>();
+}
 
-	Timer() : elapsed(std::chrono::milliseconds(0))
+static std::vector<babs_ecs::Entity> CreateEntities(babs_ecs::ECSManager& ecs, size_t count)
+{
+	std::vector<babs_ecs::Entity> entities;
+	entities.reserve(count);
+	for (size_t i = 0; i < count; ++i)
 	{
-		this->start = std::chrono::high_resolution_clock::now();
+		entities.push_back(ecs.CreateEntity());
 	}
-	
-	void End()
+
+	return entities;
+}
+
+// Entities with a Position, every one in velocityEvery of them with a Velocity as well.
+static std::vector<babs_ecs::Entity> CreateMovers(babs_ecs::ECSManager& ecs, size_t count, size_t velocityEvery)
+{
+	std::vector<babs_ecs::Entity> entities = CreateEntities(ecs, count);
+	for (size_t i = 0; i < count; ++i)
 	{
-		this->elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - start);
+		ecs.AddComponent(entities[i], Position{ static_cast<float>(i), 0.0f });
+		if (i % velocityEvery == 0)
+		{
+			ecs.AddComponent(entities[i], Velocity{ 1.0f, 2.0f });
+		}
 	}
-};
 
-void printHeader()
+	return entities;
+}
+
+static void AddStructuralBenchmarks(benchmark::Suite& suite, size_t count)
 {
-	std::cout << "|-------------------------------------------------------------------------------------------------------- |" << std::endl;
-	std::cout << "|Name" << "\t\t\t" << "Entities" << "\t" << "Iterations" << "\t\t" << "Probability" << "\t" << "Duration(ms)\t\t  |" << std::endl;
-	std::cout << "|-------------------------------------------------------------------------------------------------------- |" << std::endl;
+	suite.Add("CreateEntity", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		m.Time([&]() {
+			for (size_t i = 0; i < entities; ++i)
+			{
+				benchmark::DoNotOptimize(ecs.CreateEntity());
+			}
+		});
+	});
+
+	suite.Add("RemoveEntity", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		std::vector<babs_ecs::Entity> created = CreateMovers(ecs, entities, 2);
+		m.Time([&]() {
+			for (babs_ecs::Entity e : created)
+			{
+				ecs.RemoveEntity(e);
+			}
+		});
+	});
 
+	suite.Add("AddComponent", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		std::vector<babs_ecs::Entity> created = CreateEntities(ecs, entities);
+		m.Time([&]() {
+			for (babs_ecs::Entity e : created)
+			{
+				ecs.AddComponent(e, Position{ 1.0f, 2.0f });
+			}
+		});
+	});
+
+	suite.Add("AddComponents<Position, Velocity, Health>", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		std::vector<babs_ecs::Entity> created = CreateEntities(ecs, entities);
+		m.Time([&]() {
+			for (babs_ecs::Entity e : created)
+			{
+				ecs.AddComponents(e, Position{ 1.0f, 2.0f }, Velocity{ 3.0f, 4.0f }, Health{ 100 });
+			}
+		});
+	});
+
+	suite.Add("RemoveComponent", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		std::vector<babs_ecs::Entity> created = CreateMovers(ecs, entities, 1);
+		m.Time([&]() {
+			for (babs_ecs::Entity e : created)
+			{
+				ecs.RemoveComponent<Velocity>(e);
+			}
+		});
+	});
 }
 
-void printResults(std::string name, int entities, int iterations, int probability, std::chrono::milliseconds duration)
+static void AddAccessBenchmarks(benchmark::Suite& suite, size_t count)
 {
-	std::cout << "|" << name << "\t\t" << entities << "\t\t" << iterations << "\t\t\t" << "1/" <<probability << "\t\t\t" << duration.count() << "\t\t  |" << std::endl;
+	suite.Add("GetComponent (shuffled)", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		std::vector<babs_ecs::Entity> created = CreateMovers(ecs, entities, 1);
+		std::shuffle(created.begin(), created.end(), std::mt19937(42));
+		m.Time([&]() {
+			float sum = 0.0f;
+			for (babs_ecs::Entity e : created)
+			{
+				sum += ecs.GetComponent<Position>(e)->x;
+			}
+			benchmark::DoNotOptimize(sum);
+		});
+	});
+
+	suite.Add("GetComponents<Position, Velocity>", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		std::vector<babs_ecs::Entity> created = CreateMovers(ecs, entities, 1);
+		m.Time([&]() {
+			for (babs_ecs::Entity e : created)
+			{
+				auto [position, velocity] = ecs.GetComponents<Position, Velocity>(e);
+				position->x += velocity->x;
+			}
+		});
+	});
 }
 
-void printFooter()
+// For queries and iteration, an operation is one entity scanned.
+static void AddQueryBenchmarks(benchmark::Suite& suite, size_t count)
 {
-	std::cout << "|-------------------------------------------------------------------------------------------------------- |" << std::endl;
+	size_t passes = benchmark::Passes(count);
+
+	suite.Add("EntitiesWith<Position>", count, count * passes, [passes](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		CreateMovers(ecs, entities, 2);
+		m.Time([&]() {
+			for (size_t pass = 0; pass < passes; ++pass)
+			{
+				benchmark::DoNotOptimize(ecs.EntitiesWith<Position>().size());
+			}
+		});
+	});
+
+	suite.Add("EntitiesWith<Position, Velocity> 1/2", count, count * passes, [passes](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		CreateMovers(ecs, entities, 2);
+		m.Time([&]() {
+			for (size_t pass = 0; pass < passes; ++pass)
+			{
+				benchmark::DoNotOptimize(ecs.EntitiesWith<Position, Velocity>().size());
+			}
+		});
+	});
+
+	// the scenario the benchmark always had, Identity on every entity and a Tag on 1/3 or 1/1000 of them
+	for (size_t tagEvery : { 3, 1'000 })
+	{
+		std::string name = "EntitiesWith<Identity, Tag> 1/" + std::to_string(tagEvery);
+		suite.Add(name, count, count * passes, [passes, tagEvery](benchmark::Measurement& m, size_t entities) {
+			babs_ecs::ECSManager ecs;
+			RegisterComponents(ecs);
+			for (size_t i = 0; i < entities; ++i)
+			{
+				babs_ecs::Entity e = ecs.CreateEntity();
+				ecs.AddComponent(e, Identity{ static_cast<int>(i) });
+				if (i % tagEvery == 0)
+				{
+					ecs.AddComponent(e, Tag{});
+				}
+			}
+
+			m.Time([&]() {
+				for (size_t pass = 0; pass < passes; ++pass)
+				{
+					benchmark::DoNotOptimize(ecs.EntitiesWith<Identity, Tag>().size());
+				}
+			});
+		});
+	}
+
+	suite.Add("ForEach<Position> update", count, count * passes, [passes](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		CreateMovers(ecs, entities, 2);
+		m.Time([&]() {
+			for (size_t pass = 0; pass < passes; ++pass)
+			{
+				ecs.ForEach<Position>([](babs_ecs::Entity, Position& position) { position.x += 1.0f; });
+			}
+		});
+	});
+
+	suite.Add("EntitiesWith + GetComponents update 1/2", count, count * passes, [passes](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		CreateMovers(ecs, entities, 2);
+		m.Time([&]() {
+			for (size_t pass = 0; pass < passes; ++pass)
+			{
+				for (babs_ecs::Entity e : ecs.EntitiesWith<Position, Velocity>())
+				{
+					auto [position, velocity] = ecs.GetComponents<Position, Velocity>(e);
+					position->x += velocity->x;
+					position->y += velocity->y;
+				}
+			}
+		});
+	});
+
+	suite.Add("EntitiesWith + Gather update 1/2", count, count * passes, [passes](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		CreateMovers(ecs, entities, 2);
+		std::vector<Position*> positions;
+		std::vector<Velocity*> velocities;
+		m.Time([&]() {
+			for (size_t pass = 0; pass < passes; ++pass)
+			{
+				std::vector<babs_ecs::Entity> matched = ecs.EntitiesWith<Position, Velocity>();
+				positions.resize(matched.size());
+				velocities.resize(matched.size());
+				ecs.Gather(matched, positions.data());
+				ecs.Gather(matched, velocities.data());
+
+				for (size_t i = 0; i < matched.size(); ++i)
+				{
+					positions[i]->x += velocities[i]->x;
+					positions[i]->y += velocities[i]->y;
+				}
+			}
+		});
+	});
 }
 
-struct Identity
+static void AddEventBenchmarks(benchmark::Suite& suite, size_t count)
 {
-	int uuid;
-};
+	suite.Add("Broadcast (1 subscriber)", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		int64_t damage = 0;
+		ecs.events.Subscribe<Hit>([&](const Hit& hit) { damage += hit.damage; });
+		m.Time([&]() {
+			for (size_t i = 0; i < entities; ++i)
+			{
+				ecs.events.Broadcast(Hit{ babs_ecs::Entity(static_cast<uint32_t>(i)), 1 });
+			}
+		});
+		benchmark::DoNotOptimize(damage);
+	});
 
-struct Tag {};
+	suite.Add("Broadcast (no subscriber)", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		m.Time([&]() {
+			for (size_t i = 0; i < entities; ++i)
+			{
+				ecs.events.Broadcast(Hit{ babs_ecs::Entity(static_cast<uint32_t>(i)), 1 });
+			}
+		});
+	});
+}
 
-void babsEcsTest(int entityCount, int iterationCount, int tagProb)
+// Churn is a world in steady state: every operation removes a random entity and creates a replacement,
+// which reuses the freed slot.
+static void AddChurnBenchmarks(benchmark::Suite& suite, size_t count)
 {
-	babs_ecs::ECSManager ecs;
-	ecs.RegisterComponent<Identity>();
-	ecs.RegisterComponent<Tag>();
+	suite.Add("Churn (remove + create + add 2)", count, count, [](benchmark::Measurement& m, size_t entities) {
+		babs_ecs::ECSManager ecs;
+		RegisterComponents(ecs);
+		std::vector<babs_ecs::Entity> alive = CreateMovers(ecs, entities, 1);
+		std::mt19937 random(7);
+		m.Time([&]() {
+			for (size_t i = 0; i < entities; ++i)
+			{
+				size_t index = random() % alive.size();
+				ecs.RemoveEntity(alive[index]);
 
-	{
-		Timer timer;
-		for (int i = 0; i < entityCount; ++i) {
-			auto entity = ecs.CreateEntity();
-			ecs.AddComponent(entity, Identity{ i });
+				alive[index] = ecs.CreateEntity();
+				ecs.AddComponents(alive[index], Position{ 0.0f, 0.0f }, Velocity{ 1.0f, 1.0f });
+			}
+		});
+	});
+}
+
+// Many small worlds side by side, as in WorldBatch: count entities spread over worlds of 200 each, made with
+// a Fork per world or with one ForkBatch. Making them includes their first step, which is when forks copy the
+// pages they write to, so the bytes per world are what each world ends up holding.
+static void AddWorldBatchBenchmarks(benchmark::Suite& suite, size_t count)
+{
+	constexpr size_t WorldEntities = 200;
+	size_t worldCount = count / WorldEntities;
 
-			if (i % tagProb == 0)
+	auto makePrototype = [](babs_ecs::ECSManager& prototype) {
+		RegisterComponents(prototype);
+		CreateMovers(prototype, WorldEntities, 2);
+	};
+
+	auto step = [](std::vector<std::unique_ptr<babs_ecs::ECSManager>>& worlds) {
+		for (auto& world : worlds)
+		{
+			world->ForEach<Position>([](babs_ecs::Entity, Position& position) { position.x += 1.0f; });
+		}
+	};
+
+	suite.Add("Worlds made by Fork + first step", count, worldCount, [=](benchmark::Measurement& m, size_t) {
+		babs_ecs::ECSManager prototype;
+		makePrototype(prototype);
+		std::vector<std::unique_ptr<babs_ecs::ECSManager>> worlds;
+		m.Time([&]() {
+			for (size_t i = 0; i < worldCount; ++i)
 			{
-				ecs.AddComponent(entity, Tag{});
+				worlds.push_back(prototype.Fork());
 			}
+			step(worlds);
+		});
+	});
+
+	suite.Add("Worlds made by ForkBatch + first step", count, worldCount, [=](benchmark::Measurement& m, size_t) {
+		babs_ecs::ECSManager prototype;
+		makePrototype(prototype);
+		std::vector<std::unique_ptr<babs_ecs::ECSManager>> worlds;
+		m.Time([&]() {
+			worlds = prototype.ForkBatch(worldCount);
+			step(worlds);
+		});
+	});
+
+	constexpr size_t passes = 10;
+
+	suite.Add("Step worlds made by Fork", count, count * passes, [=](benchmark::Measurement& m, size_t) {
+		babs_ecs::ECSManager prototype;
+		makePrototype(prototype);
+		std::vector<std::unique_ptr<babs_ecs::ECSManager>> worlds;
+		for (size_t i = 0; i < worldCount; ++i)
+		{
+			worlds.push_back(prototype.Fork());
 		}
+		step(worlds);
+		m.Time([&]() {
+			for (size_t pass = 0; pass < passes; ++pass)
+			{
+				step(worlds);
+			}
+		});
+	});
+
+	suite.Add("Step worlds made by ForkBatch", count, count * passes, [=](benchmark::Measurement& m, size_t) {
+		babs_ecs::ECSManager prototype;
+		makePrototype(prototype);
+		std::vector<std::unique_ptr<babs_ecs::ECSManager>> worlds = prototype.ForkBatch(worldCount);
+		step(worlds);
+		m.Time([&]() {
+			for (size_t pass = 0; pass < passes; ++pass)
+			{
+				step(worlds);
+			}
+		});
+	});
+}
+
+int main(int argc, char** argv)
+{
+	benchmark::Options options;
+	if (!benchmark::ParseOptions(argc, argv, options, std::cerr))
+	{
+		return 1;
 	}
+
+	benchmark::Suite suite;
+	for (size_t count : { 10'000, 100'000 })
 	{
-		Timer timer;
-
-        std::uint64_t sum = 0;
-        for (int i = 0; i < iterationCount; ++i) {
-            auto entities = ecs.EntitiesWith<Identity, Tag>();
-            for (auto entity : entities)
-            {
-                sum++;
-            }
-        }
-        timer.End();
-        printResults("Identity + Tag", entityCount, iterationCount, tagProb, timer.elapsed);
+		AddStructuralBenchmarks(suite, count);
+		AddAccessBenchmarks(suite, count);
+		AddQueryBenchmarks(suite, count);
+		AddEventBenchmarks(suite, count);
+		AddChurnBenchmarks(suite, count);
+		AddWorldBatchBenchmarks(suite, count);
 	}
-}
 
-void runTest(int entityCount, int iterationCount, int tagProb) {
-	babsEcsTest(entityCount, iterationCount, tagProb);
-}
+	std::cout << "Running benchmark (" << options.warmup << " warmup runs, " << options.repetitions << " measured runs each)..." << std::endl << std::endl;
+
+	benchmark::Table table(std::cout);
+	std::vector<benchmark::Result> results = suite.Run(options, [&](const benchmark::Result& result) { table.Print(result); });
 
-int main() {
-	std::cout << "Running benchmark..." << std::endl << std::endl;
-	printHeader();
-	runTest(1'000, 100'000, 3);
-	runTest(10'000, 100'000, 3);
-	runTest(30'000, 10'000, 3);
-	runTest(100'000, 10'000, 5);
-	runTest(10'000, 100'000, 1'000);
-	runTest(100'000, 100'000, 1'000);
-	printFooter();
-}
\ No newline at end of file
+	return benchmark::Save(options, results, std::cerr) ? 0 : 1;
+}
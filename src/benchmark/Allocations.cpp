@@ -0,0 +1,134 @@
+// Replaces the global operator new and delete to count every heap allocation of the benchmark binaries,
+// the library's included (see Allocations.hpp). Only the count is added, the memory still comes from malloc.
+
+#include <cstdlib>
+#include <new>
+
+#include "Allocations.hpp"
+
+namespace
+{
+	void* Allocate(std::size_t size)
+	{
+		benchmark::CountAllocation(size);
+		void* memory = std::malloc(size == 0 ? 1 : size);
+		if (memory == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		return memory;
+	}
+
+	void* AllocateAligned(std::size_t size, std::align_val_t alignment)
+	{
+		benchmark::CountAllocation(size);
+		std::size_t align = static_cast<std::size_t>(alignment);
+#ifdef _WIN32
+		void* memory = _aligned_malloc(size == 0 ? 1 : size, align);
+#else
+		// aligned_alloc wants a multiple of the alignment
+		std::size_t rounded = size == 0 ? align : (size + align - 1) / align * align;
+		void* memory = std::aligned_alloc(align, rounded);
+#endif
+		if (memory == nullptr)
+		{
+			throw std::bad_alloc();
+		}
+
+		return memory;
+	}
+
+	void FreeAligned(void* memory)
+	{
+#ifdef _WIN32
+		_aligned_free(memory);
+#else
+		std::free(memory);
+#endif
+	}
+}
+
+void* operator new(std::size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return Allocate(size);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	try
+	{
+		return Allocate(size);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return nullptr;
+	}
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return AllocateAligned(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+	return AllocateAligned(size, alignment);
+}
+
+void operator delete(void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
+
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept
+{
+	FreeAligned(memory);
+}
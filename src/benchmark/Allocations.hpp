@@ -0,0 +1,29 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+namespace benchmark
+{
+	// Heap allocations made so far by the process, counted by the global operator new replacements in
+	// Allocations.cpp. Binaries that don't link Allocations.cpp always see zeros.
+	struct AllocationCount
+	{
+		size_t allocations;
+		size_t bytes;
+	};
+
+	inline std::atomic<size_t> allocationCount{ 0 };
+	inline std::atomic<size_t> allocatedBytes{ 0 };
+
+	inline void CountAllocation(size_t size)
+	{
+		allocationCount.fetch_add(1, std::memory_order_relaxed);
+		allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	inline AllocationCount Allocations()
+	{
+		return AllocationCount{ allocationCount.load(std::memory_order_relaxed), allocatedBytes.load(std::memory_order_relaxed) };
+	}
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace benchmark
+{
+	enum Counter
+	{
+		Cycles,
+		Instructions,
+		L1DataMisses,
+		LastLevelMisses,
+		BranchMisses,
+		CounterCount,
+	};
+
+	// the names the counters are written under, per operation
+	inline const char* CounterName(size_t counter)
+	{
+		static const char* names[CounterCount] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses" };
+		return names[counter];
+	}
+
+	// Counter values, NaN for the counters that couldn't be read.
+	using CounterValues = std::array<double, CounterCount>;
+
+	inline CounterValues NoCounters()
+	{
+		CounterValues values;
+		values.fill(std::numeric_limits<double>::quiet_NaN());
+		return values;
+	}
+
+	// HardwareCounters counts CPU cycles, instructions, L1 data cache read misses, last level cache misses and
+	// branch misses of the calling thread with Linux perf events, all in one group so they cover exactly the
+	// same work. Counters the CPU, the kernel (see /proc/sys/kernel/perf_event_paranoid) or a virtual machine
+	// doesn't offer are left out, and elsewhere than on Linux nothing is counted.
+	class HardwareCounters
+	{
+	public:
+		HardwareCounters()
+		{
+			this->descriptors.fill(-1);
+#ifdef __linux__
+			static const std::array<std::pair<uint32_t, uint64_t>, CounterCount> events = { {
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+				{ PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+				{ PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES },
+			} };
+
+			for (size_t counter = 0; counter < CounterCount; ++counter)
+			{
+				perf_event_attr attributes;
+				std::memset(&attributes, 0, sizeof(attributes));
+				attributes.size = sizeof(attributes);
+				attributes.type = events[counter].first;
+				attributes.config = events[counter].second;
+				attributes.disabled = this->leader == -1 ? 1 : 0;
+				attributes.exclude_kernel = 1;
+				attributes.exclude_hv = 1;
+				attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+				int descriptor = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, this->leader, 0));
+				if (descriptor == -1)
+				{
+					continue;
+				}
+
+				this->descriptors[counter] = descriptor;
+				if (this->leader == -1)
+				{
+					this->leader = descriptor;
+				}
+			}
+#endif
+		}
+
+		HardwareCounters(const HardwareCounters&) = delete;
+		HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+		~HardwareCounters()
+		{
+#ifdef __linux__
+			for (int descriptor : this->descriptors)
+			{
+				if (descriptor != -1)
+				{
+					close(descriptor);
+				}
+			}
+#endif
+		}
+
+		bool Available() const
+		{
+			return this->leader != -1;
+		}
+
+		void Start()
+		{
+#ifdef __linux__
+			if (this->leader != -1)
+			{
+				ioctl(this->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+				ioctl(this->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+			}
+#endif
+		}
+
+		// Stop adds what was counted since Start to totals, turning the counters that didn't count into NaN.
+		void Stop(CounterValues& totals)
+		{
+#ifdef __linux__
+			if (this->leader != -1)
+			{
+				ioctl(this->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+			}
+
+			for (size_t counter = 0; counter < CounterCount; ++counter)
+			{
+				// value, time enabled, time running
+				uint64_t values[3] = { 0, 0, 0 };
+				if (this->descriptors[counter] == -1 || read(this->descriptors[counter], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)) || values[2] == 0)
+				{
+					totals[counter] = std::numeric_limits<double>::quiet_NaN();
+					continue;
+				}
+
+				// scaled up in case the group had to share the PMU with other groups
+				totals[counter] += static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+			}
+#else
+			totals = NoCounters();
+#endif
+		}
+
+	private:
+		std::array<int, CounterCount> descriptors;
+		int leader = -1;
+	};
+}
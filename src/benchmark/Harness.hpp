@@ -0,0 +1,389 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Allocations.hpp"
+#include "Counters.hpp"
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace benchmark
+{
+	using Clock = std::chrono::steady_clock;
+
+	// CurrentRss returns the resident set size of the process in bytes, or 0 where it isn't known.
+	inline size_t CurrentRss()
+	{
+#ifdef __linux__
+		std::ifstream statm("/proc/self/statm");
+		size_t size = 0;
+		size_t resident = 0;
+		if (statm >> size >> resident)
+		{
+			return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+		}
+#endif
+		return 0;
+	}
+
+	// DoNotOptimize keeps the compiler from dropping the computation of value as unused.
+	template <typename T>
+	inline void DoNotOptimize(const T& value)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		asm volatile("" : : "r,m"(value) : "memory");
+#else
+		static volatile const void* sink;
+		sink = &value;
+#endif
+	}
+
+	// Passes is how many times to walk a world of the given size so a run scans about a million entities,
+	// which keeps runs over small worlds long enough to time.
+	inline size_t Passes(size_t entities)
+	{
+		return std::max<size_t>(1, 1'000'000 / std::max<size_t>(1, entities));
+	}
+
+	// Measurement is handed to every run of a benchmark. The run builds whatever it needs, then times the
+	// work itself with Time, so setup and teardown aren't measured. The heap allocations made by the timed
+	// work are counted too (see Allocations.hpp), as well as the hardware counters where there are some (see
+	// Counters.hpp), and the resident set size is sampled right after it, while the run's world is still alive.
+	//
+	// Typical usage:
+	//   suite.Add("RemoveEntity", 10'000, 10'000, [](benchmark::Measurement& m, size_t entities) {
+	//       babs_ecs::ECSManager ecs;
+	//       ... create the entities ...
+	//       m.Time([&]() { ... remove them ... });
+	//   });
+	class Measurement
+	{
+	public:
+		explicit Measurement(HardwareCounters* counters = nullptr) : counters(counters)
+		{
+			this->counted.fill(0.0);
+		}
+
+		template <typename Func>
+		void Time(Func&& func)
+		{
+			AllocationCount before = Allocations();
+			if (this->counters != nullptr)
+			{
+				this->counters->Start();
+			}
+
+			Clock::time_point start = Clock::now();
+			func();
+			this->elapsed += Clock::now() - start;
+
+			if (this->counters != nullptr)
+			{
+				this->counters->Stop(this->counted);
+			}
+			AllocationCount after = Allocations();
+
+			this->allocations += after.allocations - before.allocations;
+			this->bytes += after.bytes - before.bytes;
+			this->rss = std::max(this->rss, CurrentRss());
+		}
+
+		Clock::duration Elapsed() const
+		{
+			return this->elapsed;
+		}
+
+		size_t AllocationsMade() const
+		{
+			return this->allocations;
+		}
+
+		size_t BytesAllocated() const
+		{
+			return this->bytes;
+		}
+
+		size_t Rss() const
+		{
+			return this->rss;
+		}
+
+		CounterValues Counted() const
+		{
+			return this->counters != nullptr && this->counters->Available() ? this->counted : NoCounters();
+		}
+
+	private:
+		HardwareCounters* counters;
+		CounterValues counted;
+		Clock::duration elapsed = Clock::duration::zero();
+		size_t allocations = 0;
+		size_t bytes = 0;
+		size_t rss = 0;
+	};
+
+	struct Benchmark
+	{
+		std::string name;
+		size_t entities;
+		// how many operations one run times, the results are per operation
+		size_t operations;
+		std::function<void(Measurement&, size_t)> run;
+	};
+
+	struct Result
+	{
+		std::string name;
+		size_t entities;
+		size_t operations;
+		// nanoseconds per operation of every measured run
+		std::vector<double> samples;
+		double mean;
+		double stddev;
+		double min;
+		double median;
+		// heap allocations and bytes allocated per operation, averaged over the measured runs
+		double allocations;
+		double bytes;
+		// the largest resident set size seen by the measured runs, in bytes
+		size_t rss;
+		// hardware counters per operation, averaged over the measured runs, NaN where they aren't available
+		CounterValues counters;
+	};
+
+	struct Options
+	{
+		size_t warmup = 2;
+		size_t repetitions = 10;
+		// only benchmarks whose name contains filter run
+		std::string filter;
+		// where to write the results as JSON and as CSV, if anywhere
+		std::string json;
+		std::string csv;
+	};
+
+	// ParseOptions reads --warmup N, --repetitions N, --filter TEXT, --json PATH and --csv PATH, printing the
+	// usage to errors and returning false on anything else.
+	inline bool ParseOptions(int argc, char** argv, Options& options, std::ostream& errors)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::string arg = argv[i];
+			bool hasValue = i + 1 < argc;
+
+			if (arg == "--warmup" && hasValue)
+			{
+				options.warmup = std::strtoul(argv[++i], nullptr, 10);
+			}
+			else if (arg == "--repetitions" && hasValue)
+			{
+				options.repetitions = std::max<size_t>(1, std::strtoul(argv[++i], nullptr, 10));
+			}
+			else if (arg == "--filter" && hasValue)
+			{
+				options.filter = argv[++i];
+			}
+			else if (arg == "--json" && hasValue)
+			{
+				options.json = argv[++i];
+			}
+			else if (arg == "--csv" && hasValue)
+			{
+				options.csv = argv[++i];
+			}
+			else
+			{
+				errors << "usage: " << argv[0] << " [--warmup N] [--repetitions N] [--filter TEXT] [--json PATH] [--csv PATH]" << std::endl;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Suite holds the registered benchmarks and runs them: every benchmark runs warmup times unmeasured, then
+	// repetitions times measured, each run starting from a fresh setup.
+	class Suite
+	{
+	public:
+		void Add(std::string name, size_t entities, size_t operations, std::function<void(Measurement&, size_t)> run)
+		{
+			this->benchmarks.push_back(Benchmark{ std::move(name), entities, std::max<size_t>(1, operations), std::move(run) });
+		}
+
+		// Run calls onResult as each benchmark finishes, so long suites show progress, and returns every result.
+		std::vector<Result> Run(const Options& options, const std::function<void(const Result&)>& onResult) const
+		{
+			std::vector<Result> results;
+			HardwareCounters counters;
+			for (const Benchmark& benchmark : this->benchmarks)
+			{
+				if (benchmark.name.find(options.filter) == std::string::npos)
+				{
+					continue;
+				}
+
+				for (size_t i = 0; i < options.warmup; ++i)
+				{
+					Measurement measurement;
+					benchmark.run(measurement, benchmark.entities);
+				}
+
+				Result result{ benchmark.name, benchmark.entities, benchmark.operations, {}, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, {} };
+				for (size_t i = 0; i < options.repetitions; ++i)
+				{
+					Measurement measurement(&counters);
+					benchmark.run(measurement, benchmark.entities);
+
+					double nanoseconds = std::chrono::duration<double, std::nano>(measurement.Elapsed()).count();
+					result.samples.push_back(nanoseconds / static_cast<double>(benchmark.operations));
+					result.allocations += static_cast<double>(measurement.AllocationsMade()) / static_cast<double>(benchmark.operations * options.repetitions);
+					result.bytes += static_cast<double>(measurement.BytesAllocated()) / static_cast<double>(benchmark.operations * options.repetitions);
+					result.rss = std::max(result.rss, measurement.Rss());
+
+					CounterValues counted = measurement.Counted();
+					for (size_t counter = 0; counter < CounterCount; ++counter)
+					{
+						result.counters[counter] += counted[counter] / static_cast<double>(benchmark.operations * options.repetitions);
+					}
+				}
+
+				Summarize(result);
+				onResult(result);
+				results.push_back(std::move(result));
+			}
+
+			return results;
+		}
+
+	private:
+		static void Summarize(Result& result)
+		{
+			std::vector<double> sorted = result.samples;
+			std::sort(sorted.begin(), sorted.end());
+
+			double sum = 0.0;
+			for (double sample : sorted)
+			{
+				sum += sample;
+			}
+
+			result.mean = sum / static_cast<double>(sorted.size());
+			result.min = sorted.front();
+			result.median = sorted.size() % 2 == 1 ? sorted[sorted.size() / 2] : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2.0;
+
+			double squares = 0.0;
+			for (double sample : sorted)
+			{
+				squares += (sample - result.mean) * (sample - result.mean);
+			}
+
+			result.stddev = sorted.size() > 1 ? std::sqrt(squares / static_cast<double>(sorted.size() - 1)) : 0.0;
+		}
+
+		std::vector<Benchmark> benchmarks;
+	};
+
+	// Table prints results as an aligned table, a row at a time. The hardware counter columns (cycles and
+	// misses per operation, instructions per cycle) are only there when the first result has counters.
+	class Table
+	{
+	public:
+		explicit Table(std::ostream& out) : out(out) {}
+
+		void Print(const Result& result)
+		{
+			if (!this->started)
+			{
+				this->started = true;
+				for (double counted : result.counters)
+				{
+					this->withCounters = this->withCounters || !std::isnan(counted);
+				}
+
+				this->Header();
+			}
+
+			double relative = result.mean > 0.0 ? 100.0 * result.stddev / result.mean : 0.0;
+			std::vector<std::string> cells = { std::to_string(result.entities), std::to_string(result.operations),
+				Format(result.mean), Format(relative) + "%", Format(result.min), Format(result.median),
+				Format(result.allocations), Format(result.bytes) };
+
+			if (this->withCounters)
+			{
+				double cycles = result.counters[Cycles];
+				cells.push_back(Format(cycles > 0.0 ? result.counters[Instructions] / cycles : std::numeric_limits<double>::quiet_NaN()));
+				for (Counter counter : { Cycles, L1DataMisses, LastLevelMisses, BranchMisses })
+				{
+					cells.push_back(Format(result.counters[counter]));
+				}
+			}
+
+			this->Row(result.name, cells);
+		}
+
+	private:
+		static constexpr int NameWidth = 52;
+		static constexpr int NumberWidth = 12;
+
+		// three significant digits below 1, so rare allocations or very cheap operations don't show as 0, and
+		// "-" for anything that isn't a number
+		static std::string Format(double value)
+		{
+			std::ostringstream stream;
+			if (!std::isfinite(value))
+			{
+				stream << "-";
+			}
+			else if (value < 1.0)
+			{
+				stream << std::setprecision(3) << value;
+			}
+			else
+			{
+				stream << std::fixed << std::setprecision(value < 100.0 ? 2 : 0) << value;
+			}
+			return stream.str();
+		}
+
+		void Header() const
+		{
+			std::vector<std::string> cells = { "Entities", "Ops", "ns/op", "+/-", "Min", "Median", "Allocs/op", "B/op" };
+			if (this->withCounters)
+			{
+				cells.insert(cells.end(), { "IPC", "Cycles/op", "L1D miss/op", "LLC miss/op", "Br miss/op" });
+			}
+
+			this->Row("Name", cells);
+			this->out << std::string(NameWidth + cells.size() * NumberWidth, '-') << std::endl;
+		}
+
+		void Row(const std::string& name, const std::vector<std::string>& cells) const
+		{
+			this->out << std::left << std::setw(NameWidth) << name << std::right;
+			for (const std::string& cell : cells)
+			{
+				this->out << std::setw(NumberWidth) << cell;
+			}
+			this->out << std::endl;
+		}
+
+		std::ostream& out;
+		bool started = false;
+		bool withCounters = false;
+	};
+}
@@ -0,0 +1,576 @@
+#pragma once
+
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Harness.hpp"
+
+namespace benchmark
+{
+	// The results are written as JSON:
+	//   { "benchmarks": [ { "name": "CreateEntity", "entities": 10000, "operations": 10000, "repetitions": 10,
+	//       "ns_per_op": 61.2, "stddev": 1.4, "min": 60.1, "median": 61.0, "allocs_per_op": 0.01,
+	//       "bytes_per_op": 1.6, "rss_bytes": 4378624, "cycles_per_op": 180.2, "instructions_per_op": 410.7,
+	//       "l1d_misses_per_op": 0.9, "llc_misses_per_op": 0.1, "branch_misses_per_op": 0.01, "ipc": 2.28 }, ... ] }
+	// or as CSV with one row per benchmark and the same fields as columns. ns_per_op is the mean, rss_bytes is 0
+	// where the platform doesn't tell and the hardware counters are null (empty in CSV) where they can't be read.
+
+	inline std::string JsonEscape(const std::string& text)
+	{
+		std::string escaped;
+		for (char c : text)
+		{
+			if (c == '"' || c == '\\')
+			{
+				escaped += '\\';
+			}
+			escaped += c;
+		}
+
+		return escaped;
+	}
+
+	inline std::string CsvEscape(const std::string& text)
+	{
+		if (text.find_first_of(",\"\n") == std::string::npos)
+		{
+			return text;
+		}
+
+		std::string escaped = "\"";
+		for (char c : text)
+		{
+			escaped += c;
+			if (c == '"')
+			{
+				escaped += '"';
+			}
+		}
+
+		return escaped + "\"";
+	}
+
+	// InstructionsPerCycle is NaN, not infinite, when no cycles were counted.
+	inline double InstructionsPerCycle(const Result& result)
+	{
+		double cycles = result.counters[Cycles];
+		return cycles > 0.0 ? result.counters[Instructions] / cycles : std::numeric_limits<double>::quiet_NaN();
+	}
+
+	// Numbers are written with every digit, NaN and infinities as missing, the format's own "no value", since
+	// neither JSON nor a spreadsheet reads them back.
+	inline std::string FormatNumber(double value, const char* missing)
+	{
+		if (!std::isfinite(value))
+		{
+			return missing;
+		}
+
+		std::ostringstream stream;
+		stream << std::setprecision(std::numeric_limits<double>::max_digits10) << value;
+		return stream.str();
+	}
+
+	inline void WriteJson(const std::vector<Result>& results, std::ostream& out)
+	{
+		out << std::setprecision(std::numeric_limits<double>::max_digits10);
+		out << "{\n  \"benchmarks\": [";
+		for (size_t i = 0; i < results.size(); ++i)
+		{
+			const Result& result = results[i];
+			out << (i == 0 ? "\n" : ",\n")
+				<< "    { \"name\": \"" << JsonEscape(result.name) << "\""
+				<< ", \"entities\": " << result.entities
+				<< ", \"operations\": " << result.operations
+				<< ", \"repetitions\": " << result.samples.size()
+				<< ", \"ns_per_op\": " << FormatNumber(result.mean, "null")
+				<< ", \"stddev\": " << FormatNumber(result.stddev, "null")
+				<< ", \"min\": " << FormatNumber(result.min, "null")
+				<< ", \"median\": " << FormatNumber(result.median, "null")
+				<< ", \"allocs_per_op\": " << FormatNumber(result.allocations, "null")
+				<< ", \"bytes_per_op\": " << FormatNumber(result.bytes, "null")
+				<< ", \"rss_bytes\": " << result.rss;
+
+			for (size_t counter = 0; counter < CounterCount; ++counter)
+			{
+				out << ", \"" << CounterName(counter) << "_per_op\": " << FormatNumber(result.counters[counter], "null");
+			}
+			out << ", \"ipc\": " << FormatNumber(InstructionsPerCycle(result), "null") << " }";
+		}
+		out << "\n  ]\n}\n";
+	}
+
+	inline void WriteCsv(const std::vector<Result>& results, std::ostream& out)
+	{
+		out << std::setprecision(std::numeric_limits<double>::max_digits10);
+		out << "name,entities,operations,repetitions,ns_per_op,stddev,min,median,allocs_per_op,bytes_per_op,rss_bytes";
+		for (size_t counter = 0; counter < CounterCount; ++counter)
+		{
+			out << ',' << CounterName(counter) << "_per_op";
+		}
+		out << ",ipc\n";
+
+		for (const Result& result : results)
+		{
+			out << CsvEscape(result.name) << ',' << result.entities << ',' << result.operations << ','
+				<< result.samples.size();
+
+			for (double value : { result.mean, result.stddev, result.min, result.median, result.allocations, result.bytes })
+			{
+				out << ',' << FormatNumber(value, "");
+			}
+			out << ',' << result.rss;
+
+			for (size_t counter = 0; counter < CounterCount; ++counter)
+			{
+				out << ',' << FormatNumber(result.counters[counter], "");
+			}
+			out << ',' << FormatNumber(InstructionsPerCycle(result), "") << '\n';
+		}
+	}
+
+	// Save writes the results to the files named in options, returning false if one couldn't be written.
+	inline bool Save(const Options& options, const std::vector<Result>& results, std::ostream& errors)
+	{
+		bool saved = true;
+		if (!options.json.empty())
+		{
+			std::ofstream file(options.json);
+			WriteJson(results, file);
+			if (!file)
+			{
+				errors << "failed to write " << options.json << std::endl;
+				saved = false;
+			}
+		}
+
+		if (!options.csv.empty())
+		{
+			std::ofstream file(options.csv);
+			WriteCsv(results, file);
+			if (!file)
+			{
+				errors << "failed to write " << options.csv << std::endl;
+				saved = false;
+			}
+		}
+
+		return saved;
+	}
+
+	// ResultReader reads the results back from either format, which is told apart by the first character.
+	// Unknown fields are skipped, so files written by newer versions still compare.
+	class ResultReader
+	{
+	public:
+		static bool Read(const std::string& path, std::vector<Result>& results, std::ostream& errors)
+		{
+			std::ifstream file(path, std::ios::binary);
+			if (!file)
+			{
+				errors << "failed to open " << path << std::endl;
+				return false;
+			}
+
+			std::string text((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			ResultReader reader(std::move(text));
+			reader.SkipSpace();
+			bool read = reader.Peek() == '{' ? reader.ReadJson(results) : reader.ReadCsv(results);
+			if (!read)
+			{
+				errors << path << " isn't a benchmark result file (error near byte " << reader.position << ")" << std::endl;
+			}
+
+			return read;
+		}
+
+	private:
+		explicit ResultReader(std::string text) : text(std::move(text)) {}
+
+		using Fields = std::vector<std::pair<std::string, std::string>>;
+
+		char Peek() const
+		{
+			return this->position < this->text.size() ? this->text[this->position] : '\0';
+		}
+
+		void SkipSpace()
+		{
+			while (this->position < this->text.size() && std::isspace(static_cast<unsigned char>(this->text[this->position])))
+			{
+				++this->position;
+			}
+		}
+
+		bool Expect(char c)
+		{
+			this->SkipSpace();
+			if (this->Peek() != c)
+			{
+				return false;
+			}
+
+			++this->position;
+			return true;
+		}
+
+		bool ReadString(std::string& value)
+		{
+			if (!this->Expect('"'))
+			{
+				return false;
+			}
+
+			value.clear();
+			while (this->position < this->text.size() && this->text[this->position] != '"')
+			{
+				if (this->text[this->position] == '\\')
+				{
+					++this->position;
+				}
+
+				if (this->position < this->text.size())
+				{
+					value += this->text[this->position++];
+				}
+			}
+
+			return this->Expect('"');
+		}
+
+		// Reads any JSON value, keeping strings and numbers as their text and skipping arrays and objects.
+		bool ReadValue(std::string& value)
+		{
+			this->SkipSpace();
+			char c = this->Peek();
+			if (c == '"')
+			{
+				return this->ReadString(value);
+			}
+
+			if (c == '{' || c == '[')
+			{
+				int depth = 0;
+				do
+				{
+					std::string ignored;
+					if (this->Peek() == '"' && !this->ReadString(ignored))
+					{
+						return false;
+					}
+
+					c = this->Peek();
+					depth += (c == '{' || c == '[') ? 1 : ((c == '}' || c == ']') ? -1 : 0);
+					++this->position;
+				} while (depth > 0 && this->position < this->text.size());
+
+				value.clear();
+				return depth == 0;
+			}
+
+			size_t start = this->position;
+			while (this->position < this->text.size() && std::string(",}] \t\r\n").find(this->text[this->position]) == std::string::npos)
+			{
+				++this->position;
+			}
+
+			value = this->text.substr(start, this->position - start);
+			return !value.empty();
+		}
+
+		bool ReadObject(Fields& fields)
+		{
+			if (!this->Expect('{'))
+			{
+				return false;
+			}
+
+			if (this->Expect('}'))
+			{
+				return true;
+			}
+
+			do
+			{
+				std::string key;
+				std::string value;
+				if (!this->ReadString(key) || !this->Expect(':') || !this->ReadValue(value))
+				{
+					return false;
+				}
+
+				fields.emplace_back(std::move(key), std::move(value));
+			} while (this->Expect(','));
+
+			return this->Expect('}');
+		}
+
+		bool ReadJson(std::vector<Result>& results)
+		{
+			if (!this->Expect('{'))
+			{
+				return false;
+			}
+
+			do
+			{
+				std::string key;
+				if (!this->ReadString(key) || !this->Expect(':'))
+				{
+					return false;
+				}
+
+				if (key != "benchmarks")
+				{
+					std::string ignored;
+					if (!this->ReadValue(ignored))
+					{
+						return false;
+					}
+
+					continue;
+				}
+
+				if (!this->Expect('['))
+				{
+					return false;
+				}
+
+				if (this->Expect(']'))
+				{
+					continue;
+				}
+
+				do
+				{
+					Fields fields;
+					if (!this->ReadObject(fields))
+					{
+						return false;
+					}
+
+					results.push_back(ToResult(fields));
+				} while (this->Expect(','));
+
+				if (!this->Expect(']'))
+				{
+					return false;
+				}
+			} while (this->Expect(','));
+
+			return this->Expect('}');
+		}
+
+		// Reads one CSV field, quoted or not, stopping before the separator or the end of the line.
+		std::string ReadCsvField()
+		{
+			std::string value;
+			if (this->Peek() != '"')
+			{
+				while (this->position < this->text.size() && this->text[this->position] != ',' && this->text[this->position] != '\n')
+				{
+					if (this->text[this->position] != '\r')
+					{
+						value += this->text[this->position];
+					}
+					++this->position;
+				}
+
+				return value;
+			}
+
+			++this->position;
+			while (this->position < this->text.size())
+			{
+				char c = this->text[this->position++];
+				if (c == '"')
+				{
+					if (this->Peek() != '"')
+					{
+						break;
+					}
+					++this->position;
+				}
+				value += c;
+			}
+
+			return value;
+		}
+
+		std::vector<std::string> ReadCsvLine()
+		{
+			std::vector<std::string> values;
+			while (true)
+			{
+				values.push_back(this->ReadCsvField());
+				if (this->Peek() != ',')
+				{
+					break;
+				}
+				++this->position;
+			}
+
+			if (this->Peek() == '\n')
+			{
+				++this->position;
+			}
+
+			return values;
+		}
+
+		bool ReadCsv(std::vector<Result>& results)
+		{
+			std::vector<std::string> header = this->ReadCsvLine();
+			if (header.empty() || header[0] != "name")
+			{
+				return false;
+			}
+
+			while (this->position < this->text.size())
+			{
+				std::vector<std::string> values = this->ReadCsvLine();
+				if (values.size() == 1 && values[0].empty())
+				{
+					continue;
+				}
+
+				if (values.size() != header.size())
+				{
+					return false;
+				}
+
+				Fields fields;
+				for (size_t i = 0; i < header.size(); ++i)
+				{
+					fields.emplace_back(header[i], values[i]);
+				}
+
+				results.push_back(ToResult(fields));
+			}
+
+			return true;
+		}
+
+		static Result ToResult(const Fields& fields)
+		{
+			Result result{ "", 0, 0, {}, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, NoCounters() };
+			size_t repetitions = 0;
+			for (const auto& field : fields)
+			{
+				const std::string& value = field.second;
+				if (field.first == "name") { result.name = value; }
+				else if (field.first == "entities") { result.entities = std::strtoull(value.c_str(), nullptr, 10); }
+				else if (field.first == "operations") { result.operations = std::strtoull(value.c_str(), nullptr, 10); }
+				else if (field.first == "repetitions") { repetitions = std::strtoull(value.c_str(), nullptr, 10); }
+				else if (field.first == "ns_per_op") { result.mean = std::strtod(value.c_str(), nullptr); }
+				else if (field.first == "stddev") { result.stddev = std::strtod(value.c_str(), nullptr); }
+				else if (field.first == "min") { result.min = std::strtod(value.c_str(), nullptr); }
+				else if (field.first == "median") { result.median = std::strtod(value.c_str(), nullptr); }
+				else if (field.first == "allocs_per_op") { result.allocations = std::strtod(value.c_str(), nullptr); }
+				else if (field.first == "bytes_per_op") { result.bytes = std::strtod(value.c_str(), nullptr); }
+				else if (field.first == "rss_bytes") { result.rss = std::strtoull(value.c_str(), nullptr, 10); }
+
+				for (size_t counter = 0; counter < CounterCount; ++counter)
+				{
+					if (field.first == std::string(CounterName(counter)) + "_per_op" && !value.empty() && value != "null")
+					{
+						result.counters[counter] = std::strtod(value.c_str(), nullptr);
+					}
+				}
+			}
+
+			// the samples themselves aren't saved, only how many there were
+			result.samples.assign(repetitions, result.mean);
+			return result;
+		}
+
+		std::string text;
+		size_t position = 0;
+	};
+
+	enum class Verdict
+	{
+		Same,
+		Faster,
+		Slower,
+		// only in the baseline
+		Removed,
+		// only in the current results
+		Added,
+	};
+
+	struct Comparison
+	{
+		std::string name;
+		size_t entities;
+		double baseline;
+		double current;
+		// (current - baseline) / baseline, by the medians
+		double change;
+		// the change the runs' own spread could explain
+		double noise;
+		Verdict verdict;
+		double baselineAllocations;
+		double currentAllocations;
+		// allocation counts don't vary between runs, so any growth of them is flagged
+		bool moreAllocations;
+	};
+
+	// Compare matches the benchmarks of both files by name and entity count. A change counts as faster or
+	// slower only when it's beyond threshold (e.g. 0.05 for 5%) and beyond the noise, taken as the relative
+	// standard deviations of both sides added up. Allocations per operation are flagged when they grow by more
+	// than one every hundred operations.
+	inline std::vector<Comparison> Compare(const std::vector<Result>& baseline, const std::vector<Result>& current, double threshold)
+	{
+		std::vector<Comparison> comparisons;
+		std::vector<bool> matched(current.size(), false);
+
+		for (const Result& before : baseline)
+		{
+			Comparison comparison{ before.name, before.entities, before.median, 0.0, 0.0, 0.0, Verdict::Removed, before.allocations, 0.0, false };
+			for (size_t i = 0; i < current.size(); ++i)
+			{
+				const Result& after = current[i];
+				if (matched[i] || after.name != before.name || after.entities != before.entities)
+				{
+					continue;
+				}
+
+				matched[i] = true;
+				comparison.current = after.median;
+				comparison.change = before.median > 0.0 ? (after.median - before.median) / before.median : 0.0;
+				comparison.noise = (before.mean > 0.0 ? before.stddev / before.mean : 0.0) + (after.mean > 0.0 ? after.stddev / after.mean : 0.0);
+
+				double limit = std::max(threshold, comparison.noise);
+				comparison.verdict = comparison.change > limit ? Verdict::Slower : (comparison.change < -limit ? Verdict::Faster : Verdict::Same);
+				comparison.currentAllocations = after.allocations;
+				comparison.moreAllocations = after.allocations > before.allocations + 0.01;
+				break;
+			}
+
+			comparisons.push_back(comparison);
+		}
+
+		for (size_t i = 0; i < current.size(); ++i)
+		{
+			if (!matched[i])
+			{
+				comparisons.push_back(Comparison{ current[i].name, current[i].entities, 0.0, current[i].median, 0.0, 0.0, Verdict::Added,
+					0.0, current[i].allocations, false });
+			}
+		}
+
+		return comparisons;
+	}
+}
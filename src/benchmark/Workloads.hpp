@@ -0,0 +1,232 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Harness.hpp"
+
+namespace benchmark
+{
+	// The components of the comparison workloads, modeled on the usual ecs_benchmark scenarios.
+	struct PositionComponent
+	{
+		float x;
+		float y;
+	};
+
+	struct VelocityComponent
+	{
+		float x;
+		float y;
+	};
+
+	struct DataComponent
+	{
+		uint32_t thingy;
+		double dingy;
+		bool mingy;
+		uint32_t numgy;
+	};
+
+	// Fragment components are only there to spread the entities of the fragmented workloads over more
+	// component combinations.
+	template <int N>
+	struct FragmentComponent
+	{
+		int32_t value;
+	};
+
+	// The workloads run against every library through an adapter, a class wrapping a world of that library:
+	//
+	//   class MyAdapter
+	//   {
+	//   public:
+	//       using Entity = ...;                                         // the library's entity handle
+	//       static const char* Name();                                  // the library, as shown in the results
+	//       Entity Create();
+	//       template <typename T> void Add(Entity entity, const T& component);
+	//       void Destroy(Entity entity);
+	//       template <typename... Ts, typename Func> void Each(Func&& func);   // func(Ts&...) for every match
+	//   };
+	//
+	// Adapters register the components above in their constructor, with whatever the library's fastest
+	// idiomatic way of doing each operation is.
+
+	constexpr float DeltaTime = 1.0f / 60.0f;
+
+	// The systems of the update workload.
+	inline void MoveSystem(PositionComponent& position, const VelocityComponent& velocity)
+	{
+		position.x += velocity.x * DeltaTime;
+		position.y += velocity.y * DeltaTime;
+	}
+
+	inline void DataSystem(DataComponent& data)
+	{
+		data.thingy = (data.thingy + 1) % 1'000'000;
+		data.dingy += 0.0001 * DeltaTime;
+		data.mingy = !data.mingy;
+		data.numgy = data.numgy * 1664525u + 1013904223u;
+	}
+
+	inline void ComplexSystem(PositionComponent& position, VelocityComponent& velocity, DataComponent& data)
+	{
+		if (data.thingy % 10 == 0)
+		{
+			velocity.x = position.x > position.y ? -velocity.x : velocity.x + 1.0f;
+			velocity.y = static_cast<float>(data.numgy % 10);
+		}
+	}
+
+	template <typename Adapter>
+	std::vector<typename Adapter::Entity> CreateFull(Adapter& world, size_t count)
+	{
+		std::vector<typename Adapter::Entity> entities;
+		entities.reserve(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			typename Adapter::Entity entity = world.Create();
+			world.Add(entity, PositionComponent{ static_cast<float>(i), 0.0f });
+			world.Add(entity, VelocityComponent{ 1.0f, 1.0f });
+			world.Add(entity, DataComponent{ static_cast<uint32_t>(i), 0.0, false, static_cast<uint32_t>(i) });
+			entities.push_back(entity);
+		}
+
+		return entities;
+	}
+
+	// Every entity has a Position, every 2nd a Velocity, every 3rd Data and each one a Fragment out of four.
+	template <typename Adapter>
+	void CreateFragmented(Adapter& world, size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			typename Adapter::Entity entity = world.Create();
+			world.Add(entity, PositionComponent{ static_cast<float>(i), 0.0f });
+			if (i % 2 == 0)
+			{
+				world.Add(entity, VelocityComponent{ 1.0f, 1.0f });
+			}
+
+			if (i % 3 == 0)
+			{
+				world.Add(entity, DataComponent{ static_cast<uint32_t>(i), 0.0, false, 0 });
+			}
+
+			switch (i % 4)
+			{
+			case 0: world.Add(entity, FragmentComponent<0>{ 0 }); break;
+			case 1: world.Add(entity, FragmentComponent<1>{ 1 }); break;
+			case 2: world.Add(entity, FragmentComponent<2>{ 2 }); break;
+			default: world.Add(entity, FragmentComponent<3>{ 3 }); break;
+			}
+		}
+	}
+
+	template <typename Adapter>
+	std::string WorkloadName(const std::string& workload)
+	{
+		return workload + " [" + Adapter::Name() + "]";
+	}
+
+	// The workloads, each one added for every adapter in turn so the libraries line up in the results. For
+	// iteration an operation is one entity of the world visited, for the rest one entity created or destroyed.
+	template <typename... Adapters>
+	void AddWorkloads(Suite& suite, size_t count)
+	{
+		size_t passes = Passes(count);
+
+		(suite.Add(WorkloadName<Adapters>("Create with 2 components"), count, count, [](Measurement& m, size_t entities) {
+			Adapters world;
+			m.Time([&]() {
+				for (size_t i = 0; i < entities; ++i)
+				{
+					typename Adapters::Entity entity = world.Create();
+					world.Add(entity, PositionComponent{ 0.0f, 0.0f });
+					world.Add(entity, VelocityComponent{ 1.0f, 1.0f });
+				}
+			});
+		}), ...);
+
+		(suite.Add(WorkloadName<Adapters>("Destroy"), count, count, [](Measurement& m, size_t entities) {
+			Adapters world;
+			std::vector<typename Adapters::Entity> created = CreateFull(world, entities);
+			m.Time([&]() {
+				for (typename Adapters::Entity entity : created)
+				{
+					world.Destroy(entity);
+				}
+			});
+		}), ...);
+
+		(suite.Add(WorkloadName<Adapters>("Iterate 1 component"), count, count * passes, [passes](Measurement& m, size_t entities) {
+			Adapters world;
+			CreateFull(world, entities);
+			m.Time([&]() {
+				for (size_t pass = 0; pass < passes; ++pass)
+				{
+					world.template Each<PositionComponent>([](PositionComponent& position) { position.x += 1.0f; });
+				}
+			});
+		}), ...);
+
+		(suite.Add(WorkloadName<Adapters>("Iterate 2 components"), count, count * passes, [passes](Measurement& m, size_t entities) {
+			Adapters world;
+			CreateFull(world, entities);
+			m.Time([&]() {
+				for (size_t pass = 0; pass < passes; ++pass)
+				{
+					world.template Each<PositionComponent, VelocityComponent>(MoveSystem);
+				}
+			});
+		}), ...);
+
+		(suite.Add(WorkloadName<Adapters>("Iterate 3 components"), count, count * passes, [passes](Measurement& m, size_t entities) {
+			Adapters world;
+			CreateFull(world, entities);
+			m.Time([&]() {
+				for (size_t pass = 0; pass < passes; ++pass)
+				{
+					world.template Each<PositionComponent, VelocityComponent, DataComponent>(ComplexSystem);
+				}
+			});
+		}), ...);
+
+		(suite.Add(WorkloadName<Adapters>("Update 3 systems"), count, count * passes, [passes](Measurement& m, size_t entities) {
+			Adapters world;
+			CreateFull(world, entities);
+			m.Time([&]() {
+				for (size_t pass = 0; pass < passes; ++pass)
+				{
+					world.template Each<PositionComponent, VelocityComponent>(MoveSystem);
+					world.template Each<DataComponent>(DataSystem);
+					world.template Each<PositionComponent, VelocityComponent, DataComponent>(ComplexSystem);
+				}
+			});
+		}), ...);
+
+		(suite.Add(WorkloadName<Adapters>("Iterate 2 components, fragmented"), count, count * passes, [passes](Measurement& m, size_t entities) {
+			Adapters world;
+			CreateFragmented(world, entities);
+			m.Time([&]() {
+				for (size_t pass = 0; pass < passes; ++pass)
+				{
+					world.template Each<PositionComponent, VelocityComponent>(MoveSystem);
+				}
+			});
+		}), ...);
+
+		(suite.Add(WorkloadName<Adapters>("Iterate 3 components, fragmented"), count, count * passes, [passes](Measurement& m, size_t entities) {
+			Adapters world;
+			CreateFragmented(world, entities);
+			m.Time([&]() {
+				for (size_t pass = 0; pass < passes; ++pass)
+				{
+					world.template Each<PositionComponent, VelocityComponent, DataComponent>(ComplexSystem);
+				}
+			});
+		}), ...);
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <tuple>
+
+#include "../../ECS.hpp"
+#include "../Workloads.hpp"
+
+namespace benchmark
+{
+	// BabsEcsAdapter runs the comparison workloads on babs-ecs: single component iteration walks the
+	// component's storage with ForEach, the rest queries with EntitiesWith and fetches with GetComponents.
+	class BabsEcsAdapter
+	{
+	public:
+		using Entity = babs_ecs::Entity;
+
+		BabsEcsAdapter()
+		{
+			this->ecs.RegisterComponent<PositionComponent>();
+			this->ecs.RegisterComponent<VelocityComponent>();
+			this->ecs.RegisterComponent<DataComponent>();
+			this->ecs.RegisterComponent<FragmentComponent<0>>();
+			this->ecs.RegisterComponent<FragmentComponent<1>>();
+			this->ecs.RegisterComponent<FragmentComponent<2>>();
+			this->ecs.RegisterComponent<FragmentComponent<3>>();
+		}
+
+		static const char* Name()
+		{
+			return "babs-ecs";
+		}
+
+		Entity Create()
+		{
+			return this->ecs.CreateEntity();
+		}
+
+		template <typename T>
+		void Add(Entity entity, const T& component)
+		{
+			this->ecs.AddComponent(entity, component);
+		}
+
+		void Destroy(Entity entity)
+		{
+			this->ecs.RemoveEntity(entity);
+		}
+
+		template <typename... Ts, typename Func>
+		void Each(Func&& func)
+		{
+			if constexpr (sizeof...(Ts) == 1)
+			{
+				this->ecs.ForEach<Ts...>([&](Entity, Ts&... components) { func(components...); });
+			}
+			else
+			{
+				for (Entity entity : this->ecs.EntitiesWith<Ts...>())
+				{
+					std::apply([&](Ts*... components) { func(*components...); }, this->ecs.GetComponents<Ts...>(entity));
+				}
+			}
+		}
+
+	private:
+		babs_ecs::ECSManager ecs;
+	};
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "entityplus/entity.h"
+
+#include "../Workloads.hpp"
+
+namespace benchmark
+{
+	// EntityPlusAdapter runs the comparison workloads on EntityPlus (https://github.com/Yelnats321/EntityPlus),
+	// built when it's cloned into libs/EntityPlus (see CMakeLists.txt).
+	class EntityPlusAdapter
+	{
+	public:
+		using Manager = entityplus::entity_manager<
+			entityplus::component_list<PositionComponent, VelocityComponent, DataComponent,
+				FragmentComponent<0>, FragmentComponent<1>, FragmentComponent<2>, FragmentComponent<3>>,
+			entityplus::tag_list<>>;
+		using Entity = Manager::entity_t;
+
+		static const char* Name()
+		{
+			return "EntityPlus";
+		}
+
+		Entity Create()
+		{
+			return this->manager.create_entity();
+		}
+
+		template <typename T>
+		void Add(Entity entity, const T& component)
+		{
+			entity.template add_component<T>(component);
+		}
+
+		void Destroy(Entity entity)
+		{
+			entity.destroy();
+		}
+
+		template <typename... Ts, typename Func>
+		void Each(Func&& func)
+		{
+			this->manager.template for_each<Ts...>([&](Entity, Ts&... components) { func(components...); });
+		}
+
+	private:
+		Manager manager;
+	};
+}
@@ -0,0 +1,79 @@
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark/Harness.hpp"
+#include "benchmark/Report.hpp"
+
+// Compares two result files of babs-benchmark or babs-comparison (written with --json or --csv) and exits
+// with 1 when a benchmark got slower beyond the threshold and the noise, or allocates more, e.g. to fail a
+// CI job.
+int main(int argc, char** argv)
+{
+	std::vector<std::string> paths;
+	double threshold = 0.05;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--threshold" && i + 1 < argc)
+		{
+			threshold = std::strtod(argv[++i], nullptr) / 100.0;
+		}
+		else
+		{
+			paths.push_back(arg);
+		}
+	}
+
+	if (paths.size() != 2)
+	{
+		std::cerr << "usage: " << argv[0] << " BASELINE CURRENT [--threshold PERCENT]" << std::endl;
+		return 2;
+	}
+
+	std::vector<benchmark::Result> baseline;
+	std::vector<benchmark::Result> current;
+	if (!benchmark::ResultReader::Read(paths[0], baseline, std::cerr) || !benchmark::ResultReader::Read(paths[1], current, std::cerr))
+	{
+		return 2;
+	}
+
+	size_t slower = 0;
+	size_t faster = 0;
+	size_t allocating = 0;
+	std::cout << std::left << std::setw(52) << "Name" << std::right << std::setw(12) << "Entities" << std::setw(12) << "Baseline"
+		<< std::setw(12) << "Current" << std::setw(12) << "Change" << std::setw(12) << "Noise" << std::setw(12) << "Allocs/op"
+		<< "  Verdict" << std::endl;
+	std::cout << std::string(52 + 6 * 12 + 9, '-') << std::endl;
+
+	for (const benchmark::Comparison& comparison : benchmark::Compare(baseline, current, threshold))
+	{
+		const char* verdict = "";
+		switch (comparison.verdict)
+		{
+		case benchmark::Verdict::Same: verdict = ""; break;
+		case benchmark::Verdict::Faster: verdict = "faster"; ++faster; break;
+		case benchmark::Verdict::Slower: verdict = "SLOWER"; ++slower; break;
+		case benchmark::Verdict::Removed: verdict = "removed"; break;
+		case benchmark::Verdict::Added: verdict = "added"; break;
+		}
+
+		std::cout << std::left << std::setw(52) << comparison.name << std::right << std::setw(12) << comparison.entities
+			<< std::fixed << std::setprecision(3) << std::setw(12) << comparison.baseline << std::setw(12) << comparison.current
+			<< std::showpos << std::setw(11) << comparison.change * 100.0 << "%" << std::noshowpos
+			<< std::setw(11) << comparison.noise * 100.0 << "%" << std::setw(12) << comparison.currentAllocations << "  " << verdict;
+
+		if (comparison.moreAllocations)
+		{
+			++allocating;
+			std::cout << (comparison.verdict == benchmark::Verdict::Same ? "" : ", ") << "MORE ALLOCATIONS (was " << comparison.baselineAllocations << ")";
+		}
+		std::cout << std::endl;
+	}
+
+	std::cout << std::endl << slower << " slower, " << faster << " faster (threshold " << std::defaultfloat << threshold * 100.0 << "%), "
+		<< allocating << " allocating more" << std::endl;
+	return slower == 0 && allocating == 0 ? 0 : 1;
+}
@@ -0,0 +1,37 @@
+#include <iostream>
+#include <vector>
+
+#include "benchmark/Harness.hpp"
+#include "benchmark/Report.hpp"
+#include "benchmark/Workloads.hpp"
+#include "benchmark/adapters/BabsEcs.hpp"
+#ifdef BABS_BENCHMARK_ENTITYPLUS
+#include "benchmark/adapters/EntityPlus.hpp"
+#endif
+
+int main(int argc, char** argv)
+{
+	benchmark::Options options;
+	if (!benchmark::ParseOptions(argc, argv, options, std::cerr))
+	{
+		return 1;
+	}
+
+	benchmark::Suite suite;
+	for (size_t count : { 10'000, 100'000, 1'000'000 })
+	{
+		benchmark::AddWorkloads<
+			benchmark::BabsEcsAdapter
+#ifdef BABS_BENCHMARK_ENTITYPLUS
+			, benchmark::EntityPlusAdapter
+#endif
+		>(suite, count);
+	}
+
+	std::cout << "Running comparison (" << options.warmup << " warmup runs, " << options.repetitions << " measured runs each)..." << std::endl << std::endl;
+
+	benchmark::Table table(std::cout);
+	std::vector<benchmark::Result> results = suite.Run(options, [&](const benchmark::Result& result) { table.Print(result); });
+
+	return benchmark::Save(options, results, std::cerr) ? 0 : 1;
+}
@@ -28,16 +28,17 @@ namespace events
         template <typename EventType>
         void Broadcast(const EventType& event) const
         {
-            std::string type = typeid(EventType).name();
+            // looked up by the name itself, so events nobody observes don't build a string
+            auto found = this->observers.find(typeid(EventType).name());
 
             // bail if we don't have any observers
-            if (observers.find(type) == observers.end())
+            if (found == this->observers.end())
             {
                 return;
             }
 
             // for each observer, call their event handler
-            auto event_observers = this->observers.at(type);
+            auto event_observers = found->second;
 
             for (auto event_observer : event_observers)
             {
@@ -51,6 +52,6 @@ namespace events
 
     private:
         // this is a map of event type names -> list of function handlers
-        std::map<std::string, std::vector<std::any>> observers;
+        std::map<std::string, std::vector<std::any>, std::less<>> observers;
     };
 }